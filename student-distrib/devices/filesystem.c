@@ -1,53 +1,131 @@
 #include "filesystem.h"
 #include "../lib.h"
+#include "../system_calls.h"
+
+/* open-addressed index from filename hash to bootDentries index, built once at init */
+static uint8_t dentry_hash_table[DENTRY_HASH_SIZE];
+
+/* hit/miss mix of read_dentry_by_name, and how many slots were inspected in total */
+dentry_lookup_stats_t dentry_lookup_stats;
+
+/* uint32_t dentry_name_length(const uint8_t* name)
+ * Inputs:      name - filename, either NUL-terminated or exactly FILE_NAME_SIZE characters
+ * Return Value: number of characters in the name, at most FILE_NAME_SIZE
+ * Function: finds the length of a filename without reading past the 32-byte field */
+static uint32_t
+dentry_name_length(const uint8_t* name) {
+    uint32_t len = 0;
+    while (len < FILE_NAME_SIZE && name[len] != NULL_ASCII) {
+        len++;
+    }
+    return len;
+}
+
+/* uint32_t dentry_name_hash(const uint8_t* name, uint32_t len)
+ * Inputs:      name - filename characters
+ *              len - number of characters to hash
+ * Return Value: FNV-1a hash of the name
+ * Function: hashes a filename for the dentry index */
+static uint32_t
+dentry_name_hash(const uint8_t* name, uint32_t len) {
+    uint32_t hash = FNV_OFFSET_BASIS;
+    uint32_t i;
+    for (i = 0; i < len; i++) {
+        hash ^= name[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/* int32_t dentry_name_matches(const dentry_t* dentry, const uint8_t* name, uint32_t len)
+ * Inputs:      dentry - directory entry to compare against
+ *              name - filename characters
+ *              len - length of name, at most FILE_NAME_SIZE
+ * Return Value: 1 if the names are identical, 0 otherwise
+ * Function: compares names exactly, a 32-character dentry name has no NUL terminator */
+static int32_t
+dentry_name_matches(const dentry_t* dentry, const uint8_t* name, uint32_t len) {
+    uint32_t i;
+    for (i = 0; i < len; i++) {
+        if (dentry->fileName[i] != name[i]) {
+            return 0;
+        }
+    }
+    return (len == FILE_NAME_SIZE) || (dentry->fileName[len] == NULL_ASCII);
+}
 
 /* void init_filesystem(bootblock_t* fsImg_addr)
  * Inputs:      fsImg_addr - A pointer to the bootblock_t structure in the filesystem image
  * Return Value: void
- * Function: Initializes the filesystem by setting pointers to the boot block, inodes, and datablocks */
+ * Function: Initializes the filesystem by setting pointers to the boot block, inodes, and datablocks,
+ *           then builds the filename index used by read_dentry_by_name */
 void
 init_filesystem(bootblock_t* fsImg_addr) {
+    uint32_t i, len, slot, num_dentries;
+    dentry_t* dentry;
+
     //get filesys_img address in mp3.img, reference kernel.c to see how address is retrieved, address is not static
     bootblock = fsImg_addr;
     inode_start = (inode_t*) (bootblock+1);
     datablock_start = (datablock_t*) (inode_start + (bootblock -> numInodes));
+
+    for (i = 0; i < DENTRY_HASH_SIZE; i++) {
+        dentry_hash_table[i] = DENTRY_HASH_EMPTY;
+    }
+    dentry_lookup_stats.hits = 0;
+    dentry_lookup_stats.misses = 0;
+    dentry_lookup_stats.probes = 0;
+
+    num_dentries = bootblock->numDentries;
+    if (num_dentries > MAX_NUM_DENTRIES) {
+        num_dentries = MAX_NUM_DENTRIES;
+    }
+
+    // insert each dentry with linear probing, the first dentry with a given name wins like the old scan
+    for (i = 0; i < num_dentries; i++) {
+        dentry = &((bootblock->bootDentries)[i]);
+        len = dentry_name_length(dentry->fileName);
+        slot = dentry_name_hash(dentry->fileName, len) & DENTRY_HASH_MASK;
+        while (dentry_hash_table[slot] != DENTRY_HASH_EMPTY) {
+            if (dentry_name_matches(&((bootblock->bootDentries)[dentry_hash_table[slot]]), dentry->fileName, len)) {
+                break;
+            }
+            slot = (slot + 1) & DENTRY_HASH_MASK;
+        }
+        if (dentry_hash_table[slot] == DENTRY_HASH_EMPTY) {
+            dentry_hash_table[slot] = i;
+        }
+    }
 }
 
 /* int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry)
  * Inputs:      fname - A pointer to the filename to search for in the directory entries
  *              dentry - A pointer to a dentry_t structure to store the result
  * Return Value: 0 on success, -1 on failure (non-existent file or invalid index)
- * Function: Searches for a directory entry with the specified filename and populates the dentry parameter */
+ * Function: Looks up the directory entry with the specified filename in the hash index and populates the dentry parameter */
 int32_t
 read_dentry_by_name (const uint8_t* fname, dentry_t* dentry) {
-    //loop through boot block to find dentry with fname
-    //fill dentry parameter with filename, filetype, and inode number of matching dentry in filesystem img, then return 0
-    // scan directory entries in boot block
-    uint8_t i,j;
-    dentry_t* temp;
+    uint32_t len, slot;
 
-    if (strlen((const int8_t*)fname) > MAX_FILENAME_SIZE) {
+    // names longer than 32 characters can never match
+    len = dentry_name_length(fname);
+    if (len == FILE_NAME_SIZE && fname[FILE_NAME_SIZE] != NULL_ASCII) {
+        dentry_lookup_stats.misses++;
         return -1;
     }
 
-    // call read_dentry_by_index() which populates dentry parameter (file name, file type, inode num)
-    for(i = 0; i < bootblock->numDentries; i++) {
-        if (strncmp((const int8_t*)fname, (const int8_t*) (bootblock->bootDentries)[i].fileName, MAX_FILENAME_SIZE) == 0) {
-
-            //simplify dentry assignments by saving dentry pointer to temp
-            temp = &((bootblock->bootDentries)[i]);
-            
-            //iterate over each element because strncpy will stop at null characters
-            for(j = 0; j < MAX_FILENAME_SIZE; j++){
-                dentry->fileName[j] = temp->fileName[j];
-            }
-
-            //copy rest of the elements
-            dentry->fileType = temp->fileType;
-            dentry->inodeNumber = temp->inodeNumber;
-            return 0;
+    // probe until the name is found or an empty slot proves it is absent
+    slot = dentry_name_hash(fname, len) & DENTRY_HASH_MASK;
+    while (dentry_hash_table[slot] != DENTRY_HASH_EMPTY) {
+        dentry_lookup_stats.probes++;
+        if (dentry_name_matches(&((bootblock->bootDentries)[dentry_hash_table[slot]]), fname, len)) {
+            dentry_lookup_stats.hits++;
+            return read_dentry_by_index(dentry_hash_table[slot], dentry);
         }
+        slot = (slot + 1) & DENTRY_HASH_MASK;
     }
+    dentry_lookup_stats.probes++;
+    dentry_lookup_stats.misses++;
     return -1;
 }
 
@@ -93,56 +171,70 @@ int32_t
 read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length) {
 //similar to "read" system call, read up to "length" bytes, starting from position "offset" in the file with inode 
 //number "inode", return the number of bytes read and places in the buffer, 0 indicates EOF
-//check if inode is outside number specified in boot block
-//check if data block is outside number specified in boot block
-    inode_t* curr_inode = inode_start + inode;
-    uint32_t curr_data_block_array_index;
-    uint32_t curr_data_block_index;
+//copies are done one block span at a time: a head fragment up to the next block boundary, whole 4KB blocks, then the tail
+    inode_t* curr_inode;
+    uint32_t curr_data_block_array_index;   // index into the inode's data block number array
+    uint32_t curr_data_block_index;         // index of the data block within the filesystem
+    uint32_t offset_within_block;           // position of the next byte to copy within its data block
+    uint32_t span;                          // number of bytes copied out of the current data block
+    uint32_t num_bytes_copied = 0;          // counts the number of bytes copied
+
     // inode range check
-    // if(inode <= -1 || inode > boot_block->inode_count-1){
-    if(inode > bootblock->numInodes-1 || inode < 0){ //if the target inode index doesn't exist
+    if(inode >= bootblock->numInodes){ //if the target inode index doesn't exist
         printf("read_data: Inode out of range \n");
         return -1;
     }
+    curr_inode = inode_start + inode;
 
     if(offset >= curr_inode->numBytes){                                // has the end of the file been reached by offset -> return 0 (check docs)
         return 0;
     }
-    uint32_t current_byte_index; //the byte that we are currently copying
-    uint8_t current_byte; //holds current byte to be written into buffer
-    uint32_t num_bytes_copied = 0; //counts the number of bytes copied
-    uint32_t current_byte_index_within_block; // finds the current index of a byte within a data block
-    int i = 0;
-    //write each individual byte into temp buffer
-    for(current_byte_index = offset; current_byte_index < (offset + length); current_byte_index++){
-        if(current_byte_index == curr_inode->numBytes){
-            return current_byte_index - offset;
+
+    // never copy past the end of the file
+    if(length > curr_inode->numBytes - offset){
+        length = curr_inode->numBytes - offset;
+    }
+
+    // block index and position are only computed once, then advanced a block at a time
+    curr_data_block_array_index = offset / BLOCK_BYTES;
+    offset_within_block = offset % BLOCK_BYTES;
+
+    while(num_bytes_copied < length){
+        curr_data_block_index = curr_inode->dataBlockNumber[curr_data_block_array_index];
+
+        // data block range check
+        if(curr_data_block_index >= bootblock->numDataBlocks){
+            printf("read_data: Data block out of range \n");
+            return -1;
+        }
+
+        // copy the rest of the current block, or whatever is left of the request if it is shorter
+        span = BLOCK_BYTES - offset_within_block;
+        if(span > length - num_bytes_copied){
+            span = length - num_bytes_copied;
         }
-        curr_data_block_array_index = current_byte_index / BLOCK_BYTES; //find the current data block index for array
-        curr_data_block_index = inode_start[inode].dataBlockNumber[curr_data_block_array_index]; //find the current data block index within filesystem
-        current_byte_index_within_block = current_byte_index % BLOCK_BYTES;
-        current_byte = datablock_start[curr_data_block_index].dataBlockValue[current_byte_index_within_block];
-        buf[i] = current_byte;
-        i++;
-        num_bytes_copied++;
-    }
-    //memcpy(buf, temp_buf, length);
+        memcpy(buf + num_bytes_copied, &datablock_start[curr_data_block_index].dataBlockValue[offset_within_block], span);
+
+        num_bytes_copied += span;
+        curr_data_block_array_index++;
+        offset_within_block = 0;
+    }
     return num_bytes_copied;
 }
 
-/* int32_t directory_read(int32_t file_index, void* buff, int32_t num_bytes)
- * Inputs:      file_index - The index of the directory entry to read
+/* int32_t read_dentry_name(uint32_t index, void* buf, int32_t num_bytes)
+ * Inputs:      index - The index of the directory entry to read
  *              buf - A pointer to the buffer where the directory entry name will be stored
  *              num_bytes - The number of bytes available in the buffer
- * Return Value: The number of bytes read (string length) or -1 on failure
+ * Return Value: The number of bytes read (string length), 0 past the last entry, or -1 on failure
  * Function: Reads the name of the directory entry with the specified index and stores it in the buffer */
-int32_t 
-directory_read(int32_t file_index, void* buf, int32_t num_bytes) {
-    if (file_index >= bootblock->numDentries) {
+int32_t
+read_dentry_name(uint32_t index, void* buf, int32_t num_bytes) {
+    if (index >= bootblock->numDentries) {
         return 0;
     }
     dentry_t dentry;
-    if(read_dentry_by_index(file_index, &dentry) == -1){
+    if(read_dentry_by_index(index, &dentry) == -1){
         return -1;
     }
     
@@ -164,6 +256,21 @@ directory_read(int32_t file_index, void* buf, int32_t num_bytes) {
     return strlen_ret;
 }
 
+/* int32_t directory_read(int32_t fd, void* buf, int32_t num_bytes)
+ * Inputs:      fd - file descriptor of the open directory
+ *              buf - A pointer to the buffer where the directory entry name will be stored
+ *              num_bytes - The number of bytes available in the buffer
+ * Return Value: The number of bytes read (string length) or -1 on failure
+ * Function: Reads the name of the next directory entry and advances the fd position by one entry */
+int32_t 
+directory_read(int32_t fd, void* buf, int32_t num_bytes) {
+    int32_t ret_val;
+
+    ret_val = read_dentry_name(current_pcb->fd_array[fd].file_position, buf, num_bytes);
+    current_pcb->fd_array[fd].file_position += 1;
+    return ret_val;
+}
+
 /* int32_t directory_close(int32_t file_index)
  * Inputs:      file_index - The index of the directory entry to close
  * Return Value: 0
@@ -193,16 +300,21 @@ directory_write(int32_t file_index, const void* buf, int32_t num_bytes){
     return -1;
 }
 
-/* int32_t file_read(uint32_t inode_idx, int32_t offset, void* buff, int32_t num_bytes)
- * Inputs:      inode_idx - The index of the inode for the file to read
- *              offset - The offset within the file to read
+/* int32_t file_read(int32_t fd, void* buf, int32_t num_bytes)
+ * Inputs:      fd - file descriptor of the open file
  *              buf - A pointer to the buffer where the file data will be stored
  *              num_bytes - The number of bytes to read
  * Return Value: The number of bytes read or -1 on failure
- * Function: Reads data from a file specified by the inode index and file index and stores it in the buffer */
+ * Function: Reads data from the file's inode at the fd position and advances the position past the bytes read */
 int32_t
-file_read(uint32_t inode_idx, int32_t offset, void* buf, int32_t num_bytes){        
-    return read_data(inode_idx, offset, buf, num_bytes);
+file_read(int32_t fd, void* buf, int32_t num_bytes){        
+    int32_t ret_val;
+
+    ret_val = read_data(current_pcb->fd_array[fd].inode_num, current_pcb->fd_array[fd].file_position, buf, num_bytes);
+    if (ret_val > 0) {
+        current_pcb->fd_array[fd].file_position += ret_val;
+    }
+    return ret_val;
 }
 
 /* int32_t file_write(int32_t file_index, const void* buff, int32_t num_bytes)
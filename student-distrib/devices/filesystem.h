@@ -24,6 +24,15 @@
 #define NULL_ASCII          0x00
 #define MAX_FILENAME_SIZE   32
 
+/* dentry name index has a power of two number of slots, at least twice MAX_NUM_DENTRIES so probes stay short */
+#define DENTRY_HASH_SIZE    128
+#define DENTRY_HASH_MASK    (DENTRY_HASH_SIZE - 1)
+#define DENTRY_HASH_EMPTY   0xFF
+
+/* 32-bit FNV-1a constants for hashing filenames */
+#define FNV_OFFSET_BASIS    2166136261U
+#define FNV_PRIME           16777619U
+
 
 /* dentry struct, each directory entry within the bootblock, reserved unused*/
 typedef struct  {
@@ -55,6 +64,15 @@ typedef struct {
     uint8_t dataBlockValue[BLOCK_BYTES];
 } datablock_t;
 
+/* lookup counters for read_dentry_by_name */
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t probes;
+} dentry_lookup_stats_t;
+
+extern dentry_lookup_stats_t dentry_lookup_stats;
+
 /* starting address of filesystem, pointer to bootblock */
 bootblock_t* bootblock;
 
@@ -64,11 +82,11 @@ inode_t* inode_start;
 /* starting address of datablocks, points to first datablock/datablock array*/
 datablock_t* datablock_start;
 
-/// @brief initialize filesystem to get img starting addresses for bootblock, inodes, and datablocks
+/// @brief initialize filesystem to get img starting addresses for bootblock, inodes, and datablocks, and build the filename hash index
 /// @param fsImg_addr 
 void init_filesystem(bootblock_t* fsImg_addr);
 
-/// @brief read denty by filename and fill input dentry
+/// @brief read denty by filename through the hash index and fill input dentry
 /// @param fname 
 /// @param dentry 
 /// @return -1 for failure (non-existent file or invalid index #), 0 for success
@@ -90,12 +108,19 @@ int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry);
 /// @return -1 for failure (non-existent file or invalid inode #), 0 for success
 int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
 
-int32_t directory_read(int32_t file_index, void* buf, int32_t num_bytes);
+/// @brief copy the name of the dentry at index into buf
+/// @param index 
+/// @param buf 
+/// @param num_bytes 
+/// @return length of the name, 0 past the last dentry, -1 for failure
+int32_t read_dentry_name(uint32_t index, void* buf, int32_t num_bytes);
+
+int32_t directory_read(int32_t fd, void* buf, int32_t num_bytes);
 int32_t directory_write(int32_t file_index, const void* buf, int32_t num_bytes);
 int32_t directory_open(const uint8_t* fname);
 int32_t directory_close(int32_t file_index);
 
-int32_t file_read(uint32_t inode_idx, int32_t offset, void* buf, int32_t num_bytes);
+int32_t file_read(int32_t fd, void* buf, int32_t num_bytes);
 
 int32_t file_write(int32_t file_index, const void* buf, int32_t num_bytes);
 
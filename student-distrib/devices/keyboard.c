@@ -3,6 +3,7 @@
 #include "../i8259.h"
 #include "terminal.h"
 #include "../scheduler.h"
+#include "../softirq.h"
 
 // LUT for translating scan code set 1 to lowercase ASCII characters
 const char lowercase_scancode_to_char [NUM_SCAN_CODES] = {
@@ -134,6 +135,15 @@ volatile uint8_t r_shift_flag;
 volatile uint8_t ctrl_flag;
 volatile uint8_t alt_flag;
 
+// scancodes the top half read and the bottom half has not decoded, new ones are dropped
+// while it is full
+static uint8_t scancode_ring[SCANCODE_RING_SIZE];
+static uint32_t scancode_head;
+static uint32_t scancode_tail;
+static spinlock_t scancode_lock;
+
+static void keyboard_bottom_half();
+
 /* void keyboard_init()
  * Inputs:      void
  * Return Value: void
@@ -145,6 +155,7 @@ keyboard_init() {
     r_shift_flag = 0x00;
     ctrl_flag = 0x00;
     alt_flag = 0x00;
+    open_softirq(SOFTIRQ_KEYBOARD, KEYBOARD_IRQ, keyboard_bottom_half);
     enable_irq(KEYBOARD_IRQ);
 }
 
@@ -158,91 +169,148 @@ keyboard_close() {
 }
 
 
+/* void handle_scancode(uint8_t scan_code)
+ * Inputs:      scan_code -- byte the keyboard sent
+ * Return Value: void
+ * Function: updates the modifier flags, switches or clears terminals for the hotkeys and
+ *           writes characters to the active terminal's keyboard buffer */
+static void
+handle_scancode(uint8_t scan_code) {
+    uint8_t output_char;
+    uint8_t use_caps;
+    int i;
+
+    // handle special keys
+    if (scan_code == CAPS_LOCK) {
+        caps_lock_flag = caps_lock_flag ^ CAPS_LOCK_BITMASK;
+    } else if (scan_code == L_SHIFT_PRESS) {
+        l_shift_flag = 1;
+    } else if (scan_code == R_SHIFT_PRESS) {
+        r_shift_flag = 1;
+    } else if (scan_code == L_SHIFT_RELEASE) {
+        l_shift_flag = 0;
+    } else if (scan_code == R_SHIFT_RELEASE) {
+        r_shift_flag = 0;
+    } else if (scan_code == CTRL_PRESS) {
+        ctrl_flag = 1;
+    } else if (scan_code == CTRL_RELEASE) {
+        ctrl_flag = 0;
+    } else if (scan_code == ALT_PRESS) {
+        alt_flag = 1;
+    } else if (scan_code == ALT_RELEASE) {
+        alt_flag = 0;
+    } else if (scan_code == L_PRESS && ctrl_flag) {
+        // clear old commands from terminal
+        clear_terminal();
+    } else if (alt_flag && (scan_code == F1_PRESS || scan_code == F2_PRESS || scan_code == F3_PRESS)) {
+        // switch terminal
+        switch (scan_code) {
+            case F1_PRESS:
+                terminal_switch(0);
+            break;
+            case F2_PRESS:
+                terminal_switch(1);
+            break;
+            case F3_PRESS:
+                terminal_switch(2);
+            break;
+            default:
+            break;
+        }
+    } else if (scan_code == TAB_PRESS) {
+        for (i = 0; i < TAB_SPACE; i++) {
+            update_kb_buffer(SPACE_ASCII);
+        }
+    } else {
+        if (scan_code <= NUM_SCAN_CODES) {
+            // set flag for special characters
+            use_caps = l_shift_flag | r_shift_flag;
+
+            // if key is a letter, check caps lock
+            if (((scan_code >= UPPER_ROW_LETTER_START) & (scan_code <= UPPER_ROW_LETTER_END)) | 
+                ((scan_code >= MID_ROW_LETTER_START) & (scan_code <= MID_ROW_LETTER_END)) | 
+                ((scan_code >= LOWER_ROW_LETTER_START) & (scan_code <= LOWER_ROW_LETTER_END))) {
+                use_caps ^= caps_lock_flag;
+            }
+
+            // handle uppercase/special characters
+            if (use_caps) {
+                output_char = uppercase_scancode_to_char[scan_code];
+            } else {
+                output_char = lowercase_scancode_to_char[scan_code];
+            }
+
+            // write to the keyboard buffer
+            update_kb_buffer(output_char);
+        }
+    }
+}
+
+/* int32_t pop_scancode(uint8_t* scan_code)
+ * Inputs:      scan_code -- where the oldest queued scancode goes
+ * Return Value: 1 if there was one, 0 if the ring is empty */
+static int32_t
+pop_scancode(uint8_t* scan_code) {
+    uint32_t flags;
+    int32_t found = 0;
+
+    cli_and_save(flags);
+    spin_lock(&scancode_lock);
+    if (scancode_tail != scancode_head) {
+        *scan_code = scancode_ring[scancode_tail % SCANCODE_RING_SIZE];
+        scancode_tail++;
+        found = 1;
+    }
+    spin_unlock(&scancode_lock);
+    restore_flags(flags);
+    return found;
+}
+
+/* void keyboard_bottom_half()
+ * Inputs:      void
+ * Return Value: void
+ * Function: decodes every queued scancode with interrupts on, then wakes the terminal
+ *           readers once */
+static void
+keyboard_bottom_half() {
+    uint8_t scan_code;
+    uint32_t decoded = 0;
+
+    while (pop_scancode(&scan_code)) {
+        handle_scancode(scan_code);
+        decoded++;
+    }
+
+    // let blocked terminal readers redraw or return
+    if (decoded != 0) {
+        wake_up_interactive(&keyboard_wait_queue);
+    }
+}
+
 /* void keyboard_handler()
  * Inputs:      void
  * Return Value: void
- * Function: prints echo of key pressed */
+ * Function: top half, queues the scancode for keyboard_bottom_half and acknowledges the
+ *           interrupt. Everything else runs after the EOI with interrupts on */
 void
 keyboard_handler() {
+    uint32_t start = rdtsc_low();
     uint8_t keyboard_status;
-    uint8_t scan_code;
-    uint8_t output_char;
-    uint8_t use_caps;
-    int i;
 
     cli();
     // check if output buffer is ready
     keyboard_status = inb(KEYBOARD_STATUS_PORT);
     if (keyboard_status & KEYBOARD_OUTPUT_BUFFER_STATUS_MASK) {
-        // read scancode from keyboard port
-        scan_code = inb(KEYBOARD_DATA_PORT);
-
-        // handle special keys
-        if (scan_code == CAPS_LOCK) {
-            caps_lock_flag = caps_lock_flag ^ CAPS_LOCK_BITMASK;
-        } else if (scan_code == L_SHIFT_PRESS) {
-            l_shift_flag = 1;
-        } else if (scan_code == R_SHIFT_PRESS) {
-            r_shift_flag = 1;
-        } else if (scan_code == L_SHIFT_RELEASE) {
-            l_shift_flag = 0;
-        } else if (scan_code == R_SHIFT_RELEASE) {
-            r_shift_flag = 0;
-        } else if (scan_code == CTRL_PRESS) {
-            ctrl_flag = 1;
-        } else if (scan_code == CTRL_RELEASE) {
-            ctrl_flag = 0;
-        } else if (scan_code == ALT_PRESS) {
-            alt_flag = 1;
-        } else if (scan_code == ALT_RELEASE) {
-            alt_flag = 0;
-        } else if (scan_code == L_PRESS && ctrl_flag) {
-            // clear old commands from terminal
-            clear_terminal();
-        } else if (alt_flag && (scan_code == F1_PRESS || scan_code == F2_PRESS || scan_code == F3_PRESS)) {
-            // switch terminal
-            switch (scan_code) {
-                case F1_PRESS:
-                    terminal_switch(0);
-                break;
-                case F2_PRESS:
-                    terminal_switch(1);
-                break;
-                case F3_PRESS:
-                    terminal_switch(2);
-                break;
-                default:
-                break;
-            }
-        } else if (scan_code == TAB_PRESS) {
-            for (i = 0; i < TAB_SPACE; i++) {
-                update_kb_buffer(SPACE_ASCII);
-            }
+        spin_lock(&scancode_lock);
+        if (scancode_head - scancode_tail < SCANCODE_RING_SIZE) {
+            scancode_ring[scancode_head % SCANCODE_RING_SIZE] = inb(KEYBOARD_DATA_PORT);
+            scancode_head++;
         } else {
-            if (scan_code <= NUM_SCAN_CODES) {
-                // set flag for special characters
-                use_caps = l_shift_flag | r_shift_flag;
-
-                // if key is a letter, check caps lock
-                if (((scan_code >= UPPER_ROW_LETTER_START) & (scan_code <= UPPER_ROW_LETTER_END)) | 
-                    ((scan_code >= MID_ROW_LETTER_START) & (scan_code <= MID_ROW_LETTER_END)) | 
-                    ((scan_code >= LOWER_ROW_LETTER_START) & (scan_code <= LOWER_ROW_LETTER_END))) {
-                    use_caps ^= caps_lock_flag;
-                }
-
-                // handle uppercase/special characters
-                if (use_caps) {
-                    output_char = uppercase_scancode_to_char[scan_code];
-                } else {
-                    output_char = lowercase_scancode_to_char[scan_code];
-                }
-
-                // write to the keyboard buffer
-                update_kb_buffer(output_char);
-            }
+            inb(KEYBOARD_DATA_PORT);
         }
-        
+        spin_unlock(&scancode_lock);
+        raise_softirq(SOFTIRQ_KEYBOARD);
     }
-    sti();
     send_eoi(KEYBOARD_IRQ);
+    irq_exit(KEYBOARD_IRQ, start);
 }
@@ -36,6 +36,9 @@
 #define TAB_SPACE                               4
 #define SPACE_ASCII                             0x20
 
+/* scancodes queued between the top and bottom half, a power of two */
+#define SCANCODE_RING_SIZE      64
+
 #define NUM_ROWS                25
 #define TERMINAL_ROW_START      2
 
@@ -46,5 +49,5 @@ void keyboard_init();
 /* disable keyboard input */
 void keyboard_close();
 
-/* handle keyboard input to terminal */
+/* acknowledge a key and queue it, the terminal is updated by a softirq */
 void keyboard_handler();
@@ -5,32 +5,275 @@
 #include "../tests.h"
 #include "../scheduler.h"
 #include "../system_calls.h"
+#include "../paging.h"
+#include "../lapic.h"
+#include "../smp.h"
+#include "../timer.h"
+#include "../kdata.h"
 #include "terminal.h"
 
+#define HZ_OPTION           "pit_hz="
+#define NOTICKLESS_OPTION   "notickless"
 
+// ticks since the TLB flush and interrupt rates were last sampled
+static uint32_t ticks_since_sample;
+static uint32_t interrupts_at_sample;
 
-/* void pit_init()
+// divisor of the periodic tick
+static uint32_t pit_divisor;
+
+// 1 once the boot processor's local APIC timer gives the tick and the PIT is masked
+static uint32_t lapic_tick;
+
+// counts of the timer giving the tick in one tick, and the most a one-shot can load
+static uint32_t counts_per_tick;
+static uint32_t max_counts;
+
+// 0 if the command line turned tickless mode off
+static uint32_t tickless_enabled = 1;
+
+// counts loaded for the pending one-shot, 0 while the tick is periodic
+static uint32_t oneshot_counts;
+
+// part of a tick left over when a one-shot was cut short
+static uint32_t leftover_counts;
+
+// ticks credited outside the handler that the scheduler has not been charged yet
+static uint32_t uncharged_ticks;
+
+/* void program_periodic()
  * Inputs:      void
  * Return Value: void
- * Function: enables interrupts for the PIT
- */
-void init_pit() {
+ * Function: starts the periodic tick at pit_hz */
+static void program_periodic() {
+    if (lapic_tick) {
+        lapic_timer_start();
+        return;
+    }
     outb(PIT_MODE, PIT_COMMAND);
-    outb(PIT_20HZ & PIT_MASK , PIT_CHANNEL_0);
-    outb((PIT_20HZ >> EIGHT) & PIT_MASK, PIT_CHANNEL_0);
+    outb(pit_divisor & PIT_MASK, PIT_CHANNEL_0);
+    outb((pit_divisor >> EIGHT) & PIT_MASK, PIT_CHANNEL_0);
+}
+
+/* void parse_cmdline(const int8_t* cmdline)
+ * Inputs:      cmdline -- multiboot command line, NULL if the bootloader gave none
+ * Return Value: void
+ * Function: reads pit_hz=<rate> and notickless from the space separated options */
+static void parse_cmdline(const int8_t* cmdline) {
+    uint32_t hz;
+
+    pit_hz = PIT_DEFAULT_HZ;
+    if (cmdline_number(cmdline, (int8_t*)HZ_OPTION, &hz) == 0) {
+        if (hz < PIT_MIN_HZ) {
+            hz = PIT_MIN_HZ;
+        } else if (hz > PIT_MAX_HZ) {
+            hz = PIT_MAX_HZ;
+        }
+        pit_hz = hz;
+    }
+    if (cmdline_option(cmdline, (int8_t*)NOTICKLESS_OPTION) != NULL) {
+        tickless_enabled = 0;
+    }
+}
+
+/* void pit_init(const int8_t* cmdline)
+ * Inputs:      cmdline -- multiboot command line, NULL if the bootloader gave none
+ * Return Value: void
+ * Function: starts the periodic tick at the rate the command line asks for and enables
+ *           interrupts for the PIT
+ */
+void init_pit(const int8_t* cmdline) {
+    parse_cmdline(cmdline);
+    pit_divisor = PIT_FREQ_CONSTANT / pit_hz;
+    counts_per_tick = pit_divisor;
+    max_counts = PIT_MAX_COUNT;
+    program_periodic();
 
     enable_irq(PIT_LINE);
     return;
 }
 
+/* void pit_use_lapic()
+ * Inputs:      void
+ * Return Value: void
+ * Function: masks the PIT and lets the boot processor's calibrated local APIC timer give the
+ *           tick at the same rate. Its counts are finer than the PIT's, so partial ticks
+ *           after a one-shot are kept more precisely, and a one-shot can cover the whole
+ *           second to the next sample. Does nothing if the timer was not calibrated */
+void pit_use_lapic() {
+    uint32_t flags;
+
+    if (lapic_ticks_per_pit_tick == 0) {
+        return;
+    }
+
+    cli_and_save(flags);
+    pit_exit_tickless();
+    disable_irq(PIT_LINE);
+    lapic_tick = 1;
+    counts_per_tick = lapic_ticks_per_pit_tick;
+    max_counts = LAPIC_TIMER_MAX_COUNT;
+    leftover_counts = 0;
+    program_periodic();
+    restore_flags(flags);
+}
+
+/* uint32_t pit_ms_to_ticks(uint32_t ms)
+ * Inputs:      ms -- milliseconds
+ * Return Value: whole ticks in ms at the current rate, at least 1 */
+uint32_t pit_ms_to_ticks(uint32_t ms) {
+    uint32_t ticks = ms * pit_hz / MS_PER_SEC;
+
+    return ticks ? ticks : 1;
+}
+
+/* void credit_ticks(uint32_t ticks)
+ * Inputs:      ticks -- ticks that passed
+ * Return Value: void
+ * Function: charges the ticks to the idle context or the running process and samples the
+ *           TLB flush and interrupt rates once a second */
+static void credit_ticks(uint32_t ticks) {
+    account_ticks(ticks, pit_hz);
+    ticks_since_sample += ticks;
+    if (ticks_since_sample >= pit_hz) {
+        ticks_since_sample = 0;
+        sample_tlb_flush_rate();
+        pit_stats.interrupts_per_sec = pit_stats.interrupts - interrupts_at_sample;
+        interrupts_at_sample = pit_stats.interrupts;
+    }
+}
+
+/* void pit_enter_tickless()
+ * Inputs:      void
+ * Return Value: void
+ * Function: called with interrupts disabled when nothing needs preempting. Programs one
+ *           interrupt for the next once-a-second sample or kernel timer, as far ahead as the
+ *           counter allows even if that is not a whole number of ticks, instead of the
+ *           periodic tick */
+void pit_enter_tickless() {
+    uint32_t ticks, timer_ticks_left;
+
+    if (!tickless_enabled || oneshot_counts != 0) {
+        return;
+    }
+
+    ticks = pit_hz - ticks_since_sample;
+    timer_ticks_left = timer_ticks_to_next();
+    if (ticks > timer_ticks_left) {
+        ticks = timer_ticks_left;
+    }
+    // a one tick one-shot saves nothing
+    if (ticks <= 1) {
+        return;
+    }
+
+    // below 37 Hz the PIT counter holds less than two ticks, it then runs to its limit and
+    // finish_oneshot keeps the partial tick
+    if (ticks > max_counts / counts_per_tick) {
+        oneshot_counts = max_counts;
+    } else {
+        oneshot_counts = ticks * counts_per_tick;
+    }
+    if (lapic_tick) {
+        lapic_timer_oneshot(oneshot_counts);
+    } else {
+        outb(PIT_ONESHOT_MODE, PIT_COMMAND);
+        outb(oneshot_counts & PIT_MASK, PIT_CHANNEL_0);
+        outb((oneshot_counts >> EIGHT) & PIT_MASK, PIT_CHANNEL_0);
+    }
+    pit_stats.oneshots++;
+}
+
+/* uint32_t finish_oneshot(uint32_t remaining)
+ * Inputs:      remaining -- counts the one-shot had left
+ * Return Value: whole ticks that passed during the one-shot
+ * Function: restarts the periodic tick and keeps the partial tick for next time */
+static uint32_t finish_oneshot(uint32_t remaining) {
+    uint32_t elapsed;
+
+    // the counter wraps past zero when the interrupt is still pending
+    if (remaining > oneshot_counts) {
+        remaining = 0;
+    }
+    elapsed = oneshot_counts - remaining + leftover_counts;
+    leftover_counts = elapsed % counts_per_tick;
+    oneshot_counts = 0;
+    program_periodic();
+    return elapsed / counts_per_tick;
+}
+
+/* void pit_exit_tickless()
+ * Inputs:      void
+ * Return Value: void
+ * Function: called with interrupts disabled when a process becomes ready. Stops a pending
+ *           one-shot and restarts the periodic tick so the scheduler can preempt again. Only
+ *           the boot processor can reach its local APIC timer, other callers interrupt it
+ *           and its reschedule handler comes back here */
+void pit_exit_tickless() {
+    uint32_t remaining, ticks;
+
+    if (oneshot_counts == 0) {
+        return;
+    }
+
+    if (lapic_tick) {
+        if (this_cpu()->id != BOOT_CPU) {
+            lapic_send_ipi(cpus[BOOT_CPU].apic_id, RESCHEDULE_VECTOR);
+            return;
+        }
+        remaining = lapic_timer_remaining();
+    } else {
+        outb(PIT_LATCH, PIT_COMMAND);
+        remaining = inb(PIT_CHANNEL_0);
+        remaining |= inb(PIT_CHANNEL_0) << EIGHT;
+    }
+
+    ticks = finish_oneshot(remaining);
+    credit_ticks(ticks);
+    uncharged_ticks += ticks;
+    add_deferred_timers(uncharged_ticks);
+}
+
+/* uint32_t pit_ticks_behind()
+ * Inputs:      void
+ * Return Value: ticks that passed which the timer wheel has not run yet, PIT_BEHIND_UNKNOWN
+ *               while a one-shot this processor could not stop is still counting
+ * Function: called with interrupts disabled after pit_exit_tickless */
+uint32_t pit_ticks_behind() {
+    return (oneshot_counts != 0) ? PIT_BEHIND_UNKNOWN : uncharged_ticks;
+}
+
+/* void system_tick(void)
+ * Inputs:      void
+ * Return Value: void
+ * Function: accounts the ticks since the last interrupt, samples the TLB flush rate once a
+ *           second, fires due kernel timers, publishes the time in the kernel data page and
+ *           charges the ticks to the running process. Called on the boot processor holding
+ *           the kernel lock, by the PIT or the local APIC timer handler */
+void system_tick(void) {
+    uint32_t ticks;
+
+    pit_stats.interrupts++;
+
+    // gates do not clear IF, the run queue must not change under the scheduler
+    cli();
+    ticks = (oneshot_counts != 0) ? finish_oneshot(0) : 1;
+    credit_ticks(ticks);
+    ticks += uncharged_ticks;
+    uncharged_ticks = 0;
+    add_deferred_timers(ticks);
+    run_timers(ticks);
+    update_kernel_data();
+    scheduler_tick(ticks);
+}
 
 /* void pit_handler(void)
  * Inputs:      void
  * Return Value: void
- * Function: calls scheduler function */
+ * Function: the tick until the local APIC timer takes over */
 void pit_handler(void){
+    lock_kernel();
     send_eoi(PIT_LINE);
-    if (current_pcb && initialized_terminals && terminals) {
-        scheduler();
-    }
+    system_tick();
+    unlock_kernel();
 }
@@ -1,3 +1,6 @@
+#ifndef _PIT_H
+#define _PIT_H
+
 #include "../types.h"
 
 #define PIT_LINE            0
@@ -6,13 +9,60 @@
 #define PIT_CHANNEL_2       0x42
 #define PIT_COMMAND         0x43
 #define PIT_MODE            0x36
+/* channel 0, lobyte/hibyte, mode 0: one interrupt when the count runs out */
+#define PIT_ONESHOT_MODE    0x30
+/* channel 0 counter latch, the count is then read low byte first */
+#define PIT_LATCH           0x00
 #define PIT_INDEX           0x20
 #define EIGHT               8
 #define PIT_MASK            0xFF
+#define PIT_MAX_COUNT       0xFFFF
 
 #define PIT_FREQ_CONSTANT   1193181
 #define PIT_100HZ           PIT_FREQ_CONSTANT / 100
 #define PIT_20HZ            PIT_FREQ_CONSTANT / 20
 
-void init_pit();
+/* tick rate used unless the multiboot command line has pit_hz=<rate> */
+#define PIT_DEFAULT_HZ      20
+/* slowest rate whose divisor fits in 16 bits, and the fastest we allow */
+#define PIT_MIN_HZ          19
+#define PIT_MAX_HZ          1000
+#define MS_PER_SEC          1000
+
+/* pit_ticks_behind while another processor waits for the boot processor to end its one-shot */
+#define PIT_BEHIND_UNKNOWN  0xFFFFFFFF
+
+/* timer interrupt counts, sampled once a second */
+typedef struct pit_stats_t {
+    uint32_t interrupts;            // tick interrupts since boot, from the PIT or the local APIC timer
+    uint32_t oneshots;              // times the tick was put in one-shot mode
+    uint32_t interrupts_per_sec;    // interrupts during the last second
+} pit_stats_t;
+
+pit_stats_t pit_stats;
+
+/* periodic tick rate in Hz, chosen at boot */
+uint32_t pit_hz;
+
+void init_pit(const int8_t* cmdline);
 void pit_handler();
+
+/* per-tick work on the boot processor, whichever timer gives the tick */
+void system_tick();
+
+/* hand the tick to the boot processor's calibrated local APIC timer and mask the PIT */
+void pit_use_lapic();
+
+/* length of ms milliseconds in ticks, at least one */
+uint32_t pit_ms_to_ticks(uint32_t ms);
+
+/* replace the periodic tick with one interrupt at the next deadline, when no process needs preempting */
+void pit_enter_tickless();
+
+/* go back to the periodic tick, crediting the ticks that passed in one-shot mode */
+void pit_exit_tickless();
+
+/* ticks the timer wheel has yet to run, they were credited after the last tick */
+uint32_t pit_ticks_behind();
+
+#endif /* _PIT_H */
@@ -2,21 +2,44 @@
 #include "../lib.h"
 #include "../i8259.h"
 #include "../tests.h"
+#include "../wait_queue.h"
+#include "../scheduler.h"
+#include "../softirq.h"
 
 
-volatile uint32_t rtc_interrupt_flag = 0;
+// number of RTC interrupts so far, the hardware always runs at RTC_MAX_FREQUENCY
+volatile uint32_t rtc_ticks = 0;
 
-void set_rtc_frequency(uint32_t frequency);
+/* reader blocked in rtc_read until rtc_ticks reaches its file's next virtual tick */
+typedef struct rtc_waiter_t {
+    uint32_t due;
+    wait_queue_t queue;
+    struct rtc_waiter_t* next;
+} rtc_waiter_t;
+
+// blocked readers, how many there are and the earliest tick one of them is due at. The top
+// half only reads the counts, the list changes under the kernel lock
+static rtc_waiter_t* rtc_waiters;
+static volatile uint32_t rtc_waiting;
+static volatile uint32_t rtc_next_due;
+
+// RTC file of kernel code calling the driver without a process or an open file
+static fd_element_t kernel_rtc_file;
+
+static uint32_t frequency_divisor(uint32_t frequency);
+static void rtc_bottom_half();
 
 /* void rtc_init()
  * Inputs:      void
  * Return Value: void
- * Function: enables interrupts for the RTC
+ * Function: enables interrupts for the RTC at its fastest rate, files get slower rates by
+ *           counting ticks. Called once at boot
  */
 void rtc_init()
 {
     uint8_t prev, rate;
-    cli();
+    uint32_t flags;
+    cli_and_save(flags);
 
     // turn on periodic interrupts
     outb(RTC_REG_B_NMI_BIT, RTC_INDEX_PORT);
@@ -27,7 +50,7 @@ void rtc_init()
     // change interrupt rate, mask ensures its always <= 15
     rate = RTC_RATE & RTC_RATE_MASK;
 
-    //setting rate to minimum
+    //setting rate to RTC_MAX_FREQUENCY
     outb(RTC_REG_A_NMI_BIT, RTC_INDEX_PORT);
     prev = inb(RTC_DATA_PORT);
     outb(RTC_REG_A_NMI_BIT, RTC_INDEX_PORT);
@@ -37,52 +60,160 @@ void rtc_init()
     outb(RTC_REG_C, RTC_INDEX_PORT);
     inb(RTC_DATA_PORT);
 
+    open_softirq(SOFTIRQ_RTC, RTC_IRQ, rtc_bottom_half);
     enable_irq(RTC_IRQ);
-    sti();
+    restore_flags(flags);
 }
 
-/* void rtc_handler(void)
+/* void rtc_bottom_half(void)
  * Inputs:      void
  * Return Value: void
- * Function: calls test_interrupt function */
-void rtc_handler()
+ * Function: wakes the readers whose tick has come, with interrupts on, and finds the next
+ *           tick one is due at */
+static void rtc_bottom_half()
 {
-    cli();
+    rtc_waiter_t** link = &rtc_waiters;
+    rtc_waiter_t* waiter;
+    uint32_t now = rtc_ticks;
+    uint32_t next_due = now;
+    uint32_t found = 0;
 
 #if (RTC_TEST)
     // test_interrupts();
     puts("1");
 #endif
 
+    while ((waiter = *link) != NULL) {
+        if ((int32_t)(now - waiter->due) >= 0) {
+            *link = waiter->next;
+            rtc_waiting--;
+            wake_up_interactive(&waiter->queue);
+            continue;
+        }
+        if (!found || (int32_t)(waiter->due - next_due) < 0) {
+            next_due = waiter->due;
+            found = 1;
+        }
+        link = &waiter->next;
+    }
+    rtc_next_due = next_due;
+}
+
+/* void rtc_handler(void)
+ * Inputs:      void
+ * Return Value: void
+ * Function: top half, acknowledges the RTC, counts the interrupt and leaves waking the
+ *           readers to rtc_bottom_half */
+void rtc_handler()
+{
+    uint32_t start = rdtsc_low();
+
+    cli();
+
     // read from register C to allow for more interrupts
     outb(RTC_REG_C, RTC_INDEX_PORT);
     inb(RTC_DATA_PORT);
 
-    // when rtc handler is called, sets the rtc intterupt flag to high
-    if (rtc_interrupt_flag == 0)
-    {
-        rtc_interrupt_flag = 1;
+    // readers compare against the count, the bottom half only runs once one of them is due
+    rtc_ticks++;
+    if (rtc_waiting != 0 && (int32_t)(rtc_ticks - rtc_next_due) >= 0) {
+        raise_softirq(SOFTIRQ_RTC);
     }
 
-    sti();
-
     send_eoi(RTC_IRQ);
+    irq_exit(RTC_IRQ, start);
+}
+
+/* void reset_rtc_file(fd_element_t* file)
+ * Inputs:  file -- RTC file to reset
+ * Return Value: N/A
+ * Function: puts the file at the default rate, its first tick a full period from now */
+static void reset_rtc_file(fd_element_t* file)
+{
+    file->rtc_divisor = RTC_DEFAULT_DIVISOR;
+    file->file_position = rtc_ticks + file->rtc_divisor;
+}
+
+/* fd_element_t* rtc_file(int32_t fd)
+ * Inputs:  fd -- file descriptor the driver was called with
+ * Return Value: the caller's open RTC file, or the kernel's when there is no process or fd
+ *               is not an RTC file (tests call the driver directly)
+ * Function: sets a file that was never written to the default rate */
+static fd_element_t* rtc_file(int32_t fd)
+{
+    pcb_t* pcb = (pcb_t*)current_pcb;
+    fd_element_t* file = &kernel_rtc_file;
+
+    if (pcb != NULL && fd >= 0 && fd < FD_ARRAY_LENGTH &&
+        pcb->fd_array[fd].flags == 1 && pcb->fd_array[fd].file_type == RTC_FILE_TYPE) {
+        file = &pcb->fd_array[fd];
+    }
+    if (file->rtc_divisor == 0) {
+        reset_rtc_file(file);
+    }
+    return file;
+}
+
+/* void wait_for_tick(uint32_t due)
+ * Inputs:  due -- value of rtc_ticks to wait for
+ * Return Value: N/A
+ * Function: sleeps on a queue of its own that the bottom half wakes when due comes, called
+ *           with interrupts disabled */
+static void wait_for_tick(uint32_t due)
+{
+    rtc_waiter_t waiter;
+    rtc_waiter_t** link;
+
+    waiter.due = due;
+    waiter.queue.head = NULL;
+    while ((int32_t)(rtc_ticks - due) < 0) {
+        waiter.next = rtc_waiters;
+        rtc_waiters = &waiter;
+        if (rtc_waiting == 0 || (int32_t)(due - rtc_next_due) < 0) {
+            rtc_next_due = due;
+        }
+        rtc_waiting++;
+
+        sleep_on(&waiter.queue);
+
+        // still listed if the wait ended without the bottom half, before there were processes
+        for (link = &rtc_waiters; *link != NULL; link = &(*link)->next) {
+            if (*link == &waiter) {
+                *link = waiter.next;
+                rtc_waiting--;
+                break;
+            }
+        }
+    }
 }
 
 /* int32_t rtc_read (int32_t fd, void* buf, int32_t nbytes)
  * Inputs:  int32_t fd (file descriptor number), void* buf (output buffer),
             int32_t nbytes (number of bytes to be read)
  * Return Value: 0 on success or -1 on failure
- * Function: Wait until a new RTC int is recieved 
+ * Function: waits for the file's next virtual tick and schedules the one after it. A reader
+ *           that comes back late returns at once and the ticks it slept through are skipped,
+ *           so it stays on the same schedule; their number goes in buf when it has room
  * Documentation requirements: Make sure that rtc read must return only after an RTC interrupt has occurred. 
  * You might want to use some sort of flag here.
  * */
 int32_t rtc_read(int32_t fd, void *buf, int32_t nbytes)
 {
-    //sets interrupt flag to 0 and waits for RTC handler to be called
-    rtc_interrupt_flag = 0;
-    while (rtc_interrupt_flag == 0)
-    {
+    fd_element_t* file;
+    uint32_t flags, missed;
+
+    cli_and_save(flags);
+    file = rtc_file(fd);
+    wait_for_tick(file->file_position);
+
+    missed = (rtc_ticks - file->file_position) / file->rtc_divisor;
+    file->file_position += (missed + 1) * file->rtc_divisor;
+    rtc_stats.reads++;
+    rtc_stats.missed_ticks += missed;
+    restore_flags(flags);
+
+    if (buf != NULL && nbytes >= NBYTES_SIZE) {
+        *(uint32_t*)buf = missed;
     }
     return 0;
 }
@@ -90,41 +221,59 @@ int32_t rtc_read(int32_t fd, void *buf, int32_t nbytes)
 /* int32_t rtc_write (int32_t fd, const void* buf, int32_t nbytes)
  * Inputs:  int32_t fd (file descriptor number), void* buf (output buffer),
             int32_t nbytes (number of bytes to be read)
- * Return Value: number of bytes written
- * Function: Writes a new frequency stored in buf to the RTC */
+ * Return Value: number of bytes written, -1 for a frequency that is not a power of 2
+ *               from 2 to 1024
+ * Function: sets this file's virtual frequency, the hardware rate and other files are
+ *           untouched. Its next tick is a full period from now */
 int32_t rtc_write(int32_t fd, const void *buf, int32_t nbytes)
 {
-
-    uint32_t frequency;
+    fd_element_t* file;
+    uint32_t divisor, flags;
 
     //parameter checks
     if (nbytes != NBYTES_SIZE || buf == NULL)
     {
         return -1;
     }
-    else
+
+    divisor = frequency_divisor(*((uint32_t *)buf));
+    if (divisor == 0)
     {
-        //sets frequency from the buffer value
-        frequency = *((uint32_t *)buf);
-        set_rtc_frequency(frequency);
+        return -1;
     }
 
-    // read from register C to allow for more interrupts
-    outb(RTC_REG_C, RTC_INDEX_PORT);
-    inb(RTC_DATA_PORT);
-
-    send_eoi(RTC_IRQ);
+    cli_and_save(flags);
+    file = rtc_file(fd);
+    file->rtc_divisor = divisor;
+    file->file_position = rtc_ticks + divisor;
+    restore_flags(flags);
 
     return nbytes;
 }
 
 /* int32_t rtc_open (const uint8_t* filename)
- * Inputs: int32_t fd (file descriptor number)
- * Return Value: 0 on success or -1 on failure
- * Function: closes the RTC device */
+ * Inputs: filename -- name the file was opened by
+ * Return Value: 0
+ * Function: starts the new file at the default rate. The hardware was set up at boot and
+ *           is never touched here. open clears the divisor of the fd it fills in, so that is
+ *           the caller's RTC file with none, the kernel's file when there is no process */
 int32_t rtc_open(const uint8_t *filename)
 {
-    rtc_init();
+    pcb_t* pcb = (pcb_t*)current_pcb;
+    uint32_t flags;
+    int32_t fd;
+
+    cli_and_save(flags);
+    if (pcb == NULL) {
+        reset_rtc_file(&kernel_rtc_file);
+    }
+    for (fd = 0; pcb != NULL && fd < FD_ARRAY_LENGTH; fd++) {
+        if (pcb->fd_array[fd].flags == 1 && pcb->fd_array[fd].file_type == RTC_FILE_TYPE &&
+            pcb->fd_array[fd].rtc_divisor == 0) {
+            reset_rtc_file(&pcb->fd_array[fd]);
+        }
+    }
+    restore_flags(flags);
     return 0;
 }
 
@@ -139,56 +288,15 @@ int32_t rtc_close(int32_t fd)
 }
 
 
-/* void set_rtc_frequency(uint32_t frequency)
+/* uint32_t frequency_divisor(uint32_t frequency)
  * Inputs: uint32_t frequency (power of 2 from 2 to 1024)
- * Return Value: N/A
- * Function: converts a frequncy to the correct hertz rate and sends to register */
-void set_rtc_frequency(uint32_t frequency)
+ * Return Value: hardware ticks per tick at that frequency, 0 if it is not allowed
+ * Function: the hardware runs at RTC_MAX_FREQUENCY, so every allowed rate divides it */
+static uint32_t frequency_divisor(uint32_t frequency)
 {
-
-    char prev;
-    char rate;
-
-    //case statement for getting the right rate
-    switch (frequency)
+    if (frequency < RTC_MIN_FREQUENCY || frequency > RTC_MAX_FREQUENCY || (frequency & (frequency - 1)) != 0)
     {
-    case HERTZ_2:
-        rate = RATE_2;
-        break;
-    case HERTZ_4:
-        rate = RATE_4;
-        break;
-    case HERTZ_8:
-        rate = RATE_8;
-        break;
-    case HERTZ_16:
-        rate = RATE_16;
-        break;
-    case HERTZ_32:
-        rate = RATE_32;
-        break;
-    case HERTZ_64:
-        rate = RATE_64;
-        break;
-    case HERTZ_128:
-        rate = RATE_128;
-        break;
-    case HERTZ_256:
-        rate = RATE_256;
-        break;
-    case HERTZ_512:
-        rate = RATE_512;
-        break;
-    case HERTZ_1024:
-        rate = RATE_1024;
-        break;
-    default:
-        return;
+        return 0;
     }
-
-    //sets rate based on previously claculated value
-    outb(RTC_REG_A_NMI_BIT, RTC_INDEX_PORT);
-    prev = inb(RTC_DATA_PORT);
-    outb(RTC_REG_A_NMI_BIT, RTC_INDEX_PORT);
-    outb((prev & RTC_RATE_BITS) | rate, RTC_DATA_PORT);
+    return RTC_MAX_FREQUENCY / frequency;
 }
@@ -15,7 +15,7 @@
 
 #define RTC_RATE_MASK                           0x0F
 #define RTC_PREV_MASK                           0xF0
-#define RTC_RATE                                15
+#define RTC_RATE                                RATE_1024
 #define RTC_MIN_RATE                            3
 #define RTC_MIN_FREQUENCY                       2
 #define RTC_MAX_FREQUENCY                       1024
@@ -46,6 +46,20 @@
 
 
 
+/* hardware ticks per virtual tick of a file nobody has written a frequency to */
+#define RTC_DEFAULT_DIVISOR                     (RTC_MAX_FREQUENCY / RTC_MIN_FREQUENCY)
+
+/* RTC interrupts since boot, at RTC_MAX_FREQUENCY */
+extern volatile uint32_t rtc_ticks;
+
+/* virtual ticks handed to readers and the ones they were too late for */
+typedef struct rtc_stats_t {
+    uint32_t reads;                 // rtc_read calls that returned a tick
+    uint32_t missed_ticks;          // virtual ticks that passed between two reads of a file
+} rtc_stats_t;
+
+rtc_stats_t rtc_stats;
+
 void rtc_init();
 void rtc_handler();
 
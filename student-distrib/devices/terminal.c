@@ -55,6 +55,17 @@ terminal_close(int32_t fd) {
 }
 
 
+/* int32_t input_pending(int last_terminal)
+ * Inputs:      last_terminal - active terminal when the reader last redrew its line
+ * Return Value: 1 if the reader has something to do, 0 if it can sleep
+ * Function: checks for enter, a typed character, a screen reset or a terminal switch */
+static int32_t
+input_pending(int last_terminal) {
+    return terminals[active_terminal].enter_flag ||
+           terminals[active_terminal].current_char != terminals[active_terminal].last_current_char ||
+           terminals[active_terminal].reset_flag || active_terminal != last_terminal;
+}
+
 /* int32_t terminal_read(const void* buf, uint32_t nbytes)
  * Inputs:      buf - A pointer to the buffer where keyboard data will be stored
  *              nbytes - The maximum number of bytes to read
@@ -89,17 +100,22 @@ terminal_read(int32_t fd, void* buf, int32_t nbytes) {
             last_terminal = active_terminal;
             terminals[active_terminal].keyboard_buffer[terminals[active_terminal].current_char] = NULL_ASCII;
             
-            // print out the keyboard buffer if we are currently running on our active terminal
-            while(1) {
-                if (scheduled_terminal == active_terminal) {
-                    cli();
-                    set_cursor(terminals[active_terminal].char_in_line, terminals[active_terminal].current_line);
-                    puts(terminals[active_terminal].keyboard_buffer);
-                    sti();
-                    break;
-                }
+            // print out the keyboard buffer once our terminal is the one on screen
+            cli();
+            while (scheduled_terminal != active_terminal) {
+                sleep_on(&keyboard_wait_queue);
             }
+            set_cursor(terminals[active_terminal].char_in_line, terminals[active_terminal].current_line);
+            puts(terminals[active_terminal].keyboard_buffer);
+            sti();
         }
+
+        // block until the keyboard handler changes something
+        cli();
+        if (!input_pending(last_terminal)) {
+            sleep_on(&keyboard_wait_queue);
+        }
+        sti();
     }
 
     terminals[active_terminal].enter_flag = 0;
@@ -219,6 +235,8 @@ terminal_write(int32_t fd, const void* buf, int32_t nbytes) {
  * Function: Updates the keyboard buffer with the input character */
 void
 update_kb_buffer(char input) {
+    int x, y;
+
     // if newline is pressed/has been pressed, don't write
     if ((input == NEWLINE_ASCII) || (terminals[active_terminal].enter_flag)) {
         terminals[active_terminal].enter_flag = 1;
@@ -232,20 +250,19 @@ update_kb_buffer(char input) {
         terminals[active_terminal].keyboard_buffer[terminals[active_terminal].current_char] = NULL_ASCII;
     
         // set page to write to video memory
-        tableArray[VIDEO_MEMORY_PAGE].offset_31_12 = VIDEO >> PAGING_OFFSET;
-        vmemTableArray[VIDMAP_VMEM_LOC_PAGE].offset_31_12 = VIDEO >> PAGING_OFFSET;
-        flush_tlb();
+        set_terminal_video_page(scheduled_terminal, VIDEO);
 
+        // printing moves the scheduled terminal's cursor, it is put back afterwards
+        x = terminals[scheduled_terminal].terminal_screen_x;
+        y = terminals[scheduled_terminal].terminal_screen_y;
         set_cursor(terminals[active_terminal].terminal_screen_x, terminals[active_terminal].terminal_screen_y);
 
         backspace_called();
 
         // reset video page to point to scheduled terminal
-        tableArray[VIDEO_MEMORY_PAGE].offset_31_12 = (TERMINAL_VIDEO + (ALIGN_4KB*scheduled_terminal)) >> PAGING_OFFSET;
-        vmemTableArray[VIDMAP_VMEM_LOC_PAGE].offset_31_12 = (TERMINAL_VIDEO + (ALIGN_4KB*scheduled_terminal)) >> PAGING_OFFSET;
-        flush_tlb();
+        map_terminal_video(scheduled_terminal);
 
-        set_cursor(terminals[scheduled_terminal].terminal_screen_x, terminals[scheduled_terminal].terminal_screen_y);  
+        set_cursor(x, y);
         return;
     } else if (terminals[active_terminal].current_char >= MAX_BUFFER_LENGTH - 1) {
         // if buffer is full, don't write
@@ -265,17 +282,13 @@ void
 clear_terminal() {
      cli();
     // set page to write to video memory
-    tableArray[VIDEO_MEMORY_PAGE].offset_31_12 = VIDEO >> PAGING_OFFSET;
-    vmemTableArray[VIDMAP_VMEM_LOC_PAGE].offset_31_12 = VIDEO >> PAGING_OFFSET;
-    flush_tlb();
+    set_terminal_video_page(scheduled_terminal, VIDEO);
 
     clear();
     set_cursor(0, 0);
 
     // reset video page to point to scheduled terminal
-    tableArray[VIDEO_MEMORY_PAGE].offset_31_12 = (TERMINAL_VIDEO + (ALIGN_4KB*scheduled_terminal)) >> PAGING_OFFSET;
-    vmemTableArray[VIDMAP_VMEM_LOC_PAGE].offset_31_12 = (TERMINAL_VIDEO + (ALIGN_4KB*scheduled_terminal)) >> PAGING_OFFSET;
-    flush_tlb();
+    map_terminal_video(scheduled_terminal);
     sti();
 
     terminals[active_terminal].reset_flag = 1;
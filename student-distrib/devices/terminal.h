@@ -1,4 +1,5 @@
 #include "../lib.h"
+#include "../wait_queue.h"
 
 #define MAX_BUFFER_LENGTH       128
 #define NUM_COLS                80
@@ -29,6 +30,9 @@ typedef struct terminal_info_t {
 
 terminal_info_t terminals[MAX_TERMINALS];
 
+/* readers waiting for the keyboard buffer to change, woken by the keyboard handler */
+wait_queue_t keyboard_wait_queue;
+
 /* open terminal */
 int32_t terminal_open(const uint8_t* filename);
 
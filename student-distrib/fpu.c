@@ -0,0 +1,158 @@
+#include "fpu.h"
+#include "lib.h"
+#include "smp.h"
+
+// FPU state right after fninit, loaded for a process's first FPU instruction
+static uint8_t fpu_initial_state[FXSAVE_AREA_SIZE] __attribute__((aligned (FXSAVE_ALIGN)));
+
+// 0 if the processor has no FXSAVE, the FPU then stays disabled and its use is an exception
+static uint32_t fpu_enabled = 0;
+
+/* void set_task_switched()
+ * Inputs:      None
+ * Return Value: void
+ * Function: sets CR0.TS, the next x87/SSE instruction raises #NM */
+static void
+set_task_switched() {
+    asm volatile(
+        "movl %%cr0, %%eax;"
+        "orl %0, %%eax;"
+        "movl %%eax, %%cr0;"
+        :
+        : "i"(CR0_TS)
+        : "eax", "memory");
+}
+
+/* void init_fpu()
+ * Inputs:      None
+ * Return Value: void
+ * Function: turns on the FPU and SSE when the processor has FXSAVE, saves the clean state
+ *           new processes start with and leaves CR0.TS set */
+void
+init_fpu() {
+    uint32_t eax, ebx, ecx, edx;
+
+    asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(CPUID_FEATURES));
+    if (!(edx & CPUID_FXSR)) {
+        return;
+    }
+
+    asm volatile(
+        "movl %%cr0, %%eax;"
+        "andl %0, %%eax;"
+        "orl %1, %%eax;"
+        "movl %%eax, %%cr0;"
+        "movl %%cr4, %%eax;"
+        "orl %2, %%eax;"
+        "movl %%eax, %%cr4;"
+        "fninit;"
+        "fxsave (%3);"
+        :
+        : "i"(~(CR0_EM | CR0_TS)), "i"(CR0_MP | CR0_NE), "i"(CR4_OSFXSR | CR4_OSXMMEXCPT),
+          "r"(fpu_initial_state)
+        : "eax", "memory");
+
+    fpu_enabled = 1;
+    set_task_switched();
+}
+
+/* void fpu_switch(pcb_t* next)
+ * Inputs:      next -- process about to run, NULL for the idle context
+ * Return Value: void
+ * Function: nothing is saved here. If next owns this processor's FPU registers it can use
+ *           them right away, otherwise CR0.TS makes its first FPU instruction trap to
+ *           handle_fpu_trap */
+void
+fpu_switch(pcb_t* next) {
+    if (!fpu_enabled) {
+        return;
+    }
+    if (next != NULL && next == this_cpu()->fpu_owner) {
+        asm volatile("clts");
+    } else {
+        set_task_switched();
+    }
+}
+
+/* int32_t handle_fpu_trap()
+ * Inputs:      None
+ * Return Value: 0 if the FPU now holds the current process's state, -1 if the #NM is a real error
+ * Function: saves the previous owner's registers into its pcb and loads the current process's,
+ *           or the clean state if it has not used the FPU yet. The scheduler keeps owners on
+ *           the processor holding their registers, so the state is never live elsewhere */
+int32_t
+handle_fpu_trap() {
+    cpu_t* cpu;
+    pcb_t* pcb;
+    pcb_t* fpu_owner;
+    uint32_t flags;
+
+    // a switch in the middle would leave CR0.TS and the owner disagreeing with the registers
+    cli_and_save(flags);
+    cpu = this_cpu();
+    pcb = (pcb_t*)cpu->current;
+    fpu_owner = cpu->fpu_owner;
+    if (!fpu_enabled || pcb == NULL) {
+        restore_flags(flags);
+        return -1;
+    }
+
+    fpu_stats.traps++;
+    asm volatile("clts");
+
+    if (fpu_owner != pcb) {
+        if (fpu_owner != NULL) {
+            asm volatile("fxsave (%0)" : : "r"(fpu_owner->fpu_state) : "memory");
+            fpu_stats.saves++;
+        }
+        if (!pcb->fpu_used) {
+            memcpy(pcb->fpu_state, fpu_initial_state, FXSAVE_AREA_SIZE);
+            pcb->fpu_used = 1;
+        }
+        asm volatile("fxrstor (%0)" : : "r"(pcb->fpu_state) : "memory");
+        fpu_stats.restores++;
+        cpu->fpu_owner = pcb;
+    }
+    restore_flags(flags);
+    return 0;
+}
+
+/* void fpu_release(pcb_t* pcb)
+ * Inputs:      pcb -- process that is exiting
+ * Return Value: void
+ * Function: drops ownership on whichever processor holds its registers, so they are never
+ *           saved into a reused pcb */
+void
+fpu_release(pcb_t* pcb) {
+    uint32_t i;
+
+    for (i = 0; i < num_cpus; i++) {
+        if (cpus[i].fpu_owner == pcb) {
+            cpus[i].fpu_owner = NULL;
+        }
+    }
+    pcb->fpu_used = 0;
+}
+
+/* void fpu_copy(pcb_t* parent, pcb_t* child)
+ * Inputs:      parent -- the current process
+ *              child -- process forked from it, not running yet
+ * Return Value: void
+ * Function: gives the child the parent's FPU registers, read from this processor's FPU if
+ *           the parent owns it there and from its pcb otherwise */
+void
+fpu_copy(pcb_t* parent, pcb_t* child) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    child->fpu_used = parent->fpu_used;
+    if (fpu_enabled && parent->fpu_used) {
+        if (this_cpu()->fpu_owner == parent) {
+            // fpu_switch cleared CR0.TS when the parent was switched in as the owner
+            asm volatile("fxsave (%0)" : : "r"(child->fpu_state) : "memory");
+        } else {
+            memcpy(child->fpu_state, parent->fpu_state, FXSAVE_AREA_SIZE);
+        }
+    }
+    restore_flags(flags);
+}
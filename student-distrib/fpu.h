@@ -0,0 +1,44 @@
+#ifndef _FPU_H
+#define _FPU_H
+
+#include "types.h"
+#include "system_calls.h"
+
+/* CR0 bits: monitor coprocessor, emulation, task switched, native FPU errors */
+#define CR0_MP                  0x00000002
+#define CR0_EM                  0x00000004
+#define CR0_TS                  0x00000008
+#define CR0_NE                  0x00000020
+/* CR4 bits: FXSAVE/FXRSTOR and SSE enabled, unmasked SIMD exceptions raise #XM */
+#define CR4_OSFXSR              0x00000200
+#define CR4_OSXMMEXCPT          0x00000400
+/* CPUID leaf 1 EDX bit for FXSAVE/FXRSTOR */
+#define CPUID_FXSR              0x01000000
+#define CPUID_FEATURES          1
+
+/* lazy FPU switching activity */
+typedef struct fpu_stats_t {
+    uint32_t traps;             // #NM exceptions taken
+    uint32_t saves;             // states written back to their owner's pcb
+    uint32_t restores;          // states loaded into the FPU
+} fpu_stats_t;
+
+fpu_stats_t fpu_stats;
+
+/* enable x87/SSE and FXSAVE, then set CR0.TS so the first use of the FPU traps */
+void init_fpu();
+
+/* called by the scheduler before switching to next (NULL for idle), traps its next FPU use
+   unless the FPU still holds its state */
+void fpu_switch(pcb_t* next);
+
+/* load the current process's state into the FPU after a #NM, 0 if handled */
+int32_t handle_fpu_trap();
+
+/* start a forked child with a copy of the current process's FPU state */
+void fpu_copy(pcb_t* parent, pcb_t* child);
+
+/* forget a halting process's FPU state */
+void fpu_release(pcb_t* pcb);
+
+#endif /* _FPU_H */
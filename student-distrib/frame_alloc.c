@@ -0,0 +1,181 @@
+#include "frame_alloc.h"
+#include "lib.h"
+
+/* one bit per 4KB frame below DIRECT_MAP_END, set when the frame is in use or not RAM */
+static uint32_t frame_bitmap[FRAME_BITMAP_WORDS];
+static uint32_t num_free_frames;
+static uint32_t num_managed_frames;
+/* extra owners of single frames mapped by more than one process, 0 for a frame with one owner */
+static uint16_t frame_shares[MAX_FRAMES];
+
+/* void set_frame_range(uint32_t start, uint32_t end, uint32_t used)
+ * Inputs:      start -- first frame number
+ *              end -- frame number one past the last frame
+ *              used -- 1 to mark the frames in use, 0 to mark them free
+ * Return Value: void
+ * Function: updates the bitmap and the free count for a run of frames */
+static void
+set_frame_range(uint32_t start, uint32_t end, uint32_t used) {
+    uint32_t frame, bit;
+
+    for (frame = start; frame < end && frame < MAX_FRAMES; frame++) {
+        bit = 1 << (frame & 0x1F);
+        if (used && !(frame_bitmap[frame >> 5] & bit)) {
+            frame_bitmap[frame >> 5] |= bit;
+            num_free_frames--;
+        } else if (!used && (frame_bitmap[frame >> 5] & bit)) {
+            frame_bitmap[frame >> 5] &= ~bit;
+            num_free_frames++;
+        }
+    }
+}
+
+/* void add_ram_region(uint32_t base, uint32_t length)
+ * Inputs:      base -- physical start of a usable region
+ *              length -- size of the region in bytes
+ * Return Value: void
+ * Function: frees the whole frames of a region that lie in the allocatable range */
+static void
+add_ram_region(uint32_t base, uint32_t length) {
+    uint32_t end = base + length;
+
+    // clamp regions that wrap past 4GB or reach beyond the direct map
+    if (end < base || end > DIRECT_MAP_END) {
+        end = DIRECT_MAP_END;
+    }
+    if (base < FRAME_ALLOC_START) {
+        base = FRAME_ALLOC_START;
+    }
+    if (base >= end) {
+        return;
+    }
+
+    set_frame_range((base + FRAME_SIZE - 1) >> FRAME_SHIFT, end >> FRAME_SHIFT, 0);
+}
+
+/* void init_frame_allocator(multiboot_info_t* mbi)
+ * Inputs:      mbi -- multiboot information from the bootloader
+ * Return Value: void
+ * Function: marks every frame in use, frees the usable RAM reported by the memory map
+ *           (or mem_upper if there is no map), then reserves the boot modules again */
+void
+init_frame_allocator(multiboot_info_t* mbi) {
+    memory_map_t* mmap;
+    module_t* mod;
+    uint32_t i;
+
+    memset(frame_bitmap, 0xFF, sizeof(frame_bitmap));
+    num_free_frames = 0;
+
+    if (mbi->flags & (1 << 6)) {
+        for (mmap = (memory_map_t*)mbi->mmap_addr;
+             (uint32_t)mmap < mbi->mmap_addr + mbi->mmap_length;
+             mmap = (memory_map_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size))) {
+            // regions above 4GB can never be mapped
+            if (mmap->type != MMAP_TYPE_RAM || mmap->base_addr_high != 0) {
+                continue;
+            }
+            add_ram_region(mmap->base_addr_low, mmap->length_high ? (uint32_t)-mmap->base_addr_low : mmap->length_low);
+        }
+    } else if (mbi->flags & (1 << 0)) {
+        // mem_upper is the RAM above 1MB in KB
+        add_ram_region(0x100000, mbi->mem_upper << 10);
+    }
+
+    if (mbi->flags & (1 << 3)) {
+        mod = (module_t*)mbi->mods_addr;
+        for (i = 0; i < mbi->mods_count; i++) {
+            set_frame_range(mod[i].mod_start >> FRAME_SHIFT, (mod[i].mod_end + FRAME_SIZE - 1) >> FRAME_SHIFT, 1);
+        }
+    }
+
+    num_managed_frames = num_free_frames;
+}
+
+/* uint32_t alloc_frames(uint32_t count)
+ * Inputs:      count -- number of frames, a power of two
+ * Return Value: physical address of the first frame, 0 if no suitable run is free
+ * Function: finds count free frames starting on a multiple of count, so a run of
+ *           FRAMES_PER_4MB can back a 4MB page, and marks them in use */
+uint32_t
+alloc_frames(uint32_t count) {
+    uint32_t frame, i;
+
+    if (count == 0 || count > num_free_frames) {
+        return 0;
+    }
+
+    for (frame = FRAME_ALLOC_START >> FRAME_SHIFT; frame + count <= MAX_FRAMES; frame += count) {
+        // skip words with nothing free when the run fits inside one word
+        if (count <= 32 && frame_bitmap[frame >> 5] == FULL_BITMAP_WORD) {
+            frame = (frame | 0x1F) + 1 - count;
+            continue;
+        }
+        for (i = 0; i < count; i++) {
+            if (frame_bitmap[(frame + i) >> 5] & (1 << ((frame + i) & 0x1F))) {
+                break;
+            }
+        }
+        if (i == count) {
+            set_frame_range(frame, frame + count, 1);
+            return frame << FRAME_SHIFT;
+        }
+    }
+    return 0;
+}
+
+/* void free_frames(uint32_t addr, uint32_t count)
+ * Inputs:      addr -- physical address returned by alloc_frames
+ *              count -- number of frames that were allocated
+ * Return Value: void
+ * Function: marks the frames free again */
+void
+free_frames(uint32_t addr, uint32_t count) {
+    set_frame_range(addr >> FRAME_SHIFT, (addr >> FRAME_SHIFT) + count, 0);
+}
+
+/* void share_frame(uint32_t addr)
+ * Inputs:      addr -- physical address of an allocated frame
+ * Return Value: void
+ * Function: records one more owner, the frame is freed once put_frame has run for each */
+void
+share_frame(uint32_t addr) {
+    frame_shares[addr >> FRAME_SHIFT]++;
+}
+
+/* uint32_t frame_share_count(uint32_t addr)
+ * Inputs:      addr -- physical address of an allocated frame
+ * Return Value: owners besides the caller, 0 if the caller is the only one */
+uint32_t
+frame_share_count(uint32_t addr) {
+    return frame_shares[addr >> FRAME_SHIFT];
+}
+
+/* void put_frame(uint32_t addr)
+ * Inputs:      addr -- physical address of a frame the caller owns
+ * Return Value: void
+ * Function: drops the caller's ownership, freeing the frame if nobody else has it */
+void
+put_frame(uint32_t addr) {
+    if (frame_shares[addr >> FRAME_SHIFT] > 0) {
+        frame_shares[addr >> FRAME_SHIFT]--;
+    } else {
+        free_frames(addr, 1);
+    }
+}
+
+/* uint32_t free_frame_count()
+ * Inputs:      None
+ * Return Value: number of free frames */
+uint32_t
+free_frame_count() {
+    return num_free_frames;
+}
+
+/* uint32_t total_frame_count()
+ * Inputs:      None
+ * Return Value: number of frames found in usable RAM at boot */
+uint32_t
+total_frame_count() {
+    return num_managed_frames;
+}
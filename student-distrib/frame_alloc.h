@@ -0,0 +1,52 @@
+#ifndef _FRAME_ALLOC_H
+#define _FRAME_ALLOC_H
+
+#include "types.h"
+#include "multiboot.h"
+
+#define FRAME_SIZE              0x1000
+#define FRAME_SHIFT             12
+/* frames in one 4MB page */
+#define FRAMES_PER_4MB          1024
+/* frames in one 8KB kernel stack */
+#define KERNEL_STACK_FRAMES     2
+
+/* physical memory below this is the kernel, video memory and the filesystem module */
+#define FRAME_ALLOC_START       0x00800000
+/* physical memory the kernel maps one to one, frames above it are never handed out */
+#define DIRECT_MAP_END          0x08000000
+#define DIRECT_MAP_START_DIR    (FRAME_ALLOC_START >> 22)
+#define DIRECT_MAP_END_DIR      (DIRECT_MAP_END >> 22)
+
+#define MAX_FRAMES              (DIRECT_MAP_END >> FRAME_SHIFT)
+#define FRAME_BITMAP_WORDS      (MAX_FRAMES / 32)
+#define FULL_BITMAP_WORD        0xFFFFFFFF
+
+/* multiboot memory map type for usable RAM */
+#define MMAP_TYPE_RAM           1
+
+/* build the free frame bitmap from the multiboot memory map */
+void init_frame_allocator(multiboot_info_t* mbi);
+
+/* allocate count contiguous frames aligned to count (a power of two), 0 if none are free */
+uint32_t alloc_frames(uint32_t count);
+
+/* return count frames starting at addr to the allocator */
+void free_frames(uint32_t addr, uint32_t count);
+
+/* give a single frame one more owner, such as a process forked while mapping it */
+void share_frame(uint32_t addr);
+
+/* owners of a single frame besides one, 0 if it has a single owner */
+uint32_t frame_share_count(uint32_t addr);
+
+/* drop one owner of a single frame, freeing it when that was the last */
+void put_frame(uint32_t addr);
+
+/* number of frames currently free */
+uint32_t free_frame_count();
+
+/* number of frames the allocator manages */
+uint32_t total_frame_count();
+
+#endif /* _FRAME_ALLOC_H */
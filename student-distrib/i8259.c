@@ -3,6 +3,8 @@
  */
 
 #include "i8259.h"
+#include "ioapic.h"
+#include "lapic.h"
 #include "lib.h"
 
 
@@ -51,6 +53,12 @@ void enable_irq(uint32_t irq_num) {
         slave_mask &= ~(1 << (irq_num - PORT_COUNT));
         value = slave_mask;
     }
+
+    /* the masks still say which IRQs are enabled, the I/O APIC does the masking */
+    if(apic_mode) {
+        ioapic_enable_irq(irq_num);
+        return;
+    }
     outb(value, port);
 }
 
@@ -68,6 +76,11 @@ void disable_irq(uint32_t irq_num) {
         slave_mask |= (1 << (irq_num - PORT_COUNT));
         value = slave_mask;
     }
+
+    if(apic_mode) {
+        ioapic_disable_irq(irq_num);
+        return;
+    }
     outb(value, port);
     
 }
@@ -82,6 +95,12 @@ void send_eoi(uint32_t irq_num) {
         return;
     }
 
+    /* one store to the local APIC instead of port writes */
+    if(apic_mode) {
+        lapic_eoi();
+        return;
+    }
+
     /*if condition sends to both slave and master pic, else sends only to slave*/
     if(irq_num >= PORT_COUNT) {
         outb(data|(irq_num - PORT_COUNT), PIC2_COMMAND);
@@ -91,3 +110,28 @@ void send_eoi(uint32_t irq_num) {
     }
 
 }
+
+/* Mask every line on the 8259 and take it off LINT0, then unmask on the I/O APIC whatever
+ * callers enabled so far. ioapic_init must have succeeded */
+void i8259_use_ioapic(void) {
+    uint32_t saved_flags;
+    uint32_t irq_num;
+
+    cli_and_save(saved_flags);
+
+    outb(0xFF, PIC1_DATA);
+    outb(0xFF, PIC2_DATA);
+    lapic_mask_extint();
+    apic_mode = 1;
+
+    for(irq_num = 0; irq_num < TOTAL_PORT_COUNT; irq_num++) {
+        if(irq_num == SLAVE_PORT) {
+            continue;
+        }
+        if(irq_num < PORT_COUNT ? !(master_mask & (1 << irq_num)) : !(slave_mask & (1 << (irq_num - PORT_COUNT)))) {
+            ioapic_enable_irq(irq_num);
+        }
+    }
+
+    restore_flags(saved_flags);
+}
@@ -40,6 +40,10 @@
 #define PORT_COUNT          8               /* Number of ports on each pic */
 #define TOTAL_PORT_COUNT    PORT_COUNT * 2  /* Total number of ports */
 
+/* 1 once the ISA interrupts come through the I/O APIC, the functions below then mask lines
+ * in its redirection table and acknowledge through the local APIC */
+uint32_t apic_mode;
+
 /* Externally-visible functions */
 
 /* Initialize both PICs */
@@ -50,5 +54,7 @@ void enable_irq(uint32_t irq_num);
 void disable_irq(uint32_t irq_num);
 /* Send end-of-interrupt signal for the specified IRQ */
 void send_eoi(uint32_t irq_num);
+/* Mask the 8259 for good and move every enabled IRQ to the I/O APIC */
+void i8259_use_ioapic(void);
 
 #endif /* _I8259_H */
@@ -5,6 +5,11 @@
 #include "sys_call_asm_linkage.h"
 #include "i8259.h"
 #include "devices/pit.h"
+#include "loader.h"
+#include "fpu.h"
+#include "lapic.h"
+#include "ioapic.h"
+#include "smp.h"
 
 
 //lookup table for exception messages
@@ -93,6 +98,42 @@ init_interrupts() {
             continue;
         }
 
+        // the same devices on the vectors the I/O APIC gives them
+        if (i == APIC_RTC_VECTOR) {
+            handlers[i] = rtc_intr;
+            continue;
+        }
+
+        if (i == APIC_KEYBOARD_VECTOR) {
+            handlers[i] = keyboard_intr;
+            continue;
+        }
+
+        if (i == APIC_PIT_VECTOR) {
+            handlers[i] = pit_intr;
+            continue;
+        }
+
+        if (i == LAPIC_TIMER_VECTOR) {
+            handlers[i] = lapic_timer_intr;
+            continue;
+        }
+
+        if (i == RESCHEDULE_VECTOR) {
+            handlers[i] = reschedule_intr;
+            continue;
+        }
+
+        if (i == TLB_SHOOTDOWN_VECTOR) {
+            handlers[i] = tlb_shootdown_intr;
+            continue;
+        }
+
+        if (i == SPURIOUS_VECTOR) {
+            handlers[i] = spurious_intr;
+            continue;
+        }
+
         handlers[i] = NULL;
     }
 
@@ -146,8 +187,47 @@ init_interrupts() {
  * Function: prints error message to console */
 void
 exception_handler(int exc_num) {
+    // held until halt switches away from the process
+    lock_kernel();
     printf(" %s", exception_lookup[exc_num]);
     exception_in_child = 1;
     
     asm volatile ("jmp halt");
 }
+
+
+/* void page_fault_handler(uint32_t error_code)
+ * Inputs:      error_code -> error code pushed by the processor
+ * Return Value: void
+ * Function: faults in program image pages on demand, any other page fault is reported like an exception */
+void
+page_fault_handler(uint32_t error_code) {
+    uint32_t fault_addr;
+
+    asm volatile ("movl %%cr2, %0" : "=r"(fault_addr));
+
+    lock_kernel();
+    if (handle_user_page_fault(fault_addr, error_code) == 0) {
+        unlock_kernel();
+        return;
+    }
+
+    exception_handler(PAGE_FAULT_EXC_NUM);
+}
+
+
+/* void device_not_available_handler()
+ * Inputs:      None
+ * Return Value: void
+ * Function: loads the current process's FPU state after a lazy switch, any other #NM is
+ *           reported like an exception */
+void
+device_not_available_handler() {
+    lock_kernel();
+    if (handle_fpu_trap() == 0) {
+        unlock_kernel();
+        return;
+    }
+
+    exception_handler(DEVICE_NOT_AVAIL_EXC_NUM);
+}
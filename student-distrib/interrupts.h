@@ -3,6 +3,8 @@
 
 #define NUM_EXCEPTIONS      0x20
 #define SYSTEM_CALL_INDEX   0x80
+#define PAGE_FAULT_EXC_NUM  0x0E
+#define DEVICE_NOT_AVAIL_EXC_NUM    0x07
 
 #define USER_PRIVILEGE_LEVEL    3
 #define KERNEL_PRIVILEGE_LEVEL  0
@@ -11,3 +13,5 @@ uint8_t exception_in_child;
 
 void init_interrupts();
 void exception_handler(int exc_num);
+void page_fault_handler(uint32_t error_code);
+void device_not_available_handler();
@@ -26,3 +26,7 @@ extern void simd_fp_exc();
 extern void keyboard_intr();
 extern void rtc_intr();
 extern void pit_intr();
+extern void lapic_timer_intr();
+extern void reschedule_intr();
+extern void tlb_shootdown_intr();
+extern void spurious_intr();
@@ -0,0 +1,70 @@
+#include "io_ring.h"
+#include "lib.h"
+#include "loader.h"
+#include "system_calls.h"
+
+/* int32_t run_sqe(io_sqe_t* sqe)
+ * Inputs:      sqe -- submission copied out of the ring
+ * Return Value: the result of the operation, -1 for an unknown one */
+static int32_t
+run_sqe(io_sqe_t* sqe) {
+    switch (sqe->opcode) {
+        case IO_OP_READ:
+            return read(sqe->fd, (void*)sqe->addr, sqe->len);
+        case IO_OP_WRITE:
+            return write(sqe->fd, (const void*)sqe->addr, sqe->len);
+        case IO_OP_OPEN:
+            return open((const uint8_t*)sqe->addr);
+        case IO_OP_CLOSE:
+            return close(sqe->fd);
+        default:
+            return -1;
+    }
+}
+
+/* int32_t enter(io_ring_t* ring)
+ * 
+ * Runs the submissions queued in the ring one after another, each like its own system call,
+ * and posts a completion for each. Stops early when the completion ring is full, the rest
+ * stay queued for the next enter.
+ * 
+ * Inputs: ring -- the program's rings, inside its program region
+ * Return Value: submissions run, -1 if the ring is outside the program region, claims more
+ *               queued entries than it holds or io_ring_disabled is set
+ * Function: lets a program move many reads and writes with one system call
+ */
+int32_t
+enter(io_ring_t* ring) {
+    io_sqe_t sqe;
+    io_cqe_t* cqe;
+    uint32_t head, tail, cq_tail;
+    int32_t done = 0;
+
+    if (io_ring_disabled || (uint32_t)ring < USER_IMAGE_BASE ||
+        (uint32_t)ring > USER_IMAGE_END - sizeof(io_ring_t) || ((uint32_t)ring & 0x3) != 0) {
+        return -1;
+    }
+
+    head = ring->sq_head;
+    tail = ring->sq_tail;
+    cq_tail = ring->cq_tail;
+    if (tail - head > IO_RING_ENTRIES || cq_tail - ring->cq_head > IO_RING_ENTRIES) {
+        return -1;
+    }
+
+    while (head != tail && cq_tail - ring->cq_head < IO_RING_ENTRIES) {
+        // copied first, the program could change the entry while a read sleeps
+        sqe = ring->sqes[head & IO_RING_MASK];
+        ring->sq_head = ++head;
+
+        cqe = &ring->cqes[cq_tail & IO_RING_MASK];
+        cqe->result = run_sqe(&sqe);
+        cqe->user_data = sqe.user_data;
+        ring->cq_tail = ++cq_tail;
+        done++;
+    }
+
+    io_ring_stats.enters++;
+    io_ring_stats.ops += done;
+    return done;
+}
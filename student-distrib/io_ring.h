@@ -0,0 +1,59 @@
+#ifndef _IO_RING_H
+#define _IO_RING_H
+
+#include "types.h"
+
+/* submission and completion queue entries per ring, a power of 2. The layout is shared with
+   the user library in syscalls/ece391syscall.h */
+#define IO_RING_ENTRIES             64
+#define IO_RING_MASK                (IO_RING_ENTRIES - 1)
+
+/* operations a submission can ask for, each runs like the system call of the same name */
+#define IO_OP_READ                  0
+#define IO_OP_WRITE                 1
+#define IO_OP_OPEN                  2
+#define IO_OP_CLOSE                 3
+
+/* one queued operation: fd, addr and len are the arguments of the call, open takes the file
+   name in addr. user_data is copied to the completion untouched */
+typedef struct io_sqe_t {
+    uint32_t opcode;
+    int32_t fd;
+    uint32_t addr;
+    int32_t len;
+    uint32_t user_data;
+} io_sqe_t;
+
+/* result of a submission, what the system call would have returned */
+typedef struct io_cqe_t {
+    int32_t result;
+    uint32_t user_data;
+} io_cqe_t;
+
+/* rings in a page of the program's memory, which the kernel reads and writes in place. The
+   program advances sq_tail and cq_head, enter advances sq_head and cq_tail. Indices only
+   grow, an entry is at index & IO_RING_MASK */
+typedef struct io_ring_t {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    io_sqe_t sqes[IO_RING_ENTRIES];
+    io_cqe_t cqes[IO_RING_ENTRIES];
+} io_ring_t;
+
+/* ring activity since boot */
+typedef struct io_ring_stats_t {
+    uint32_t enters;            // enter calls that ran submissions
+    uint32_t ops;               // submissions run
+} io_ring_stats_t;
+
+io_ring_stats_t io_ring_stats;
+
+/* 1 makes enter fail so programs fall back to one system call per operation, for comparing */
+uint32_t io_ring_disabled;
+
+/* run the ring's queued submissions in order and post their completions */
+int32_t enter (io_ring_t* ring);
+
+#endif /* _IO_RING_H */
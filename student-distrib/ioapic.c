@@ -0,0 +1,172 @@
+#include "ioapic.h"
+#include "lapic.h"
+#include "lib.h"
+#include "smp.h"
+#include "i8259.h"
+#include "devices/pit.h"
+#include "devices/keyboard.h"
+#include "devices/rtc.h"
+
+// registers of the I/O APIC, 0 if the MP table listed none inside the APIC page
+static uint32_t ioapic_base;
+static uint32_t ioapic_apic_id;
+
+// input pin and MP flags of each ISA IRQ, the same pin with the bus defaults unless the
+// MP table says otherwise
+static uint8_t isa_pin[ISA_IRQS];
+static uint16_t isa_flags[ISA_IRQS];
+static uint32_t isa_overridden;
+
+// IOREGSEL and IOWIN are one access to whoever selected last
+static spinlock_t ioapic_lock;
+
+/* uint32_t ioapic_read(uint32_t reg)
+ * Inputs:      reg -- register index
+ * Return Value: register contents, the caller holds ioapic_lock */
+static uint32_t
+ioapic_read(uint32_t reg) {
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_REGSEL) = reg;
+    return *(volatile uint32_t*)(ioapic_base + IOAPIC_WINDOW);
+}
+
+/* void ioapic_write(uint32_t reg, uint32_t value)
+ * Inputs:      reg -- register index
+ *              value -- value to store
+ * Return Value: void, the caller holds ioapic_lock */
+static void
+ioapic_write(uint32_t reg, uint32_t value) {
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_REGSEL) = reg;
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_WINDOW) = value;
+}
+
+/* uint32_t isa_vector(uint32_t irq)
+ * Inputs:      irq -- ISA line
+ * Return Value: vector the line is delivered on, its priority class is vector >> 4 */
+static uint32_t
+isa_vector(uint32_t irq) {
+    switch (irq) {
+        case PIT_LINE:
+            return APIC_PIT_VECTOR;
+        case KEYBOARD_IRQ:
+            return APIC_KEYBOARD_VECTOR;
+        case RTC_IRQ:
+            return APIC_RTC_VECTOR;
+        default:
+            return APIC_OTHER_VECTOR(irq);
+    }
+}
+
+/* void set_masked(uint32_t irq, uint32_t masked)
+ * Inputs:      irq -- ISA line
+ *              masked -- IOAPIC_MASKED or 0
+ * Return Value: void
+ * Function: rewrites the line's redirection entry, keeping its vector, trigger and polarity */
+static void
+set_masked(uint32_t irq, uint32_t masked) {
+    uint32_t flags, low;
+
+    if (ioapic_base == 0 || irq >= ISA_IRQS) {
+        return;
+    }
+    cli_and_save(flags);
+    spin_lock(&ioapic_lock);
+    low = ioapic_read(IOAPIC_REDTBL(isa_pin[irq]));
+    ioapic_write(IOAPIC_REDTBL(isa_pin[irq]), (low & ~IOAPIC_MASKED) | masked);
+    spin_unlock(&ioapic_lock);
+    restore_flags(flags);
+}
+
+/* void ioapic_found(uint32_t apic_id, uint32_t addr)
+ * Inputs:      apic_id -- ID the MP table gives the I/O APIC
+ *              addr -- physical address of its registers
+ * Return Value: void
+ * Function: keeps the first I/O APIC whose registers are in the mapped APIC page */
+void
+ioapic_found(uint32_t apic_id, uint32_t addr) {
+    uint32_t irq;
+
+    if (ioapic_base != 0 || (addr >> 22) != APIC_MMIO_DIR) {
+        return;
+    }
+    ioapic_base = addr;
+    ioapic_apic_id = apic_id;
+    for (irq = 0; irq < ISA_IRQS; irq++) {
+        if (!(isa_overridden & (1 << irq))) {
+            isa_pin[irq] = irq;
+        }
+    }
+}
+
+/* void ioapic_route_isa(uint32_t irq, uint32_t apic_id, uint32_t pin, uint32_t flags)
+ * Inputs:      irq -- ISA line
+ *              apic_id -- I/O APIC the line is wired to
+ *              pin -- input pin on that I/O APIC
+ *              flags -- MP polarity and trigger flags
+ * Return Value: void
+ * Function: remembers where an ISA line really goes, the timer is usually on pin 2 */
+void
+ioapic_route_isa(uint32_t irq, uint32_t apic_id, uint32_t pin, uint32_t flags) {
+    if (ioapic_base == 0 || apic_id != ioapic_apic_id || irq >= ISA_IRQS) {
+        return;
+    }
+    isa_pin[irq] = pin;
+    isa_flags[irq] = flags;
+    isa_overridden |= 1 << irq;
+}
+
+/* int32_t ioapic_init(uint32_t imcr)
+ * Inputs:      imcr -- 1 if the MP table says the board starts in PIC mode behind the IMCR
+ * Return Value: 0 on success, -1 if there is no usable I/O APIC
+ * Function: points every ISA line at the boot processor on its own vector, masked until
+ *           enable_irq, and takes the 8259 off the processor's INTR pin if the IMCR exists */
+int32_t
+ioapic_init(uint32_t imcr) {
+    uint32_t irq, pins, low, flags;
+
+    if (ioapic_base == 0) {
+        return -1;
+    }
+
+    cli_and_save(flags);
+    spin_lock(&ioapic_lock);
+    pins = ((ioapic_read(IOAPIC_VERSION) >> IOAPIC_MAX_REDIR_SHIFT) & IOAPIC_MAX_REDIR_MASK) + 1;
+    for (irq = 0; irq < ISA_IRQS; irq++) {
+        // the cascade has nothing behind it once the 8259 is gone
+        if (irq == SLAVE_PORT || isa_pin[irq] >= pins) {
+            continue;
+        }
+        low = IOAPIC_MASKED | isa_vector(irq);
+        if ((isa_flags[irq] & MP_POLARITY_MASK) == MP_POLARITY_LOW) {
+            low |= IOAPIC_ACTIVE_LOW;
+        }
+        if ((isa_flags[irq] & MP_TRIGGER_MASK) == MP_TRIGGER_LEVEL) {
+            low |= IOAPIC_LEVEL;
+        }
+        ioapic_write(IOAPIC_REDTBL(isa_pin[irq]) + 1, cpus[BOOT_CPU].apic_id << IOAPIC_DEST_SHIFT);
+        ioapic_write(IOAPIC_REDTBL(isa_pin[irq]), low);
+    }
+    spin_unlock(&ioapic_lock);
+
+    if (imcr) {
+        outb(IMCR_ADDR, IMCR_SELECT_PORT);
+        outb(IMCR_APIC_MODE, IMCR_DATA_PORT);
+    }
+    restore_flags(flags);
+    return 0;
+}
+
+/* void ioapic_enable_irq(uint32_t irq)
+ * Inputs:      irq -- ISA line
+ * Return Value: void */
+void
+ioapic_enable_irq(uint32_t irq) {
+    set_masked(irq, 0);
+}
+
+/* void ioapic_disable_irq(uint32_t irq)
+ * Inputs:      irq -- ISA line
+ * Return Value: void */
+void
+ioapic_disable_irq(uint32_t irq) {
+    set_masked(irq, IOAPIC_MASKED);
+}
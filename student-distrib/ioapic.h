@@ -0,0 +1,56 @@
+#ifndef _IOAPIC_H
+#define _IOAPIC_H
+
+#include "types.h"
+
+/* I/O APIC registers are selected through IOREGSEL and accessed through IOWIN, it sits at
+   the bottom of the APIC_MMIO_BASE page */
+#define IOAPIC_REGSEL               0x00
+#define IOAPIC_WINDOW               0x10
+#define IOAPIC_VERSION              0x01
+#define IOAPIC_MAX_REDIR_SHIFT      16
+#define IOAPIC_MAX_REDIR_MASK       0xFF
+#define IOAPIC_REDTBL(pin)          (0x10 + 2 * (pin))
+
+/* redirection entry bits, fixed delivery to a physical APIC ID */
+#define IOAPIC_MASKED               0x10000
+#define IOAPIC_LEVEL                0x08000
+#define IOAPIC_ACTIVE_LOW           0x02000
+#define IOAPIC_DEST_SHIFT           24
+
+/* MP interrupt assignment flags, 0 in a field means the ISA default of edge and active high */
+#define MP_POLARITY_MASK            0x3
+#define MP_POLARITY_LOW             0x3
+#define MP_TRIGGER_MASK             0xC
+#define MP_TRIGGER_LEVEL            0xC
+
+/* interrupt mode configuration register, routes the 8259 past the local APIC in PIC mode */
+#define IMCR_SELECT_PORT            0x22
+#define IMCR_DATA_PORT              0x23
+#define IMCR_ADDR                   0x70
+#define IMCR_APIC_MODE              0x01
+
+#define ISA_IRQS                    16
+
+/* vectors of the ISA lines. The local APIC delivers the pending vector with the highest
+   vector >> 4 first, so the timer beats the keyboard and the keyboard beats the RTC.
+   Unused lines share the lowest class */
+#define APIC_PIT_VECTOR             0xE0
+#define APIC_KEYBOARD_VECTOR        0xD1
+#define APIC_RTC_VECTOR             0xC8
+#define APIC_OTHER_VECTOR(irq)      (0x30 + (irq))
+
+/* record the first I/O APIC in the MP table, later ones are ignored */
+void ioapic_found(uint32_t apic_id, uint32_t addr);
+
+/* record that ISA irq is wired to pin of the I/O APIC with apic_id, with MP flags */
+void ioapic_route_isa(uint32_t irq, uint32_t apic_id, uint32_t pin, uint32_t flags);
+
+/* program every ISA line masked and pointed at the boot processor, -1 without an I/O APIC */
+int32_t ioapic_init(uint32_t imcr);
+
+/* unmask or mask an ISA line */
+void ioapic_enable_irq(uint32_t irq);
+void ioapic_disable_irq(uint32_t irq);
+
+#endif /* _IOAPIC_H */
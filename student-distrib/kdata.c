@@ -0,0 +1,114 @@
+#include "kdata.h"
+#include "lib.h"
+#include "paging.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "devices/pit.h"
+
+/* the shared page, padded so nothing else in the kernel shares its frame */
+static union {
+    kernel_data_t data;
+    uint8_t page[ALIGN_4KB];
+} kernel_data __attribute__((aligned (ALIGN_4KB)));
+
+// TSC at the last update, and the fraction of a ns the clock was short by then
+static uint64_t last_tsc;
+static uint32_t ns_fraction;
+
+/* uint64_t rdtsc()
+ * Inputs:      None
+ * Return Value: the whole time stamp counter */
+static uint64_t
+rdtsc() {
+    uint64_t tsc;
+
+    asm volatile("rdtsc" : "=A"(tsc));
+    return tsc;
+}
+
+/* uint32_t kernel_data_frame()
+ * Inputs:      None
+ * Return Value: physical address of the shared page, the kernel is mapped one to one */
+uint32_t
+kernel_data_frame() {
+    return (uint32_t)&kernel_data;
+}
+
+/* void init_kernel_data()
+ * Inputs:      None
+ * Return Value: void
+ * Function: counts TSC cycles over KDATA_CALIBRATE_TICKS PIT ticks, starting on a tick edge,
+ *           and publishes the cycle length in ns. Until then the page has ticks but no clock */
+void
+init_kernel_data() {
+    volatile uint32_t* pit_interrupts = &pit_stats.interrupts;
+    uint32_t start, tsc_hz, quotient;
+    uint64_t begin;
+
+    start = *pit_interrupts;
+    while (*pit_interrupts == start);
+    begin = rdtsc();
+    start = *pit_interrupts;
+    while (*pit_interrupts - start < KDATA_CALIBRATE_TICKS);
+    tsc_hz = (uint32_t)(rdtsc() - begin) / KDATA_CALIBRATE_TICKS * pit_hz;
+
+    // NS_PER_SEC << KDATA_NS_SHIFT does not fit 32 bits, divl takes the 64 bit dividend
+    if (tsc_hz <= (NS_PER_SEC >> (32 - KDATA_NS_SHIFT))) {
+        return;
+    }
+    asm volatile("divl %3"
+                 : "=a"(quotient), "=d"(start)
+                 : "a"((uint32_t)NS_PER_SEC << KDATA_NS_SHIFT), "r"(tsc_hz),
+                   "d"(NS_PER_SEC >> (32 - KDATA_NS_SHIFT)));
+
+    last_tsc = rdtsc();
+    kernel_data.data.tick_hz = pit_hz;
+    kernel_data.data.ns_mult = quotient;
+}
+
+/* void update_kernel_data()
+ * Inputs:      None
+ * Return Value: void
+ * Function: called by the tick on the boot processor. The clock advances by the cycles since
+ *           the last update, which keeps the product small, carrying the fraction of a ns
+ *           over. A reader that overlaps the update sees seq odd or changed and reads again */
+void
+update_kernel_data() {
+    kernel_data_t* data = &kernel_data.data;
+    uint64_t tsc = rdtsc();
+    uint64_t ns = ((uint64_t)data->ns_high << 32) | data->ns_low;
+    uint64_t scaled;
+
+    if (data->ns_mult != 0) {
+        scaled = (tsc - last_tsc) * data->ns_mult + ns_fraction;
+        ns += scaled >> KDATA_NS_SHIFT;
+        ns_fraction = (uint32_t)scaled & ((1 << KDATA_NS_SHIFT) - 1);
+    }
+    last_tsc = tsc;
+
+    data->seq++;
+    asm volatile("" : : : "memory");
+    data->ticks = timer_ticks;
+    data->tick_hz = pit_hz;
+    data->active_terminal = active_terminal;
+    data->tsc_low = (uint32_t)tsc;
+    data->tsc_high = (uint32_t)(tsc >> 32);
+    data->ns_low = (uint32_t)ns;
+    data->ns_high = (uint32_t)(ns >> 32);
+    asm volatile("" : : : "memory");
+    data->seq++;
+}
+
+/* void set_process_data(pcb_t* pcb, uint32_t frame)
+ * Inputs:      pcb -- process being set up, its pid, parent and terminal set
+ *              frame -- its own page, in the kernel's direct map
+ * Return Value: void */
+void
+set_process_data(pcb_t* pcb, uint32_t frame) {
+    process_data_t* data = (process_data_t*)frame;
+
+    memset(data, 0, ALIGN_4KB);
+    data->pid = pcb->process_id;
+    data->parent_pid = pcb->parent_process_id;
+    data->terminal = pcb->terminal;
+}
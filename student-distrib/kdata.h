@@ -0,0 +1,54 @@
+#ifndef _KDATA_H
+#define _KDATA_H
+
+#include "types.h"
+#include "system_calls.h"
+
+/* directory entry of the read-only kernel data pages, right after the vidmap one. Page 0 is
+   shared by every process, page 1 is the process's own. The layouts are repeated for
+   programs in syscalls/ece391support.h */
+#define KDATA_DIR                   36
+#define KDATA_SHARED_PAGE           0
+#define KDATA_PROCESS_PAGE          1
+
+/* ns per TSC cycle is published as a fixed point number with this many fraction bits */
+#define KDATA_NS_SHIFT              24
+#define NS_PER_SEC                  1000000000
+
+/* PIT ticks the TSC is timed over at boot */
+#define KDATA_CALIBRATE_TICKS       4
+
+/* updated by the tick on the boot processor. seq is odd while an update is in progress,
+   readers retry until they see the same even value before and after reading */
+typedef struct kernel_data_t {
+    volatile uint32_t seq;
+    volatile uint32_t ticks;            // timer ticks at the last tick, readers add those since by the TSC
+    volatile uint32_t tick_hz;
+    volatile uint32_t active_terminal;  // terminal on the screen
+    volatile uint32_t tsc_low;          // TSC at the last tick
+    volatile uint32_t tsc_high;
+    volatile uint32_t ns_low;           // ns since boot at that TSC
+    volatile uint32_t ns_high;
+    volatile uint32_t ns_mult;          // ns per TSC cycle << KDATA_NS_SHIFT, 0 until calibrated
+} kernel_data_t;
+
+/* written when the process is set up, it never changes while the process runs */
+typedef struct process_data_t {
+    int32_t pid;
+    int32_t parent_pid;                 // NO_PARENT for base shells and background jobs
+    uint32_t terminal;
+} process_data_t;
+
+/* frame holding the shared page, mapped read-only into every process */
+uint32_t kernel_data_frame();
+
+/* time the TSC against the PIT, the PIT must be ticking with interrupts enabled */
+void init_kernel_data();
+
+/* publish the tick count, clock and active terminal, called by every tick */
+void update_kernel_data();
+
+/* fill a process's own page */
+void set_process_data(pcb_t* pcb, uint32_t frame);
+
+#endif /* _KDATA_H */
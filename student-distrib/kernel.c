@@ -16,6 +16,13 @@
 #include "devices/rtc.h"
 #include "system_calls.h"
 #include "devices/pit.h"
+#include "frame_alloc.h"
+#include "scheduler.h"
+#include "fpu.h"
+#include "smp.h"
+#include "timer.h"
+#include "sysenter.h"
+#include "kdata.h"
 
 /* Macros. */
 /* Check if the bit BIT in FLAGS is set. */
@@ -144,6 +151,11 @@ void entry(unsigned long magic, unsigned long addr) {
         ltr(KERNEL_TSS);
     }
 
+    /* The boot processor is cpus[BOOT_CPU], it holds the big kernel lock until the first
+     * process it switches to leaves the kernel */
+    init_boot_cpu();
+    lock_kernel();
+
     /*init IDT*/
     lidt(idt_desc_ptr);
     init_interrupts();
@@ -151,37 +163,65 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Init the PIC */
     i8259_init();
 
+    /*hand the usable RAM from the memory map to the frame allocator, paging takes frames from it*/
+    init_frame_allocator(mbi);
+    printf("%u free frames\n", free_frame_count());
+
+    /*initialize the paging*/
+    init_paging();
+
+    /*turn on x87/SSE, processes get FPU state lazily on their first FPU instruction*/
+    init_fpu();
+
+    /*let programs enter system calls with SYSENTER as well as int $0x80*/
+    init_sysenter();
+
+    /*move the ISA interrupts to the I/O APIC if the MP tables list one, before any line is enabled*/
+    init_apic();
+
     /* Initialize devices, memory, filesystem, enable device interrupts on the
      * PIC, any other initialization stuff... */
 
     // initialize keyboard
     keyboard_init();
 
-    // initialize rtc
-    rtc_open(0);
+    // initialize rtc, it runs at its fastest rate from here on and open files count its ticks
+    rtc_init();
 
-    //initialize pit
-    init_pit();
+    //empty timer wheel, the PIT tick drives it
+    init_timers();
+
+    //pid limit, raised or lowered with max_pids=<n> on the command line
+    init_pids(CHECK_FLAG(mbi->flags, 2) ? (const int8_t*)mbi->cmdline : NULL);
+
+    //initialize pit, the command line can pick the tick rate (pit_hz=<rate>) and turn off tickless idle (notickless)
+    init_pit(CHECK_FLAG(mbi->flags, 2) ? (const int8_t*)mbi->cmdline : NULL);
 
     /* Enable interrupts */
     /* Do not enable the following until after you have set up your
      * IDT correctly otherwise QEMU will triple fault and simple close
      * without showing you any output */
     printf("Enabling Interrupts\n");
-
-    /*initialize the paging*/
-    init_paging();
     
     sti();
 
     clear();
 
+    /*switch the tick to the local APIC timer and start the other processors listed in the MP
+     *tables, they wait for the lock to schedule*/
+    init_smp();
+
+    /*time the TSC so the kernel data page every process maps can carry a ns clock*/
+    init_kernel_data();
+
 #if (RUN_TESTS)
     /* Run tests */
     launch_tests();
 #endif
-    /* Execute the first program ("shell") ... */
-    execute((uint8_t*)"shell");
+    /* Queue the first program ("shell") and hand the CPU to the scheduler for good */
+    start_terminal_shell(TERMINAL_1);
+    cli();
+    scheduler();
 
     /* Spin (nicely, so we don't chew up cycles) */
     asm volatile (".1: hlt; jmp .1;");
@@ -0,0 +1,195 @@
+#include "lapic.h"
+#include "lib.h"
+#include "smp.h"
+#include "scheduler.h"
+#include "devices/pit.h"
+
+/* uint32_t lapic_read(uint32_t reg)
+ * Inputs:      reg -- register offset
+ * Return Value: register contents */
+static uint32_t
+lapic_read(uint32_t reg) {
+    return *(volatile uint32_t*)(LAPIC_DEFAULT_BASE + reg);
+}
+
+/* void lapic_write(uint32_t reg, uint32_t value)
+ * Inputs:      reg -- register offset
+ *              value -- value to store
+ * Return Value: void */
+static void
+lapic_write(uint32_t reg, uint32_t value) {
+    *(volatile uint32_t*)(LAPIC_DEFAULT_BASE + reg) = value;
+}
+
+/* void lapic_send_icr(uint32_t apic_id, uint32_t command)
+ * Inputs:      apic_id -- destination, ignored by the shorthands
+ *              command -- low word of the interrupt command register
+ * Return Value: void
+ * Function: writes the destination then the command, which sends the IPI, and waits
+ *           until the local APIC has accepted it */
+static void
+lapic_send_icr(uint32_t apic_id, uint32_t command) {
+    lapic_write(LAPIC_ICR_HIGH, apic_id << ICR_DEST_SHIFT);
+    lapic_write(LAPIC_ICR_LOW, command);
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_SEND_PENDING) {
+        asm volatile("pause");
+    }
+}
+
+/* void lapic_init()
+ * Inputs:      None
+ * Return Value: void
+ * Function: software enables the local APIC with the spurious vector and clears the task
+ *           priority so every vector is delivered. The 8259 stays wired to the boot
+ *           processor's LINT0 in virtual wire mode, the other processors mask it */
+void
+lapic_init() {
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | SPURIOUS_VECTOR);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR);
+    if (this_cpu()->id == BOOT_CPU) {
+        lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_EXTINT);
+        lapic_enabled = 1;
+    } else {
+        lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    }
+}
+
+/* void lapic_mask_extint()
+ * Inputs:      None
+ * Return Value: void
+ * Function: masks LINT0 on the calling processor, the 8259 is no longer wired through it */
+void
+lapic_mask_extint() {
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+}
+
+/* uint32_t lapic_id()
+ * Inputs:      None
+ * Return Value: APIC ID of the calling processor */
+uint32_t
+lapic_id() {
+    return lapic_read(LAPIC_ID) >> LAPIC_ID_SHIFT;
+}
+
+/* void lapic_eoi()
+ * Inputs:      None
+ * Return Value: void
+ * Function: tells the local APIC the current interrupt is handled */
+void
+lapic_eoi() {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/* void lapic_send_ipi(uint32_t apic_id, uint32_t vector)
+ * Inputs:      apic_id -- processor to interrupt
+ *              vector -- IDT vector it runs
+ * Return Value: void */
+void
+lapic_send_ipi(uint32_t apic_id, uint32_t vector) {
+    lapic_send_icr(apic_id, ICR_FIXED | ICR_LEVEL_ASSERT | vector);
+}
+
+/* void lapic_send_ipi_others(uint32_t vector)
+ * Inputs:      vector -- IDT vector the other processors run
+ * Return Value: void */
+void
+lapic_send_ipi_others(uint32_t vector) {
+    lapic_send_icr(0, ICR_ALL_BUT_SELF | ICR_FIXED | ICR_LEVEL_ASSERT | vector);
+}
+
+/* void lapic_send_init(uint32_t apic_id)
+ * Inputs:      apic_id -- processor to reset
+ * Return Value: void
+ * Function: asserts then deasserts INIT, the processor waits for a startup IPI afterwards */
+void
+lapic_send_init(uint32_t apic_id) {
+    lapic_send_icr(apic_id, ICR_INIT | ICR_LEVEL_TRIGGER | ICR_LEVEL_ASSERT);
+    lapic_send_icr(apic_id, ICR_INIT | ICR_LEVEL_TRIGGER);
+}
+
+/* void lapic_send_startup(uint32_t apic_id, uint32_t page)
+ * Inputs:      apic_id -- processor waiting after INIT
+ *              page -- physical page below 1MB it starts executing at in real mode
+ * Return Value: void */
+void
+lapic_send_startup(uint32_t apic_id, uint32_t page) {
+    lapic_send_icr(apic_id, ICR_STARTUP | page);
+}
+
+/* void lapic_calibrate_timer()
+ * Inputs:      None
+ * Return Value: void
+ * Function: lets the timer count down from its maximum for LAPIC_CALIBRATE_TICKS PIT ticks,
+ *           starting on a tick edge, and keeps the counts per tick. The PIT must be ticking
+ *           periodically with interrupts enabled */
+void
+lapic_calibrate_timer() {
+    volatile uint32_t* pit_interrupts = &pit_stats.interrupts;
+    uint32_t start;
+
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_DIVIDE_BY_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR);
+
+    start = *pit_interrupts;
+    while (*pit_interrupts == start);
+
+    lapic_write(LAPIC_TIMER_INITIAL, LAPIC_TIMER_MAX_COUNT);
+    start = *pit_interrupts;
+    while (*pit_interrupts - start < LAPIC_CALIBRATE_TICKS);
+
+    lapic_ticks_per_pit_tick = (LAPIC_TIMER_MAX_COUNT - lapic_read(LAPIC_TIMER_CURRENT)) / LAPIC_CALIBRATE_TICKS;
+    lapic_write(LAPIC_TIMER_INITIAL, 0);
+}
+
+/* void lapic_timer_start()
+ * Inputs:      None
+ * Return Value: void
+ * Function: interrupts the calling processor periodically at the same rate as the PIT, so
+ *           quanta measured in PIT ticks mean the same time everywhere */
+void
+lapic_timer_start() {
+    if (lapic_ticks_per_pit_tick == 0) {
+        return;
+    }
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_DIVIDE_BY_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INITIAL, lapic_ticks_per_pit_tick);
+}
+
+/* void lapic_timer_oneshot(uint32_t counts)
+ * Inputs:      counts -- timer decrements at divide by 16 until the interrupt
+ * Return Value: void
+ * Function: replaces the periodic timer with a single interrupt, lapic_timer_start goes back */
+void
+lapic_timer_oneshot(uint32_t counts) {
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_DIVIDE_BY_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INITIAL, counts);
+}
+
+/* uint32_t lapic_timer_remaining()
+ * Inputs:      None
+ * Return Value: current count of the calling processor's timer, 0 once a one-shot fired */
+uint32_t
+lapic_timer_remaining() {
+    return lapic_read(LAPIC_TIMER_CURRENT);
+}
+
+/* void lapic_timer_handler()
+ * Inputs:      None
+ * Return Value: void
+ * Function: on the boot processor the timer only runs once it replaced the PIT, and does the
+ *           system-wide tick work. Elsewhere it charges a tick to the process running there */
+void
+lapic_timer_handler() {
+    lock_kernel();
+    lapic_eoi();
+    if (this_cpu()->id == BOOT_CPU) {
+        system_tick();
+    } else {
+        cli();
+        scheduler_tick(1);
+    }
+    unlock_kernel();
+}
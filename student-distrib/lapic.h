@@ -0,0 +1,94 @@
+#ifndef _LAPIC_H
+#define _LAPIC_H
+
+#include "types.h"
+
+/* the IOAPIC and local APIC registers share one 4MB uncached kernel page */
+#define APIC_MMIO_BASE              0xFEC00000
+#define APIC_MMIO_DIR               (APIC_MMIO_BASE >> 22)
+#define LAPIC_DEFAULT_BASE          0xFEE00000
+
+/* local APIC register offsets */
+#define LAPIC_ID                    0x020
+#define LAPIC_TPR                   0x080
+#define LAPIC_EOI                   0x0B0
+#define LAPIC_SVR                   0x0F0
+#define LAPIC_ICR_LOW               0x300
+#define LAPIC_ICR_HIGH              0x310
+#define LAPIC_LVT_TIMER             0x320
+#define LAPIC_LVT_LINT0             0x350
+#define LAPIC_TIMER_INITIAL         0x380
+#define LAPIC_TIMER_CURRENT         0x390
+#define LAPIC_TIMER_DIVIDE          0x3E0
+
+#define LAPIC_ID_SHIFT              24
+#define LAPIC_SVR_ENABLE            0x100
+#define LAPIC_LVT_MASKED            0x10000
+#define LAPIC_LVT_EXTINT            0x00700
+#define LAPIC_TIMER_PERIODIC        0x20000
+#define LAPIC_DIVIDE_BY_16          0x3
+#define LAPIC_TIMER_MAX_COUNT       0xFFFFFFFF
+
+/* interrupt command register: delivery modes, level, delivery status and shorthands */
+#define ICR_FIXED                   0x00000
+#define ICR_INIT                    0x00500
+#define ICR_STARTUP                 0x00600
+#define ICR_LEVEL_ASSERT            0x04000
+#define ICR_LEVEL_TRIGGER           0x08000
+#define ICR_SEND_PENDING            0x01000
+#define ICR_ALL_BUT_SELF            0xC0000
+#define ICR_DEST_SHIFT              24
+
+/* vectors above the 8259's, the I/O APIC's and the system call */
+#define LAPIC_TIMER_VECTOR          0xF0
+#define RESCHEDULE_VECTOR           0xF1
+#define TLB_SHOOTDOWN_VECTOR        0xF2
+#define SPURIOUS_VECTOR             0xFF
+
+/* PIT ticks the timer calibration is measured over */
+#define LAPIC_CALIBRATE_TICKS       2
+
+/* local APIC counts in one PIT tick at divide by 16, 0 until calibrated */
+uint32_t lapic_ticks_per_pit_tick;
+
+/* 1 once the boot processor's local APIC is enabled */
+uint32_t lapic_enabled;
+
+/* enable the calling processor's local APIC and accept every priority */
+void lapic_init();
+
+/* stop taking 8259 interrupts through LINT0 once the I/O APIC has the ISA lines */
+void lapic_mask_extint();
+
+/* APIC ID of the calling processor */
+uint32_t lapic_id();
+
+/* acknowledge the interrupt being handled */
+void lapic_eoi();
+
+/* send a fixed interrupt to one processor */
+void lapic_send_ipi(uint32_t apic_id, uint32_t vector);
+
+/* send a fixed interrupt to every processor except the caller */
+void lapic_send_ipi_others(uint32_t vector);
+
+/* send INIT, then the startup IPI for the page the processor should start at */
+void lapic_send_init(uint32_t apic_id);
+void lapic_send_startup(uint32_t apic_id, uint32_t page);
+
+/* count timer decrements over a few PIT ticks, needs interrupts enabled */
+void lapic_calibrate_timer();
+
+/* start the calling processor's periodic timer at the PIT rate */
+void lapic_timer_start();
+
+/* interrupt the calling processor once after counts timer decrements */
+void lapic_timer_oneshot(uint32_t counts);
+
+/* decrements left before the timer interrupts */
+uint32_t lapic_timer_remaining();
+
+/* handler for the local APIC timer, the system tick on the boot processor */
+void lapic_timer_handler();
+
+#endif /* _LAPIC_H */
@@ -3,6 +3,7 @@
 
 #include "lib.h"
 #include "scheduler.h"
+#include "devices/terminal.h"
 
 #define VIDEO       0xB8000
 #define NUM_COLS    80
@@ -16,10 +17,11 @@
 #define LOW_BYTE_MASK       0x00FF
 #define HIGH_BYTE_MASK      0xFF00
 #define BYTE_SHIFT          8
-#define SPACE_ASCII         ' '
 
-static int screen_x;
-static int screen_y;
+/* each processor prints at the cursor of the terminal it is running, kept with the terminal
+   under the kernel lock so it moves with the terminal's processes from processor to processor */
+#define screen_x    (terminals[scheduled_terminal].terminal_screen_x)
+#define screen_y    (terminals[scheduled_terminal].terminal_screen_y)
 static char* video_mem = (char *)VIDEO;
 
 /* void clear(void);
@@ -456,6 +458,50 @@ int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n) {
     return 0;
 }
 
+/* const int8_t* cmdline_option(const int8_t* cmdline, const int8_t* name)
+ * Inputs:      cmdline -- space separated boot options, NULL if the bootloader gave none
+ *              name -- start of the option, including the '=' of one that takes a value
+ * Return Value: the text right after name in the last option starting with it, NULL if none does
+ * Function: finds a boot option, later options override earlier ones */
+const int8_t* cmdline_option(const int8_t* cmdline, const int8_t* name) {
+    const int8_t* found = NULL;
+    uint32_t len = strlen(name);
+
+    while (cmdline != NULL && *cmdline != '\0') {
+        if (strncmp(cmdline, name, len) == 0) {
+            found = cmdline + len;
+        }
+
+        // skip to the next option
+        while (*cmdline != '\0' && *cmdline != ' ') {
+            cmdline++;
+        }
+        while (*cmdline == ' ') {
+            cmdline++;
+        }
+    }
+    return found;
+}
+
+/* int32_t cmdline_number(const int8_t* cmdline, const int8_t* name, uint32_t* value)
+ * Inputs:      cmdline -- space separated boot options, NULL if the bootloader gave none
+ *              name -- option name up to and including its '='
+ *              value -- set to the decimal number after name, 0 if no digits follow it
+ * Return Value: 0 if the option was given, -1 otherwise
+ * Function: reads a numeric boot option such as pit_hz=100 */
+int32_t cmdline_number(const int8_t* cmdline, const int8_t* name, uint32_t* value) {
+    const int8_t* digits = cmdline_option(cmdline, name);
+
+    if (digits == NULL) {
+        return -1;
+    }
+    *value = 0;
+    for (; *digits >= '0' && *digits <= '9'; digits++) {
+        *value = *value * 10 + (*digits - '0');
+    }
+    return 0;
+}
+
 /* int8_t* strcpy(int8_t* dest, const int8_t* src)
  * Inputs:      int8_t* dest = destination string of copy
  *         const int8_t* src = source string of copy
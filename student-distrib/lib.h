@@ -32,6 +32,10 @@ int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n);
 int8_t* strcpy(int8_t* dest, const int8_t*src);
 int8_t* strncpy(int8_t* dest, const int8_t*src, uint32_t n);
 
+/* Boot command line options */
+const int8_t* cmdline_option(const int8_t* cmdline, const int8_t* name);
+int32_t cmdline_number(const int8_t* cmdline, const int8_t* name, uint32_t* value);
+
 /* Userspace address-check functions */
 int32_t bad_userspace_addr(const void* addr, int32_t len);
 int32_t safe_strncpy(int8_t* dest, const int8_t* src, int32_t n);
@@ -80,6 +84,18 @@ static inline uint32_t inl(port) {
     return val;
 }
 
+/* Reads the low 32 bits of the time stamp counter.  The difference
+ * between two reads is valid for intervals shorter than 2^32 cycles */
+static inline uint32_t rdtsc_low(void) {
+    uint32_t low;
+    asm volatile ("rdtsc"
+            : "=a"(low)
+            :
+            : "edx"
+    );
+    return low;
+}
+
 /* Writes a byte to a port */
 #define outb(data, port)                \
 do {                                    \
@@ -0,0 +1,396 @@
+#include "loader.h"
+#include "lib.h"
+#include "paging.h"
+#include "frame_alloc.h"
+#include "devices/filesystem.h"
+
+loader_stats_t loader_stats[LOADER_STATS_SIZE];
+image_cache_stats_t image_cache_stats;
+
+/* executables whose file pages are shared between processes */
+static image_cache_entry_t image_cache[IMAGE_CACHE_SLOTS];
+
+/* stack of unused frame indices in the cache pool */
+static uint16_t free_cache_frames[IMAGE_CACHE_FRAMES];
+static uint32_t num_free_cache_frames;
+/* physical (and kernel virtual) address of the 4MB pool */
+static uint32_t image_cache_base;
+
+/* void init_image_cache()
+ * Inputs:      None
+ * Return Value: void
+ * Function: empties every cache slot and takes a 4MB pool from the frame allocator,
+ *           without a pool every image page is loaded privately */
+void
+init_image_cache() {
+    int i;
+
+    for (i = 0; i < IMAGE_CACHE_SLOTS; i++) {
+        image_cache[i].valid = 0;
+        image_cache[i].refcount = 0;
+    }
+
+    num_free_cache_frames = 0;
+    image_cache_base = alloc_frames(FRAMES_PER_4MB);
+    if (image_cache_base == 0) {
+        return;
+    }
+    for (i = IMAGE_CACHE_FRAMES - 1; i >= 0; i--) {
+        free_cache_frames[num_free_cache_frames++] = i;
+    }
+}
+
+/* void evict_image(image_cache_entry_t* entry)
+ * Inputs:      entry -- unreferenced cache entry
+ * Return Value: void
+ * Function: returns an image's frames to the pool and frees its slot */
+static void
+evict_image(image_cache_entry_t* entry) {
+    int i;
+
+    for (i = 0; i < MAX_IMAGE_PAGES; i++) {
+        if (entry->frames[i] != NO_FRAME) {
+            free_cache_frames[num_free_cache_frames++] = entry->frames[i];
+        }
+    }
+    entry->valid = 0;
+    image_cache_stats.evictions++;
+}
+
+/* int32_t alloc_cache_frame()
+ * Inputs:      None
+ * Return Value: index of a free cache frame, or -1 if the pool is exhausted
+ * Function: takes a frame off the free list, evicting unreferenced images when the list is empty */
+static int32_t
+alloc_cache_frame() {
+    int i;
+
+    for (i = 0; i < IMAGE_CACHE_SLOTS && num_free_cache_frames == 0; i++) {
+        if (image_cache[i].valid && image_cache[i].refcount == 0) {
+            evict_image(&image_cache[i]);
+        }
+    }
+    if (num_free_cache_frames == 0) {
+        return -1;
+    }
+    return free_cache_frames[--num_free_cache_frames];
+}
+
+/* int32_t get_image_slot(uint32_t inode)
+ * Inputs:      inode -- inode of the executable
+ * Return Value: cache slot holding the image, or NO_IMAGE_SLOT if every slot is in use
+ * Function: finds the image's cache entry, creating one in a free or unreferenced slot if needed */
+static int32_t
+get_image_slot(uint32_t inode) {
+    int i, j;
+    int32_t free_slot = NO_IMAGE_SLOT;
+
+    for (i = 0; i < IMAGE_CACHE_SLOTS; i++) {
+        if (image_cache[i].valid && image_cache[i].inode == inode) {
+            return i;
+        }
+        if (!image_cache[i].valid && free_slot == NO_IMAGE_SLOT) {
+            free_slot = i;
+        }
+    }
+
+    // reuse a slot whose image nobody is running
+    for (i = 0; i < IMAGE_CACHE_SLOTS && free_slot == NO_IMAGE_SLOT; i++) {
+        if (image_cache[i].refcount == 0) {
+            evict_image(&image_cache[i]);
+            free_slot = i;
+        }
+    }
+    if (free_slot == NO_IMAGE_SLOT) {
+        return NO_IMAGE_SLOT;
+    }
+
+    image_cache[free_slot].inode = inode;
+    image_cache[free_slot].refcount = 0;
+    image_cache[free_slot].valid = 1;
+    for (j = 0; j < MAX_IMAGE_PAGES; j++) {
+        image_cache[free_slot].frames[j] = NO_FRAME;
+    }
+    return free_slot;
+}
+
+/* int32_t load_user_image(pcb_t* pcb, uint32_t inode)
+ * Inputs:      pcb -- process that is about to run the image
+ *              inode -- inode of the executable
+ * Return Value: 0 on success, -1 if no frame is free for the page table
+ * Function: marks every page of the program region not present so the first touch of each
+ *           page faults it in, and takes a reference on the shared cache entry for the file.
+ *           The page table frame stays with the pid and is reused by its next process */
+int32_t
+load_user_image(pcb_t* pcb, uint32_t inode) {
+    int i;
+    ptble_entry_t* table;
+
+    if (pcb->user_page_table == 0 && (pcb->user_page_table = alloc_frames(1)) == 0) {
+        return -1;
+    }
+    table = (ptble_entry_t*)pcb->user_page_table;
+
+    for (i = 0; i < PAGE_VEC; i++) {
+        table[i].val = 0;
+    }
+
+    pcb->image_inode = inode;
+    pcb->image_size = inode_start[inode].numBytes;
+    pcb->pages_touched = 0;
+    pcb->private_pages = 0;
+
+    // images too big for the program region are never shared
+    if (pcb->image_size <= MAX_IMAGE_PAGES * USER_PAGE_SIZE) {
+        pcb->image_cache_slot = get_image_slot(inode);
+    }
+    if (pcb->image_cache_slot != NO_IMAGE_SLOT) {
+        image_cache[pcb->image_cache_slot].refcount++;
+    }
+    return 0;
+}
+
+/* void release_user_image(pcb_t* pcb)
+ * Inputs:      pcb -- process that is halting
+ * Return Value: void
+ * Function: frees the process's private frames and drops its reference on the cached
+ *           image, which stays loaded for the next execute */
+void
+release_user_image(pcb_t* pcb) {
+    int i;
+    ptble_entry_t* table = (ptble_entry_t*)pcb->user_page_table;
+
+    // execute may fail before the page table exists, forked frames are freed by their last owner
+    for (i = 0; table != NULL && i < PAGE_VEC; i++) {
+        if (table[i].present && table[i].available != PTE_AVAIL_COW) {
+            put_frame(table[i].offset_31_12 << PAGING_OFFSET);
+        }
+        table[i].val = 0;
+    }
+    flush_tlb();
+
+    if (pcb->image_cache_slot != NO_IMAGE_SLOT) {
+        image_cache[pcb->image_cache_slot].refcount--;
+        pcb->image_cache_slot = NO_IMAGE_SLOT;
+    }
+}
+
+/* int32_t fork_user_image(pcb_t* parent, pcb_t* child)
+ * Inputs:      parent -- process calling fork, the current process
+ *              child -- new process, its page table frame is reused if it has one
+ * Return Value: 0 on success, -1 if no frame is free for the child's page table
+ * Function: copies the parent's page table into the child's. Shared image cache pages are
+ *           mapped as they are, private pages are write protected in both and given another
+ *           owner so the first write by either copies them. Unmapped pages fault in later */
+int32_t
+fork_user_image(pcb_t* parent, pcb_t* child) {
+    int i;
+    ptble_entry_t* from = (ptble_entry_t*)parent->user_page_table;
+    ptble_entry_t* to;
+
+    if (child->user_page_table == 0 && (child->user_page_table = alloc_frames(1)) == 0) {
+        return -1;
+    }
+    to = (ptble_entry_t*)child->user_page_table;
+
+    for (i = 0; i < PAGE_VEC; i++) {
+        if (from[i].present && from[i].available != PTE_AVAIL_COW) {
+            from[i].readWrite = 0;
+            from[i].available = PTE_AVAIL_FORKED;
+            share_frame(from[i].offset_31_12 << PAGING_OFFSET);
+            image_cache_stats.forked_pages++;
+        }
+        to[i].val = from[i].val;
+    }
+    // the parent's writable entries just became read-only
+    flush_tlb();
+
+    child->image_inode = parent->image_inode;
+    child->image_size = parent->image_size;
+    child->pages_touched = 0;
+    child->private_pages = 0;
+    child->image_cache_slot = parent->image_cache_slot;
+    if (child->image_cache_slot != NO_IMAGE_SLOT) {
+        image_cache[child->image_cache_slot].refcount++;
+    }
+    return 0;
+}
+
+/* void set_user_pte(uint32_t page_index, uint32_t frame_addr, uint32_t writable)
+ * Inputs:      page_index -- page number within the program region
+ *              frame_addr -- physical address of the backing frame
+ *              writable -- 1 for a private page, 0 for a shared copy-on-write page
+ * Return Value: void
+ * Function: maps one page of the current process's program region */
+static void
+set_user_pte(uint32_t page_index, uint32_t frame_addr, uint32_t writable) {
+    ptble_entry_t* pte = (ptble_entry_t*)current_pcb->user_page_table + page_index;
+
+    pte->val = 0;
+    pte->present = 0x1;
+    pte->readWrite = writable;
+    pte->userSupervisor = 0x1;
+    pte->available = writable ? 0x0 : PTE_AVAIL_COW;
+    pte->offset_31_12 = frame_addr >> PAGING_OFFSET;
+    flush_tlb_page(USER_IMAGE_BASE + page_index * USER_PAGE_SIZE);
+}
+
+/* int32_t map_private_page(uint32_t page_index)
+ * Inputs:      page_index -- page number within the program region
+ * Return Value: 0 on success, -1 if physical memory is exhausted
+ * Function: backs the page with a fresh frame owned by the current process */
+static int32_t
+map_private_page(uint32_t page_index) {
+    uint32_t frame_addr = alloc_frames(1);
+
+    if (frame_addr == 0) {
+        return -1;
+    }
+    set_user_pte(page_index, frame_addr, 1);
+    current_pcb->private_pages++;
+    return 0;
+}
+
+/* uint32_t shared_frame_addr(uint32_t file_page)
+ * Inputs:      file_page -- page number within the executable
+ * Return Value: physical address of the cached copy of that page, or 0 if it cannot be cached
+ * Function: looks the page up in the current process's image cache entry, reading it from
+ *           the file into a fresh cache frame the first time any process touches it */
+static uint32_t
+shared_frame_addr(uint32_t file_page) {
+    image_cache_entry_t* entry;
+    int32_t frame, copied;
+    uint8_t* frame_ptr;
+
+    if (current_pcb->image_cache_slot == NO_IMAGE_SLOT) {
+        return 0;
+    }
+    entry = &image_cache[current_pcb->image_cache_slot];
+
+    if (entry->frames[file_page] != NO_FRAME) {
+        image_cache_stats.page_hits++;
+        return image_cache_base + entry->frames[file_page] * USER_PAGE_SIZE;
+    }
+
+    if ((frame = alloc_cache_frame()) == -1) {
+        return 0;
+    }
+
+    // the pool is in the kernel's direct map, so the frame can be filled through its physical address
+    frame_ptr = (uint8_t*)(image_cache_base + frame * USER_PAGE_SIZE);
+    copied = read_data(entry->inode, file_page * USER_PAGE_SIZE, frame_ptr, USER_PAGE_SIZE);
+    if (copied < 0) {
+        copied = 0;
+    }
+    memset(frame_ptr + copied, 0, USER_PAGE_SIZE - copied);
+
+    entry->frames[file_page] = frame;
+    image_cache_stats.page_loads++;
+    return (uint32_t)frame_ptr;
+}
+
+/* int32_t handle_user_page_fault(uint32_t fault_addr, uint32_t error_code)
+ * Inputs:      fault_addr -- faulting linear address from CR2
+ *              error_code -- error code pushed by the processor
+ * Return Value: 0 if the page was mapped and the access can be retried, -1 otherwise
+ * Function: file-backed pages of the program region are mapped read-only from the shared image
+ *           cache and copied into the process's own frame on the first write; pages past the
+ *           file, such as the stack, get a zero-filled private frame */
+int32_t
+handle_user_page_fault(uint32_t fault_addr, uint32_t error_code) {
+    uint32_t page_addr, page_index, file_offset, shared_addr;
+    int32_t copied = 0;
+    uint32_t forked;
+    ptble_entry_t* pte;
+
+    if (current_pcb == NULL || fault_addr < USER_IMAGE_BASE || fault_addr >= USER_IMAGE_END) {
+        return -1;
+    }
+
+    page_addr = fault_addr & USER_PAGE_MASK;
+    page_index = (page_addr - USER_IMAGE_BASE) >> PAGING_OFFSET;
+    pte = (ptble_entry_t*)current_pcb->user_page_table + page_index;
+
+    // write to a shared page: give the process its own copy
+    if (error_code & PF_ERR_PRESENT) {
+        if (!(error_code & PF_ERR_WRITE) || (pte->available != PTE_AVAIL_COW && pte->available != PTE_AVAIL_FORKED)) {
+            return -1;
+        }
+        shared_addr = pte->offset_31_12 << PAGING_OFFSET;
+        forked = (pte->available == PTE_AVAIL_FORKED);
+
+        // every other process that had the forked page has copied it or halted
+        if (forked && frame_share_count(shared_addr) == 0) {
+            set_user_pte(page_index, shared_addr, 1);
+            image_cache_stats.fork_reclaims++;
+            return 0;
+        }
+
+        if (map_private_page(page_index) != 0) {
+            return -1;
+        }
+        memcpy((uint8_t*)page_addr, (uint8_t*)shared_addr, USER_PAGE_SIZE);
+        if (forked) {
+            put_frame(shared_addr);
+            image_cache_stats.fork_copies++;
+        } else {
+            image_cache_stats.cow_copies++;
+        }
+        return 0;
+    }
+
+    current_pcb->pages_touched++;
+
+    // the program starts on a page boundary, so a page either overlaps the file from its start or not at all
+    if (page_addr >= USER_IMAGE_BASE + USER_PROG_OFFSET) {
+        file_offset = page_addr - (USER_IMAGE_BASE + USER_PROG_OFFSET);
+        if (file_offset < current_pcb->image_size) {
+            // a read maps the shared page, a write copies it right away
+            shared_addr = shared_frame_addr(file_offset / USER_PAGE_SIZE);
+            if (shared_addr != 0) {
+                if (error_code & PF_ERR_WRITE) {
+                    if (map_private_page(page_index) != 0) {
+                        return -1;
+                    }
+                    memcpy((uint8_t*)page_addr, (uint8_t*)shared_addr, USER_PAGE_SIZE);
+                    image_cache_stats.cow_copies++;
+                } else {
+                    set_user_pte(page_index, shared_addr, 0);
+                }
+                return 0;
+            }
+
+            // cache is full, load a private copy straight from the file
+            if (map_private_page(page_index) != 0) {
+                return -1;
+            }
+            copied = read_data(current_pcb->image_inode, file_offset, (uint8_t*)page_addr, USER_PAGE_SIZE);
+            if (copied < 0) {
+                copied = 0;
+            }
+            memset((uint8_t*)page_addr + copied, 0, USER_PAGE_SIZE - copied);
+            return 0;
+        }
+    }
+
+    if (map_private_page(page_index) != 0) {
+        return -1;
+    }
+    memset((uint8_t*)page_addr, 0, USER_PAGE_SIZE);
+    return 0;
+}
+
+/* void record_user_image_stats(pcb_t* pcb)
+ * Inputs:      pcb -- process that is halting
+ * Return Value: void
+ * Function: stores the process's pages touched, private pages and startup time under its program's inode */
+void
+record_user_image_stats(pcb_t* pcb) {
+    if (pcb->image_inode >= LOADER_STATS_SIZE) {
+        return;
+    }
+    loader_stats[pcb->image_inode].runs++;
+    loader_stats[pcb->image_inode].pages_touched = pcb->pages_touched;
+    loader_stats[pcb->image_inode].private_pages = pcb->private_pages;
+    loader_stats[pcb->image_inode].startup_cycles = pcb->startup_cycles;
+}
@@ -0,0 +1,85 @@
+#ifndef _LOADER_H
+#define _LOADER_H
+
+#include "types.h"
+#include "system_calls.h"
+
+/* user program image lives in the 4MB region starting at 128MB */
+#define USER_IMAGE_BASE         0x08000000
+#define USER_IMAGE_END          0x08400000
+/* programs are linked to start 0x48000 bytes into the user region */
+#define USER_PROG_OFFSET        0x00048000
+#define USER_PAGE_SIZE          0x1000
+#define USER_PAGE_MASK          0xFFFFF000
+
+/* shared image cache: one 4MB pool of frames taken from the frame allocator */
+#define IMAGE_CACHE_FRAMES      1024
+#define IMAGE_CACHE_SLOTS       8
+/* most file pages a program can have, the image must fit between 0x48000 and the end of the 4MB region */
+#define MAX_IMAGE_PAGES         ((USER_IMAGE_END - USER_IMAGE_BASE - USER_PROG_OFFSET) / USER_PAGE_SIZE)
+#define NO_FRAME                0xFFFF
+#define NO_IMAGE_SLOT           -1
+
+/* PTE available bit marking a read-only page that is copied on the first write */
+#define PTE_AVAIL_COW           0x1
+/* PTE available bits marking a private frame write protected by fork, the frame's share count
+   says how many other processes still map it */
+#define PTE_AVAIL_FORKED        0x2
+
+/* page fault error code bits pushed by the processor */
+#define PF_ERR_PRESENT          0x1
+#define PF_ERR_WRITE            0x2
+#define PF_ERR_USER             0x4
+
+/* per-program loader statistics are kept for inodes below this number */
+#define LOADER_STATS_SIZE       64
+
+/* startup cost of the last run of a program, indexed by inode */
+typedef struct loader_stats_t {
+    uint32_t runs;
+    uint32_t pages_touched;
+    uint32_t private_pages;
+    uint32_t startup_cycles;
+} loader_stats_t;
+
+/* loaded file pages of one executable, shared read-only by every process running it */
+typedef struct image_cache_entry_t {
+    uint32_t inode;
+    uint32_t refcount;          // processes currently mapping this image
+    uint32_t valid;             // slot holds an image, possibly with no users
+    uint16_t frames[MAX_IMAGE_PAGES];   // cache frame index per file page, NO_FRAME until loaded
+} image_cache_entry_t;
+
+/* image cache activity across all processes */
+typedef struct image_cache_stats_t {
+    uint32_t page_hits;         // faults satisfied by an already loaded cache page
+    uint32_t page_loads;        // file pages read into the cache
+    uint32_t cow_copies;        // shared pages copied on first write
+    uint32_t evictions;         // unused images dropped to free frames or slots
+    uint32_t forked_pages;      // private pages write protected and shared by fork
+    uint32_t fork_copies;       // forked pages copied on first write
+    uint32_t fork_reclaims;     // forked pages made writable again once no other process had them
+} image_cache_stats_t;
+
+extern loader_stats_t loader_stats[LOADER_STATS_SIZE];
+extern image_cache_stats_t image_cache_stats;
+
+/* set up the shared frame pool */
+void init_image_cache();
+
+/* unmap every page of a process's image and attach it to the shared cache entry for the file, -1 if out of memory */
+int32_t load_user_image(pcb_t* pcb, uint32_t inode);
+
+/* free a halting process's private pages and drop its reference on its cached image */
+void release_user_image(pcb_t* pcb);
+
+/* map the parent's image into the child, sharing private pages copy-on-write, -1 if out of memory */
+int32_t fork_user_image(pcb_t* parent, pcb_t* child);
+
+/* fault in a page of the current process's image, 0 if the fault was handled */
+int32_t handle_user_page_fault(uint32_t fault_addr, uint32_t error_code);
+
+/* fold a finished process's page and startup counts into loader_stats */
+void record_user_image_stats(pcb_t* pcb);
+
+#endif /* _LOADER_H */
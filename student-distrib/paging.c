@@ -1,9 +1,18 @@
 #include "paging.h"
 #include "scheduler.h"
 #include "system_calls.h"
+#include "loader.h"
+#include "frame_alloc.h"
+#include "lapic.h"
+#include "smp.h"
+#include "kdata.h"
 
 //align PDs and PTs, don't map anything after 8 MB
 
+/* copies of tableArray and vmemTableArray for each terminal, they differ only in where the video page points */
+static ptble_entry_t terminalTableArray[MAX_TERMINALS][PAGE_VEC] __attribute__((aligned (ALIGN_4KB)));
+static ptble_entry_t terminalVmemTableArray[MAX_TERMINALS][PAGE_VEC] __attribute__((aligned (ALIGN_4KB)));
+
 
 /* void init_paging(void)
  * Inputs:      void
@@ -95,7 +104,8 @@ init_paging() {
         tableArray[TERMINAL_VID_PAGE + i].accessed=0x0;
         tableArray[TERMINAL_VID_PAGE + i].dirty=0x0;
         tableArray[TERMINAL_VID_PAGE + i].pageAttributeTable=0x0;
-        tableArray[TERMINAL_VID_PAGE + i].global=0x0;
+        // backing pages never move, keep them in the TLB across CR3 loads
+        tableArray[TERMINAL_VID_PAGE + i].global=0x1;
         tableArray[TERMINAL_VID_PAGE + i].available=0x0;
         tableArray[TERMINAL_VID_PAGE + i].offset_31_12 = (TERMINAL_VIDEO + i * ALIGN_4KB) >> PAGING_OFFSET;
     }
@@ -115,21 +125,33 @@ init_paging() {
     //avail:3 bits
     directoryArray[1].avl=0x1;  //1  gets the dirty bit
     directoryArray[1].pageSize=0x1;  //1 get the page size bit
-    directoryArray[1].available=0x0;  //4 gets the global and avail bits
+    directoryArray[1].available=PDE_GLOBAL;  //4 gets the global and avail bits, the kernel page is global
     //points page number to the 1024th page, or start of 4MB
     directoryArray[1].offset_31_12=DIR1_PAGE;
 
-    // create the user program page
-    directoryArray[USER_SPACE_DIR_NUM].present = 0x1;
-    directoryArray[USER_SPACE_DIR_NUM].readWrite = 0x1;
-    directoryArray[USER_SPACE_DIR_NUM].userSupervisor = 0x1;
-    directoryArray[USER_SPACE_DIR_NUM].writeThrough = 0x0;
-    directoryArray[USER_SPACE_DIR_NUM].cacheDisable = 0x0;
-    directoryArray[USER_SPACE_DIR_NUM].accessed = 0x0;
-    directoryArray[USER_SPACE_DIR_NUM].avl = 0x0;
-    directoryArray[USER_SPACE_DIR_NUM].pageSize = 0x1;
-    directoryArray[USER_SPACE_DIR_NUM].available = 0x0;
-    directoryArray[USER_SPACE_DIR_NUM].offset_31_12 = get_phys_addr(0); // sets program image to PID 0 on initialization
+    // map physical memory above the kernel one to one for frames handed out by the frame allocator, kernel only
+    for (i = DIRECT_MAP_START_DIR; i < DIRECT_MAP_END_DIR; i++) {
+        directoryArray[i].present = 0x1;
+        directoryArray[i].readWrite = 0x1;
+        directoryArray[i].userSupervisor = 0x0;
+        directoryArray[i].pageSize = 0x1;
+        directoryArray[i].available = PDE_GLOBAL;
+        directoryArray[i].offset_31_12 = (i * FRAMES_PER_4MB);
+    }
+
+    // local APIC and IOAPIC registers, uncached and kernel only
+    directoryArray[APIC_MMIO_DIR].present = 0x1;
+    directoryArray[APIC_MMIO_DIR].readWrite = 0x1;
+    directoryArray[APIC_MMIO_DIR].userSupervisor = 0x0;
+    directoryArray[APIC_MMIO_DIR].writeThrough = 0x1;
+    directoryArray[APIC_MMIO_DIR].cacheDisable = 0x1;
+    directoryArray[APIC_MMIO_DIR].pageSize = 0x1;
+    directoryArray[APIC_MMIO_DIR].available = PDE_GLOBAL;
+    directoryArray[APIC_MMIO_DIR].offset_31_12 = APIC_MMIO_DIR * FRAMES_PER_4MB;
+
+    // user program page table is allocated per process and mapped by execute, see setup_page_directory
+    directoryArray[USER_SPACE_DIR_NUM].present = 0x0;
+    init_image_cache();
 
     // manually set the video memory page
     directoryArray[VIDMAP_VMEM_LOC].present = 0x1;
@@ -172,6 +194,15 @@ init_paging() {
     vmemTableArray[VIDMAP_VMEM_LOC_PAGE].available=0x0;
     vmemTableArray[VIDMAP_VMEM_LOC_PAGE].offset_31_12 = VIDEO >> PAGING_OFFSET;
 
+    // give every terminal its own low and vidmap tables, terminal 0 is displayed first
+    for (i = 0; i < MAX_TERMINALS; i++) {
+        memcpy(terminalTableArray[i], tableArray, sizeof(tableArray));
+        memcpy(terminalVmemTableArray[i], vmemTableArray, sizeof(vmemTableArray));
+        map_terminal_video(i);
+    }
+    directoryArray[0].offset_31_12 = (uint32_t)terminalTableArray[TERMINAL_1] >> PAGING_OFFSET;
+    directoryArray[VIDMAP_VMEM_LOC].offset_31_12 = (uint32_t)terminalVmemTableArray[TERMINAL_1] >> PAGING_OFFSET;
+
     //load directory to CR3 register to set up for paging
     loadPageDirectory((uint32_t *) directoryArray);
 
@@ -180,3 +211,144 @@ init_paging() {
 }
 
 
+
+/* void set_terminal_video_page(uint8_t terminal, uint32_t phys_addr)
+ * Inputs:      terminal -- terminal whose tables are updated
+ *              phys_addr -- physical page the video page should point to
+ * Return Value: void
+ * Function: remaps video memory for every process on the terminal */
+void
+set_terminal_video_page(uint8_t terminal, uint32_t phys_addr) {
+    terminalTableArray[terminal][VIDEO_MEMORY_PAGE].offset_31_12 = phys_addr >> PAGING_OFFSET;
+    terminalVmemTableArray[terminal][VIDMAP_VMEM_LOC_PAGE].offset_31_12 = phys_addr >> PAGING_OFFSET;
+    flush_tlb_page(VIDEO);
+    flush_tlb_page(VIDMAP_VMEM_LOC * FOUR_MB_PAGE + VIDMAP_VMEM_LOC_PAGE * ALIGN_4KB);
+    // processes of the terminal may be running on other processors
+    tlb_shootdown();
+}
+
+/* void map_terminal_video(uint8_t terminal)
+ * Inputs:      terminal -- terminal whose tables are updated
+ * Return Value: void
+ * Function: sends the terminal's output to the screen if it is the active terminal,
+ *           otherwise to its backing page */
+void
+map_terminal_video(uint8_t terminal) {
+    if (terminal == active_terminal) {
+        set_terminal_video_page(terminal, VIDEO);
+    } else {
+        set_terminal_video_page(terminal, TERMINAL_VIDEO + (ALIGN_4KB * terminal));
+    }
+}
+
+/* void map_low_identity(uint32_t start, uint32_t end, uint32_t present)
+ * Inputs:      start -- first physical address below 4MB
+ *              end -- address one past the range
+ *              present -- 1 to map the range one to one, 0 to unmap it
+ * Return Value: void
+ * Function: maps BIOS tables and the processor startup trampoline into the boot page
+ *           directory's low table for the kernel, never touching the video pages */
+void
+map_low_identity(uint32_t start, uint32_t end, uint32_t present) {
+    ptble_entry_t* table = (ptble_entry_t*)(directoryArray[0].offset_31_12 << PAGING_OFFSET);
+    uint32_t page;
+
+    for (page = start >> PAGING_OFFSET; page < PAGE_VEC && (page << PAGING_OFFSET) < end; page++) {
+        if (page >= VIDEO_MEMORY_PAGE && page < TERMINAL_VID_PAGE + MAX_TERMINALS) {
+            continue;
+        }
+        table[page].val = 0;
+        table[page].present = present;
+        table[page].readWrite = 0x1;
+        table[page].offset_31_12 = page;
+        flush_tlb_page(page << PAGING_OFFSET);
+    }
+}
+
+/* void set_kdata_pte(ptble_entry_t* pte, uint32_t frame_addr)
+ * Inputs:      pte -- entry in a process's kernel data table
+ *              frame_addr -- page it maps
+ * Return Value: void
+ * Function: maps the page for user code to read and nobody to write through this mapping */
+static void
+set_kdata_pte(ptble_entry_t* pte, uint32_t frame_addr) {
+    pte->val = 0;
+    pte->present = 0x1;
+    pte->readWrite = 0x0;
+    pte->userSupervisor = 0x1;
+    pte->offset_31_12 = frame_addr >> PAGING_OFFSET;
+}
+
+/* int32_t setup_page_directory(pcb_t* pcb)
+ * Inputs:      pcb -- process whose directory is built, its pid, parent, terminal and image
+ *                     page table (0 for none) must be set
+ * Return Value: 0 on success, -1 if no frame is free for the directory
+ * Function: copies the kernel mappings into the process's own page directory, points the
+ *           video tables at its terminal's, maps its program image at 128MB and the kernel
+ *           data pages, shared and its own, read-only at KDATA_DIR. The frames stay with the
+ *           pid and are reused by its next process */
+int32_t
+setup_page_directory(pcb_t* pcb) {
+    pdir_entry_t* dir;
+    ptble_entry_t* kdata_table;
+
+    if (pcb->page_directory == 0 && (pcb->page_directory = alloc_frames(1)) == 0) {
+        return -1;
+    }
+    if (pcb->kdata_table == 0 && (pcb->kdata_table = alloc_frames(1)) == 0) {
+        return -1;
+    }
+    if (pcb->process_data == 0 && (pcb->process_data = alloc_frames(1)) == 0) {
+        return -1;
+    }
+    dir = (pdir_entry_t*)pcb->page_directory;
+
+    memcpy(dir, directoryArray, sizeof(directoryArray));
+    dir[0].offset_31_12 = (uint32_t)terminalTableArray[pcb->terminal] >> PAGING_OFFSET;
+    dir[VIDMAP_VMEM_LOC].offset_31_12 = (uint32_t)terminalVmemTableArray[pcb->terminal] >> PAGING_OFFSET;
+
+    // kernel threads have no program region
+    dir[USER_SPACE_DIR_NUM].present = (pcb->user_page_table != 0);
+    dir[USER_SPACE_DIR_NUM].readWrite = 0x1;
+    dir[USER_SPACE_DIR_NUM].userSupervisor = 0x1;
+    dir[USER_SPACE_DIR_NUM].pageSize = 0x0;
+    dir[USER_SPACE_DIR_NUM].offset_31_12 = pcb->user_page_table >> PAGING_OFFSET;
+
+    kdata_table = (ptble_entry_t*)pcb->kdata_table;
+    memset(kdata_table, 0, ALIGN_4KB);
+    set_kdata_pte(&kdata_table[KDATA_SHARED_PAGE], kernel_data_frame());
+    set_kdata_pte(&kdata_table[KDATA_PROCESS_PAGE], pcb->process_data);
+    set_process_data(pcb, pcb->process_data);
+
+    dir[KDATA_DIR].val = 0;
+    dir[KDATA_DIR].present = 0x1;
+    dir[KDATA_DIR].readWrite = 0x1;
+    dir[KDATA_DIR].userSupervisor = 0x1;
+    dir[KDATA_DIR].pageSize = 0x0;
+    dir[KDATA_DIR].offset_31_12 = pcb->kdata_table >> PAGING_OFFSET;
+    return 0;
+}
+
+/* void switch_page_directory(pcb_t* pcb)
+ * Inputs:      pcb -- process to switch to
+ * Return Value: void
+ * Function: loads the process's page directory into CR3 */
+void
+switch_page_directory(pcb_t* pcb) {
+    loadPageDirectory((uint32_t*)pcb->page_directory);
+    tlb_stats.full_flushes++;
+}
+
+/* void sample_tlb_flush_rate()
+ * Inputs:      None
+ * Return Value: void
+ * Function: called once a second, turns the flush counts since the last call into rates */
+void
+sample_tlb_flush_rate() {
+    static uint32_t last_full_flushes, last_page_flushes;
+
+    tlb_stats.full_flushes_per_sec = tlb_stats.full_flushes - last_full_flushes;
+    tlb_stats.page_flushes_per_sec = tlb_stats.page_flushes - last_page_flushes;
+    last_full_flushes = tlb_stats.full_flushes;
+    last_page_flushes = tlb_stats.page_flushes;
+}
@@ -8,6 +8,7 @@
 #include "lib.h"
 #include "x86_desc.h"
 #include "lib.h"
+#include "system_calls.h"
 
 /* Number of vectors in the page directory/table */
 #define PAGE_VEC     1024
@@ -30,6 +31,20 @@
 
 #define VIDMAP_VMEM_LOC         35
 #define VIDMAP_VMEM_LOC_PAGE    10
+/* bytes mapped by one directory entry */
+#define FOUR_MB_PAGE            0x400000
+/* global bit in the available field of a 4MB directory entry, needs CR4.PGE */
+#define PDE_GLOBAL              0x1
+
+/* TLB flush counts, full flushes are CR3 loads and page flushes are invlpg */
+typedef struct tlb_stats_t {
+    uint32_t full_flushes;
+    uint32_t page_flushes;
+    uint32_t full_flushes_per_sec;
+    uint32_t page_flushes_per_sec;
+} tlb_stats_t;
+
+tlb_stats_t tlb_stats;
 
 /* page directory entry struct, defined for 32 bits, set using variable.field= 0xHEX */
 typedef union pdir_entry {
@@ -119,6 +134,24 @@ ptble_entry_t vmemTableArray[PAGE_VEC] __attribute__((aligned (ALIGN_4KB)));
 /* initializes paging by translating video memory to directory 0, page 184 and keeping kernel data in 4MB-8MB.  Also loads page directory address and enables paging. */
 void init_paging();
 
+/* points a terminal's video page, both the kernel's and the vidmap one, at a physical page */
+void set_terminal_video_page(uint8_t terminal, uint32_t phys_addr);
+
+/* points a terminal's video page at the screen if it is displayed, otherwise at its backing page */
+void map_terminal_video(uint8_t terminal);
+
+/* maps or unmaps low physical memory one to one for the kernel, used while starting processors */
+void map_low_identity(uint32_t start, uint32_t end, uint32_t present);
+
+/* builds a process's page directory from the kernel mappings, its terminal and its image, -1 if out of memory */
+int32_t setup_page_directory(pcb_t* pcb);
+
+/* makes a process's page directory the active one */
+void switch_page_directory(pcb_t* pcb);
+
+/* turns flush counts into per-second rates, called once a second by the PIT */
+void sample_tlb_flush_rate();
+
 #endif /* ASM */
 #endif /* _PAGING_H */
 
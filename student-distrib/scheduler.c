@@ -5,8 +5,296 @@
 #include "i8259.h"
 #include "devices/keyboard.h"
 #include "devices/terminal.h"
+#include "wait_queue.h"
+#include "devices/pit.h"
+#include "fpu.h"
+#include "smp.h"
+#include "lapic.h"
 
-uint8_t first_swap = 1;
+// stacks the idle contexts restart on each time nothing is runnable, one per processor
+static uint8_t idle_stack[MAX_CPUS][IDLE_STACK_SIZE] __attribute__((aligned (ALIGN_4KB)));
+
+// set once the idle context has run, from then on a NULL current_pcb means idle
+static uint8_t idle_started = 0;
+
+// where each processor's idle context starts, rebuilt before each switch to it
+static switch_context_t idle_context[MAX_CPUS];
+
+// when the last switch between two processes on each processor started
+static uint32_t switch_start_tsc[MAX_CPUS];
+
+// one run queue per processor, processes stay on the processor they were queued on
+static run_queue_t run_queues[MAX_CPUS];
+
+// bumped at every priority reset, processes catch up the next time they are queued or run
+static uint32_t priority_epoch = 0;
+static uint32_t ticks_since_reset = 0;
+
+/* void refresh_priority(pcb_t* pcb)
+ * Inputs:      pcb -- process about to be queued or charged a tick
+ * Return Value: None
+ * Function: moves the process back to its base level if a priority reset happened since it
+ *           was last looked at, so blocked processes do not have to be found at reset time */
+static void
+refresh_priority(pcb_t* pcb) {
+    if (pcb->priority_epoch != priority_epoch) {
+        pcb->priority_epoch = priority_epoch;
+        pcb->priority = pcb->base_priority;
+        pcb->ticks_used = 0;
+    }
+}
+
+/* void enqueue(run_queue_t* queue, pcb_t* pcb)
+ * Inputs:      queue -- run queue whose lock the caller holds
+ *              pcb -- ready process
+ * Return Value: None
+ * Function: appends the process to the FIFO of its level */
+static void
+enqueue(run_queue_t* queue, pcb_t* pcb) {
+    pcb->run_next = NULL;
+    if (queue->tail[pcb->priority] == NULL) {
+        queue->head[pcb->priority] = pcb;
+    } else {
+        queue->tail[pcb->priority]->run_next = pcb;
+    }
+    queue->tail[pcb->priority] = pcb;
+    queue->length++;
+}
+
+/* void make_ready(pcb_t* pcb)
+ * Inputs:      pcb -- process that can run again
+ * Return Value: None
+ * Function: marks the process ready and appends it to the run queue of its processor at its
+ *           level. Another processor is interrupted if it idles or runs something the process
+ *           outranks */
+void
+make_ready(pcb_t* pcb) {
+    run_queue_t* queue = &run_queues[pcb->cpu];
+    cpu_t* target = &cpus[pcb->cpu];
+    uint32_t flags;
+
+    cli_and_save(flags);
+    // the tick has to be periodic again once there is someone to preempt for
+    if (target->id == BOOT_CPU) {
+        pit_exit_tickless();
+    }
+    refresh_priority(pcb);
+    pcb->state = PROCESS_READY;
+
+    spin_lock(&queue->lock);
+    enqueue(queue, pcb);
+    spin_unlock(&queue->lock);
+
+    if (target != this_cpu() && (target->current == NULL || pcb->priority < target->current->priority)) {
+        smp_stats.reschedule_ipis++;
+        lapic_send_ipi(target->apic_id, RESCHEDULE_VECTOR);
+    }
+    restore_flags(flags);
+}
+
+/* uint32_t least_loaded_cpu()
+ * Inputs:      None
+ * Return Value: online processor with the fewest ready and running processes
+ * Function: picks where a new process is queued first, ties go to the lower number */
+uint32_t
+least_loaded_cpu() {
+    uint32_t i, load;
+    uint32_t best = BOOT_CPU;
+    uint32_t best_load = (uint32_t)-1;
+
+    for (i = 0; i < num_cpus; i++) {
+        if (!cpus[i].online) {
+            continue;
+        }
+        load = run_queues[i].length + (cpus[i].current != NULL);
+        if (load < best_load) {
+            best = i;
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+/* void boost_priority(pcb_t* pcb)
+ * Inputs:      pcb -- blocked process woken by keyboard or RTC input
+ * Return Value: None
+ * Function: moves the process to the top level with a fresh quantum before it is queued */
+void
+boost_priority(pcb_t* pcb) {
+    refresh_priority(pcb);
+    pcb->priority = TOP_PRIORITY;
+    pcb->ticks_used = 0;
+}
+
+/* pcb_t* take_ready(run_queue_t* queue, cpu_t* cpu)
+ * Inputs:      queue -- run queue to take from
+ *              cpu -- processor that will run the process
+ * Return Value: process removed from the queue, NULL if none can run on cpu
+ * Function: removes the longest waiting process of the highest ready level. A process whose
+ *           FPU registers are still live on another processor has to stay there */
+static pcb_t*
+take_ready(run_queue_t* queue, cpu_t* cpu) {
+    uint32_t level;
+    pcb_t* prev;
+    pcb_t* pcb;
+
+    spin_lock(&queue->lock);
+    for (level = 0; level < NUM_PRIORITY_LEVELS; level++) {
+        prev = NULL;
+        for (pcb = queue->head[level]; pcb != NULL; prev = pcb, pcb = pcb->run_next) {
+            if (pcb->cpu != cpu->id && cpus[pcb->cpu].fpu_owner == pcb) {
+                continue;
+            }
+            if (prev == NULL) {
+                queue->head[level] = pcb->run_next;
+            } else {
+                prev->run_next = pcb->run_next;
+            }
+            if (queue->tail[level] == pcb) {
+                queue->tail[level] = prev;
+            }
+            queue->length--;
+            spin_unlock(&queue->lock);
+            pcb->run_next = NULL;
+            return pcb;
+        }
+    }
+    spin_unlock(&queue->lock);
+    return NULL;
+}
+
+/* pcb_t* dequeue_ready(cpu_t* cpu)
+ * Inputs:      cpu -- processor looking for work
+ * Return Value: next process to run there, NULL if nothing is ready anywhere
+ * Function: takes from the processor's own queue first, otherwise steals from the processor
+ *           with the longest queue */
+static pcb_t*
+dequeue_ready(cpu_t* cpu) {
+    pcb_t* pcb = take_ready(&run_queues[cpu->id], cpu);
+    uint32_t i, busiest, longest;
+
+    if (pcb != NULL) {
+        return pcb;
+    }
+
+    busiest = cpu->id;
+    longest = 0;
+    for (i = 0; i < num_cpus; i++) {
+        if (i != cpu->id && cpus[i].online && run_queues[i].length > longest) {
+            busiest = i;
+            longest = run_queues[i].length;
+        }
+    }
+    if (busiest == cpu->id) {
+        return NULL;
+    }
+
+    pcb = take_ready(&run_queues[busiest], cpu);
+    if (pcb != NULL) {
+        pcb->cpu = cpu->id;
+        smp_stats.steals++;
+    }
+    return pcb;
+}
+
+/* uint32_t work_available(cpu_t* cpu)
+ * Inputs:      cpu -- idle processor
+ * Return Value: 1 if its queue or another one has a ready process, read without any lock */
+static uint32_t
+work_available(cpu_t* cpu) {
+    uint32_t i;
+
+    for (i = 0; i < num_cpus; i++) {
+        if (run_queues[i].length != 0 && (i == cpu->id || cpus[i].online)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* uint32_t ready_above(uint32_t level)
+ * Inputs:      level -- priority level to compare against
+ * Return Value: 1 if a process is ready at a higher level (smaller number) on the calling
+ *               processor, 0 otherwise */
+static uint32_t
+ready_above(uint32_t level) {
+    run_queue_t* queue = &run_queues[this_cpu()->id];
+    uint32_t i;
+
+    for (i = 0; i < level; i++) {
+        if (queue->head[i] != NULL) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* void reset_priorities()
+ * Inputs:      None
+ * Return Value: None
+ * Function: starts a new priority epoch and requeues every ready process at its base level,
+ *           keeping higher levels ahead so the reset does not reorder them */
+static void
+reset_priorities() {
+    pcb_t* lists[NUM_PRIORITY_LEVELS];
+    run_queue_t* queue;
+    pcb_t* pcb;
+    pcb_t* next;
+    uint32_t level, i;
+
+    priority_epoch++;
+    for (i = 0; i < num_cpus; i++) {
+        queue = &run_queues[i];
+        spin_lock(&queue->lock);
+        for (level = 0; level < NUM_PRIORITY_LEVELS; level++) {
+            lists[level] = queue->head[level];
+            queue->head[level] = NULL;
+            queue->tail[level] = NULL;
+        }
+        queue->length = 0;
+        for (level = 0; level < NUM_PRIORITY_LEVELS; level++) {
+            for (pcb = lists[level]; pcb != NULL; pcb = next) {
+                next = pcb->run_next;
+                refresh_priority(pcb);
+                enqueue(queue, pcb);
+            }
+        }
+        spin_unlock(&queue->lock);
+    }
+}
+
+/* void idle_loop()
+ * Inputs:      None
+ * Return Value: None, never returns
+ * Function: halts until an interrupt makes a process runnable, then schedules it. Runs on
+ *           the processor's idle stack with current_pcb NULL and without the big kernel lock,
+ *           so the timer handlers leave it alone and other processors can run the kernel */
+static void
+idle_loop() {
+    cpu_t* cpu = this_cpu();
+    uint32_t start_tsc;
+
+    // the scheduler switched here holding the lock
+    reap_orphans();
+    unlock_kernel();
+    while (1) {
+        if (cpu->id == BOOT_CPU) {
+            lock_kernel();
+            pit_enter_tickless();
+            unlock_kernel();
+        }
+        start_tsc = rdtsc_low();
+        asm volatile("sti; hlt; cli");
+        if (cpu->id == BOOT_CPU) {
+            idle_stats.idle_cycles += rdtsc_low() - start_tsc;
+        }
+
+        if (work_available(cpu)) {
+            lock_kernel();
+            scheduler();
+        }
+    }
+}
 
 /* void terminal_switch(uint8_t target_terminal)
  * 
@@ -18,6 +306,7 @@ uint8_t first_swap = 1;
  */
 void
 terminal_switch(uint8_t target_terminal) {
+    uint8_t old_terminal = active_terminal;
 
     if (active_terminal == target_terminal) {
         return;
@@ -25,9 +314,7 @@ terminal_switch(uint8_t target_terminal) {
 
     // update video paging to point to video if we're not pointing there
     if (active_terminal != scheduled_terminal) {
-        tableArray[VIDEO_MEMORY_PAGE].offset_31_12 = VIDEO >> PAGING_OFFSET;
-        vmemTableArray[VIDMAP_VMEM_LOC_PAGE].offset_31_12 = VIDEO >> PAGING_OFFSET;
-        flush_tlb();
+        set_terminal_video_page(scheduled_terminal, VIDEO);
     }
 
     // copy video mem into active terminal video mem
@@ -36,103 +323,235 @@ terminal_switch(uint8_t target_terminal) {
     // copy target page into video mem
     memcpy((void*)VIDEO, (void*)(TERMINAL_VIDEO + target_terminal*ALIGN_4KB), ALIGN_4KB);
 
-    // update paging to point to scheduled terminal after shifting video
-    if (target_terminal != scheduled_terminal) {
-        tableArray[VIDEO_MEMORY_PAGE].offset_31_12 = (TERMINAL_VIDEO + (ALIGN_4KB*scheduled_terminal)) >> PAGING_OFFSET;
-        vmemTableArray[VIDMAP_VMEM_LOC_PAGE].offset_31_12 = (TERMINAL_VIDEO + (ALIGN_4KB*scheduled_terminal)) >> PAGING_OFFSET;
-        flush_tlb();
-    }
-
     // update active terminal
     active_terminal = target_terminal;    
 
-    // execute shell on swap if first time
-    if (!initialized_terminals[active_terminal]){
-        send_eoi(KEYBOARD_IRQ);
-        sti();
-        execute((uint8_t*)"shell");
+    // readers recheck which terminal's keyboard buffer they follow
+    wake_up_interactive(&keyboard_wait_queue);
+
+    // the old terminal now writes to its backing page and the new one to the screen
+    map_terminal_video(old_terminal);
+    map_terminal_video(target_terminal);
+    if (scheduled_terminal != old_terminal && scheduled_terminal != target_terminal) {
+        map_terminal_video(scheduled_terminal);
+    }
+
+    // queue a shell on the terminal the first time it is shown, it runs once the scheduler reaches it
+    if (!initialized_terminals[active_terminal]) {
+        start_terminal_shell(active_terminal);
     }
 
 }
 
 /* void scheduler()
  * 
- * This function is used for switching between scheduled terminals
+ * This function is used for switching between processes on the run queue
  * 
  * Inputs: None
  * Return Value: None
- * Function: switches which program is running
+ * Function: puts the running process at the back of its level if it can still run and
+ *           switches to the first process of the highest ready level, call with interrupts disabled
  */
 
 void
 scheduler() {
     /*
-    1. save ebp, esp
-    2. setup iret context for terminal you're currently in
-    3. swap ebp, esp to new terminal (swap tss.esp0 as well)
-    4. switch program image
-    5. switch video memory
+    1. requeue the current process unless it blocked or exited
+    2. pick the next ready process, stealing one if this processor has none, or the idle context
+    3. switch program image and video memory with its page directory
+    4. switch_to saves our registers and resumes the next one (swaps this processor's esp0 as well)
     */
-    uint8_t next_scheduled_terminal;
-    uint32_t ebp_temp_val, esp_temp_val;
+    cpu_t* cpu = this_cpu();
+    pcb_t* prev = (pcb_t*)cpu->current;
+    pcb_t* next;
+    switch_context_t* prev_context = NULL;
+    switch_context_t* idle;
+    uint32_t cycles;
 
-    if (first_swap) { 
-        scheduled_terminal = 0;
-        first_swap = 0;
+    if (prev != NULL) {
+        if (prev->state == PROCESS_RUNNING) {
+            make_ready(prev);
+        }
+        prev_context = &prev->context;
+        prev_context->lock_depth = cpu->lock_depth;
     }
 
-    // save ebp, esp
-    register uint32_t stored_esp asm("esp");
-    register uint32_t stored_ebp asm("ebp");
+    // idle if every process is blocked, the idle context starts over on a fresh stack each time
+    next = dequeue_ready(cpu);
+    if (next == NULL) {
+        cpu->current = NULL;
+        idle_started = 1;
+        idle_stats.entries++;
+        idle = &idle_context[cpu->id];
+        idle->esp = (uint32_t)(idle_stack[cpu->id] + IDLE_STACK_SIZE);
+        idle->esp0 = idle->esp;
+        idle->ebp = 0;
+        idle->eip = (uint32_t)idle_loop;
+        idle->eflags = INITIAL_EFLAGS;
+        idle->lock_depth = 1;
+        cpu->lock_depth = idle->lock_depth;
+        fpu_switch(NULL);
+        switch_to(prev_context, idle, cpu->tss);
+        return;
+    }
 
-    current_pcb->scheduling_esp_val = stored_esp;
-    current_pcb->scheduling_ebp_val = stored_ebp;
+    next->state = PROCESS_RUNNING;
 
-    // update terminal positions
-    terminals[scheduled_terminal].terminal_screen_x = get_screen_x();
-    terminals[scheduled_terminal].terminal_screen_y = get_screen_y();
+    // nothing else was ready, keep running
+    if (next == prev) {
+        return;
+    }
 
-    // find next scheduled terminal/pcb to run
-    next_scheduled_terminal = (scheduled_terminal + 1) % MAX_TERMINALS;
+    switch_start_tsc[cpu->id] = rdtsc_low();
+    switch_stats.switches++;
+    cpu->terminal = next->terminal;
+    cpu->current = next;
+    next->cpu = cpu->id;
 
-    while (!initialized_terminals[next_scheduled_terminal]) {
-        next_scheduled_terminal++;
-        next_scheduled_terminal %= MAX_TERMINALS;
+    // the process's directory already maps its image and its terminal's video page
+    switch_page_directory(next);
+
+    // the cursor lives with the terminal, only the hardware cursor may need to follow it
+    set_cursor(terminals[scheduled_terminal].terminal_screen_x, terminals[scheduled_terminal].terminal_screen_y);
+
+    fpu_switch(next);
+    cpu->lock_depth = next->context.lock_depth;
+    switch_to(prev_context, &next->context, cpu->tss);
+
+    // running again, possibly on another processor, switched back to by whichever context
+    // stamped that processor's switch_start_tsc
+    cycles = rdtsc_low() - switch_start_tsc[this_cpu()->id];
+    switch_stats.timed_switches++;
+    switch_stats.total_cycles += cycles;
+    if (switch_stats.min_cycles == 0 || cycles < switch_stats.min_cycles) {
+        switch_stats.min_cycles = cycles;
+    }
+    if (cycles > switch_stats.max_cycles) {
+        switch_stats.max_cycles = cycles;
     }
 
-    scheduled_terminal = next_scheduled_terminal;
+    // whatever halted on the way here is off its stack now
+    reap_orphans();
+}
 
-    // context switch
-    current_pcb = get_pcb_ptr(terminals[scheduled_terminal].active_pid);
-    tss.esp0 = EIGHT_MB - (EIGHT_KB * current_pcb->process_id) - sizeof(int);
+/* void scheduler_tick(uint32_t ticks)
+ * 
+ * Charges timer ticks to the running process, called from the PIT handler on the boot
+ * processor and the local APIC timer handler on the others, with interrupts disabled
+ * 
+ * Inputs: ticks -- ticks since the last call, more than one after a one-shot
+ * Return Value: None
+ * Function: resets priorities periodically against starvation, demotes a process that used
+ *           its whole quantum and preempts it then or when a higher level has work. A process
+ *           on the boot processor with nothing else ready runs on without a periodic tick
+ */
+void
+scheduler_tick(uint32_t ticks) {
+    cpu_t* cpu = this_cpu();
+    pcb_t* pcb = (pcb_t*)cpu->current;
+    uint32_t exhausted;
 
-    // update program page
-    directoryArray[USER_SPACE_DIR_NUM].offset_31_12 = get_phys_addr(current_pcb->process_id);
-    flush_tlb();
+    if (cpu->id == BOOT_CPU) {
+        ticks_since_reset += ticks;
+        if (ticks_since_reset >= pit_ms_to_ticks(PRIORITY_RESET_MS)) {
+            ticks_since_reset = 0;
+            reset_priorities();
+        }
+    }
 
-    // remap video pages
-    if (scheduled_terminal == active_terminal) {
-        tableArray[VIDEO_MEMORY_PAGE].offset_31_12 = VIDEO >> PAGING_OFFSET;
-        vmemTableArray[VIDMAP_VMEM_LOC_PAGE].offset_31_12 = VIDEO >> PAGING_OFFSET;
-        flush_tlb();
-    } else {
-        tableArray[VIDEO_MEMORY_PAGE].offset_31_12 = (TERMINAL_VIDEO + (ALIGN_4KB*scheduled_terminal)) >> PAGING_OFFSET;
-        vmemTableArray[VIDMAP_VMEM_LOC_PAGE].offset_31_12 = (TERMINAL_VIDEO + (ALIGN_4KB*scheduled_terminal)) >> PAGING_OFFSET;
-        flush_tlb();
+    // the idle loop arms its own one-shot
+    if (pcb == NULL) {
+        return;
     }
+    refresh_priority(pcb);
 
-    // update the screen_x and screen_y when switching terminals
-    set_cursor(terminals[scheduled_terminal].terminal_screen_x, terminals[scheduled_terminal].terminal_screen_y);
+    pcb->ticks_used += ticks;
+    exhausted = (pcb->ticks_used >= pit_ms_to_ticks(BASE_QUANTUM_MS << pcb->priority));
+    if (exhausted) {
+        if (pcb->priority < LOWEST_PRIORITY) {
+            pcb->priority++;
+        }
+        pcb->ticks_used = 0;
+    }
+
+    if (ready_above(exhausted ? NUM_PRIORITY_LEVELS : pcb->priority)) {
+        // softirqs running on this stack switch on their way out instead
+        if (!cpu->in_softirq) {
+            scheduler();
+        }
+    } else if (cpu->id == BOOT_CPU && !ready_above(NUM_PRIORITY_LEVELS)) {
+        pit_enter_tickless();
+    }
+}
+
+/* void preempt_if_outranked()
+ * 
+ * Lets an interrupt handler hand the CPU straight to a process it just boosted
+ * 
+ * Inputs: None
+ * Return Value: None
+ * Function: switches away from the running process if a higher level has a ready process,
+ *           returns once the running process is scheduled again
+ */
+void
+preempt_if_outranked() {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (current_pcb != NULL && !this_cpu()->in_softirq && ready_above(current_pcb->priority)) {
+        scheduler();
+    }
+    restore_flags(flags);
+}
+
+/* void yield()
+ * 
+ * Gives the CPU to the next ready process, this one goes to the back of its level
+ * 
+ * Inputs: None
+ * Return Value: None
+ * Function: calls the scheduler with interrupts disabled, returns once this process runs again
+ */
+void
+yield() {
+    uint32_t flags;
+
+    if (current_pcb == NULL) {
+        return;
+    }
 
-    ebp_temp_val = current_pcb->scheduling_ebp_val;
-    esp_temp_val = current_pcb->scheduling_esp_val;
-
-    asm volatile(
-        "movl %0, %%ebp;"
-        "movl %1, %%esp;"
-        "leave;"
-        "ret;"
-        :
-        : "r"(ebp_temp_val), "r"(esp_temp_val)
-        : "%ebp", "%esp");
+    // kernel threads run without the big kernel lock
+    lock_kernel();
+    cli_and_save(flags);
+    scheduler();
+    restore_flags(flags);
+    unlock_kernel();
+}
+
+/* void account_ticks(uint32_t ticks, uint32_t ticks_per_sec)
+ * 
+ * Charges PIT ticks to the idle context or to processes, called from the PIT driver
+ * 
+ * Inputs: ticks -- ticks that passed
+ *         ticks_per_sec -- PIT ticks in one second
+ * Return Value: None
+ * Function: counts idle ticks and once a second turns them into an idle percentage
+ */
+void
+account_ticks(uint32_t ticks, uint32_t ticks_per_sec) {
+    static uint32_t ticks_since_sample, idle_ticks_at_sample;
+
+    idle_stats.total_ticks += ticks;
+    if (idle_started && current_pcb == NULL) {
+        idle_stats.idle_ticks += ticks;
+    }
+
+    ticks_since_sample += ticks;
+    if (ticks_since_sample >= ticks_per_sec) {
+        idle_stats.idle_percent = (idle_stats.idle_ticks - idle_ticks_at_sample) * PERCENT / ticks_since_sample;
+        idle_stats.idle_cycles_per_sec = idle_stats.idle_cycles;
+        idle_stats.idle_cycles = 0;
+        idle_ticks_at_sample = idle_stats.idle_ticks;
+        ticks_since_sample = 0;
+    }
 }
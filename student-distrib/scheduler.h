@@ -1,4 +1,9 @@
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
 #include "types.h"
+#include "system_calls.h"
+#include "smp.h"
 
 #define MAX_TERMINALS               3
 #define TERMINAL_1                  0
@@ -7,15 +12,67 @@
 #define EIGHT_MB                    0x800000
 #define EIGHT_KB                    0x2000
 #define USER_ESP                    0x8400000 - 4
+#define IDLE_STACK_SIZE             0x1000
+#define PERCENT                     100
+
+/* multi-level feedback queue: processes that use a whole quantum drop a level, each level
+   down runs twice as long, and every PRIORITY_RESET_MS everyone returns to their base */
+#define NUM_PRIORITY_LEVELS         3
+#define TOP_PRIORITY                0
+#define LOWEST_PRIORITY             (NUM_PRIORITY_LEVELS - 1)
+#define BASE_QUANTUM_MS             50
+#define PRIORITY_RESET_MS           1000
+
+/* time spent in the idle context, sampled once a second by the PIT */
+typedef struct idle_stats_t {
+    uint32_t entries;           // times the scheduler found nothing runnable
+    uint32_t total_ticks;       // PIT ticks since boot
+    uint32_t idle_ticks;        // PIT ticks that passed in the idle context
+    uint32_t idle_cycles;       // cycles halted since the last sample
+    uint32_t idle_cycles_per_sec;
+    uint32_t idle_percent;      // share of the last second spent idle
+} idle_stats_t;
+
+idle_stats_t idle_stats;
+
+/* cost of switching between processes, from the page directory load in the old context to
+   the return from switch_to in the new one, measured with rdtsc */
+typedef struct switch_stats_t {
+    uint32_t switches;          // switches between two processes since boot
+    uint32_t timed_switches;    // switches that returned into a saved context and were timed
+    uint32_t total_cycles;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+} switch_stats_t;
+
+switch_stats_t switch_stats;
+
+/* ready processes of one processor, one FIFO per priority level linked through run_next. The
+   lock covers the queue, the big kernel lock everything else the scheduler touches */
+typedef struct run_queue_t {
+    spinlock_t lock;
+    pcb_t* head[NUM_PRIORITY_LEVELS];
+    pcb_t* tail[NUM_PRIORITY_LEVELS];
+    volatile uint32_t length;
+} run_queue_t;
 
 // active terminal can either be 0, 1, or 2
 volatile uint8_t active_terminal;
 
-// sheduled terminal can either be 0, 1, or 2
-volatile uint8_t scheduled_terminal;
+// terminal of the process running on the calling processor, either 0, 1, or 2
+#define scheduled_terminal          (this_cpu()->terminal)
 
 // status of terminals
 uint8_t initialized_terminals[MAX_TERMINALS];
 
 void terminal_switch(uint8_t target_terminal);
 void scheduler();
+void yield();
+void make_ready(pcb_t* pcb);
+uint32_t least_loaded_cpu();
+void boost_priority(pcb_t* pcb);
+void scheduler_tick(uint32_t ticks);
+void preempt_if_outranked();
+void account_ticks(uint32_t ticks, uint32_t ticks_per_sec);
+
+#endif /* _SCHEDULER_H */
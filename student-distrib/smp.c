@@ -0,0 +1,410 @@
+#include "smp.h"
+#include "lapic.h"
+#include "lib.h"
+#include "paging.h"
+#include "scheduler.h"
+#include "system_calls.h"
+#include "frame_alloc.h"
+#include "fpu.h"
+#include "sysenter.h"
+#include "ioapic.h"
+#include "i8259.h"
+#include "devices/pit.h"
+
+/* trampoline code and the slots init_smp fills in, from ap_boot.S */
+extern uint8_t ap_trampoline_start[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_boot_gdt[];
+extern uint8_t ap_boot_cr3[];
+extern uint8_t ap_boot_stack[];
+
+/* a trampoline slot in the copy at TRAMPOLINE_ADDR */
+#define TRAMPOLINE_SLOT(type, label)    (*(type*)(TRAMPOLINE_ADDR + ((label) - ap_trampoline_start)))
+
+// the big kernel lock, its nesting is counted per processor in lock_depth
+static spinlock_t kernel_lock;
+
+// boot GDT followed by a TSS descriptor for each application processor
+static seg_desc_t smp_gdt[SMP_GDT_ENTRIES] __attribute__((aligned (16)));
+static x86_desc_t smp_gdt_desc;
+
+// processor the trampoline is starting, they come up one at a time
+static volatile uint32_t ap_starting;
+
+// 1 if the MP table says the 8259 reaches the processor through the IMCR
+static uint32_t imcr_present;
+
+/* void io_delay_us(uint32_t us)
+ * Inputs:      us -- microseconds to wait, roughly
+ * Return Value: void
+ * Function: each write to the POST port takes about a microsecond, usable before any timer
+ *           is calibrated and while interrupts are off */
+static void
+io_delay_us(uint32_t us) {
+    while (us-- > 0) {
+        outb(0, IO_DELAY_PORT);
+    }
+}
+
+/* uint8_t checksum(uint8_t* bytes, uint32_t length)
+ * Inputs:      bytes -- table to sum
+ *              length -- size of the table
+ * Return Value: sum of the bytes, 0 for a valid MP table */
+static uint8_t
+checksum(uint8_t* bytes, uint32_t length) {
+    uint8_t sum = 0;
+
+    while (length-- > 0) {
+        sum += *bytes++;
+    }
+    return sum;
+}
+
+/* mp_float_t* find_mp_float(uint32_t start, uint32_t length)
+ * Inputs:      start -- physical address to search from, mapped one to one
+ *              length -- bytes to search
+ * Return Value: the MP floating pointer, NULL if it is not in the range */
+static mp_float_t*
+find_mp_float(uint32_t start, uint32_t length) {
+    uint32_t addr;
+    mp_float_t* mp;
+
+    for (addr = start; addr + sizeof(mp_float_t) <= start + length; addr += MP_SEARCH_STEP) {
+        mp = (mp_float_t*)addr;
+        if (mp->signature == MP_FLOAT_SIGNATURE && checksum((uint8_t*)mp, sizeof(mp_float_t)) == 0) {
+            return mp;
+        }
+    }
+    return NULL;
+}
+
+/* void read_mp_tables()
+ * Inputs:      None
+ * Return Value: void
+ * Function: finds the MP configuration table where the MP specification says the BIOS leaves
+ *           it and adds an entry to cpus for every enabled processor besides this one. The
+ *           I/O APIC and where the ISA interrupts are wired to it go to ioapic.c. Leaves
+ *           num_cpus at 1 if there is no table */
+static void
+read_mp_tables() {
+    mp_float_t* mp;
+    mp_config_t* config;
+    mp_processor_t* processor;
+    mp_bus_t* bus;
+    mp_ioapic_t* ioapic;
+    mp_io_interrupt_t* io_interrupt;
+    uint8_t* entry;
+    uint32_t ebda, i;
+    uint32_t boot_apic_id = lapic_id();
+    int32_t isa_bus_id = -1;
+
+    ebda = *(uint16_t*)BDA_EBDA_SEGMENT << 4;
+    mp = NULL;
+    if (ebda != 0 && ebda < BASE_MEM_LAST_KB + ONE_KB) {
+        map_low_identity(ebda, ebda + ONE_KB, 1);
+        mp = find_mp_float(ebda, ONE_KB);
+    }
+    if (mp == NULL) {
+        mp = find_mp_float(BASE_MEM_LAST_KB, ONE_KB);
+    }
+    if (mp == NULL) {
+        mp = find_mp_float(BIOS_ROM_START, BIOS_ROM_END - BIOS_ROM_START);
+    }
+    if (mp == NULL || mp->config_addr == 0 || mp->config_addr >= BIOS_ROM_END) {
+        return;
+    }
+
+    imcr_present = (mp->features[1] & MP_FEATURE2_IMCR) != 0;
+    config = (mp_config_t*)mp->config_addr;
+    map_low_identity(mp->config_addr, mp->config_addr + sizeof(mp_config_t), 1);
+    map_low_identity(mp->config_addr, mp->config_addr + config->length, 1);
+    if (config->signature != MP_CONFIG_SIGNATURE || checksum((uint8_t*)config, config->length) != 0) {
+        return;
+    }
+
+    entry = (uint8_t*)(config + 1);
+    for (i = 0; i < config->entry_count; i++) {
+        // buses come before the I/O APICs and those before the interrupts wired to them
+        if (*entry == MP_ENTRY_BUS) {
+            bus = (mp_bus_t*)entry;
+            if (strncmp(bus->bus_type, (int8_t*)MP_BUS_ISA, MP_BUS_ISA_LEN) == 0) {
+                isa_bus_id = bus->bus_id;
+            }
+        } else if (*entry == MP_ENTRY_IOAPIC) {
+            ioapic = (mp_ioapic_t*)entry;
+            if (ioapic->flags & MP_IOAPIC_ENABLED) {
+                ioapic_found(ioapic->apic_id, ioapic->addr);
+            }
+        } else if (*entry == MP_ENTRY_IO_INTERRUPT) {
+            io_interrupt = (mp_io_interrupt_t*)entry;
+            if (io_interrupt->interrupt_type == MP_INT_VECTORED && io_interrupt->src_bus_id == isa_bus_id) {
+                ioapic_route_isa(io_interrupt->src_bus_irq, io_interrupt->dst_apic_id,
+                                 io_interrupt->dst_pin, io_interrupt->flags);
+            }
+        }
+        if (*entry != MP_ENTRY_PROCESSOR) {
+            entry += MP_OTHER_ENTRY_SIZE;
+            continue;
+        }
+        processor = (mp_processor_t*)entry;
+        entry += MP_PROCESSOR_ENTRY_SIZE;
+        if (!(processor->flags & MP_CPU_ENABLED) || processor->apic_id == boot_apic_id || num_cpus == MAX_CPUS) {
+            continue;
+        }
+        cpus[num_cpus].id = num_cpus;
+        cpus[num_cpus].apic_id = processor->apic_id;
+        num_cpus++;
+    }
+}
+
+/* void set_ap_tss(cpu_t* cpu, uint32_t stack_top)
+ * Inputs:      cpu -- application processor
+ *              stack_top -- kernel stack it starts on
+ * Return Value: void
+ * Function: fills in the processor's own TSS and its descriptor in smp_gdt, built the same
+ *           way entry builds the boot TSS */
+static void
+set_ap_tss(cpu_t* cpu, uint32_t stack_top) {
+    seg_desc_t the_tss_desc;
+
+    the_tss_desc.val[0] = 0;
+    the_tss_desc.val[1] = 0;
+    the_tss_desc.granularity   = 0x0;
+    the_tss_desc.opsize        = 0x0;
+    the_tss_desc.reserved      = 0x0;
+    the_tss_desc.avail         = 0x0;
+    the_tss_desc.present       = 0x1;
+    the_tss_desc.dpl           = 0x0;
+    the_tss_desc.sys           = 0x0;
+    the_tss_desc.type          = 0x9;
+    SET_TSS_PARAMS(the_tss_desc, &cpu->own_tss, tss_size);
+    smp_gdt[GDT_BOOT_ENTRIES + cpu->id] = the_tss_desc;
+
+    cpu->own_tss.ldt_segment_selector = KERNEL_LDT;
+    cpu->own_tss.ss0 = KERNEL_DS;
+    cpu->own_tss.esp0 = stack_top;
+    cpu->tss = &cpu->own_tss;
+}
+
+/* void start_ap(cpu_t* cpu)
+ * Inputs:      cpu -- application processor waiting for INIT
+ * Return Value: void
+ * Function: gives the processor a stack and sends INIT and two startup IPIs as the MP
+ *           specification describes, then waits a while for ap_main to mark it online */
+static void
+start_ap(cpu_t* cpu) {
+    uint32_t stack = alloc_frames(1);
+    uint32_t i;
+
+    if (stack == 0) {
+        return;
+    }
+    set_ap_tss(cpu, stack + FRAME_SIZE);
+    TRAMPOLINE_SLOT(uint32_t, ap_boot_stack) = stack + FRAME_SIZE;
+    ap_starting = cpu->id;
+
+    lapic_send_init(cpu->apic_id);
+    io_delay_us(INIT_DEASSERT_DELAY_US);
+    for (i = 0; i < STARTUP_IPI_COUNT; i++) {
+        lapic_send_startup(cpu->apic_id, TRAMPOLINE_PAGE);
+        io_delay_us(STARTUP_IPI_DELAY_US);
+    }
+    for (i = 0; i < AP_ONLINE_TIMEOUT_US && !cpu->online; i++) {
+        io_delay_us(1);
+    }
+}
+
+/* void init_boot_cpu()
+ * Inputs:      None
+ * Return Value: void
+ * Function: the boot processor is cpus[BOOT_CPU] and uses the boot TSS */
+void
+init_boot_cpu() {
+    cpus[BOOT_CPU].id = BOOT_CPU;
+    cpus[BOOT_CPU].tss = &tss;
+    cpus[BOOT_CPU].online = 1;
+    num_cpus = 1;
+}
+
+/* void init_apic()
+ * Inputs:      None
+ * Return Value: void
+ * Function: enables the boot processor's local APIC and reads the processors and the I/O
+ *           APIC from the MP tables, with low memory mapped only while it does. With an I/O
+ *           APIC the 8259 is masked and enable_irq, disable_irq and send_eoi drive the APICs,
+ *           without a local APIC, an MP table or an I/O APIC the 8259 keeps the interrupts.
+ *           Needs paging, and runs before devices enable their lines so no edge the 8259
+ *           latched is lost in the switch */
+void
+init_apic() {
+    uint32_t eax, ebx, ecx, edx;
+
+    asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(CPUID_FEATURES));
+    if (!(edx & CPUID_APIC)) {
+        return;
+    }
+    lapic_init();
+    cpus[BOOT_CPU].apic_id = lapic_id();
+
+    map_low_identity(0, ALIGN_4KB, 1);
+    map_low_identity(BASE_MEM_LAST_KB, BASE_MEM_LAST_KB + ONE_KB, 1);
+    map_low_identity(BIOS_ROM_START, BIOS_ROM_END, 1);
+    read_mp_tables();
+    map_low_identity(0, BIOS_ROM_END, 0);
+
+    if (ioapic_init(imcr_present) == 0) {
+        i8259_use_ioapic();
+    }
+}
+
+/* void init_smp()
+ * Inputs:      None
+ * Return Value: void
+ * Function: calibrates the local APIC timer against the PIT and makes it the boot
+ *           processor's tick, then starts every processor init_apic found with the trampoline
+ *           copied to TRAMPOLINE_ADDR. Without a local APIC the PIT stays the tick and the
+ *           kernel stays on the boot processor. Needs a ticking PIT */
+void
+init_smp() {
+    uint32_t i, online;
+
+    if (!lapic_enabled) {
+        return;
+    }
+    lapic_calibrate_timer();
+    pit_use_lapic();
+
+    if (num_cpus > 1) {
+        memcpy(smp_gdt, gdt, GDT_BOOT_ENTRIES * sizeof(seg_desc_t));
+        smp_gdt_desc.size = sizeof(smp_gdt) - 1;
+        smp_gdt_desc.addr = (uint32_t)smp_gdt;
+
+        map_low_identity(TRAMPOLINE_ADDR, TRAMPOLINE_ADDR + ALIGN_4KB, 1);
+        memcpy((void*)TRAMPOLINE_ADDR, ap_trampoline_start, ap_trampoline_end - ap_trampoline_start);
+        TRAMPOLINE_SLOT(uint16_t, ap_boot_gdt) = smp_gdt_desc.size;
+        TRAMPOLINE_SLOT(uint32_t, ap_boot_gdt + sizeof(uint16_t)) = smp_gdt_desc.addr;
+        TRAMPOLINE_SLOT(uint32_t, ap_boot_cr3) = (uint32_t)directoryArray;
+
+        for (i = 1; i < num_cpus; i++) {
+            start_ap(&cpus[i]);
+        }
+    }
+
+    // nothing runs from low memory any more, and page 0 must fault again
+    map_low_identity(TRAMPOLINE_ADDR, TRAMPOLINE_ADDR + ALIGN_4KB, 0);
+
+    online = 0;
+    for (i = 0; i < num_cpus; i++) {
+        online += cpus[i].online;
+    }
+    printf("%u of %u processors online\n", online, num_cpus);
+}
+
+/* void ap_main()
+ * Inputs:      None
+ * Return Value: None, never returns
+ * Function: finishes bringing up an application processor on the stack start_ap gave it:
+ *           loads the shared descriptor tables and its TSS, which makes this_cpu work,
+ *           turns on its FPU, SYSENTER and local APIC timer and joins the scheduler */
+void
+ap_main() {
+    cpu_t* cpu = &cpus[ap_starting];
+
+    asm volatile("lgdt (%0)" : : "r"(&smp_gdt_desc.size) : "memory");
+    lldt(KERNEL_LDT);
+    ltr(AP_TSS_SELECTOR(cpu->id));
+    lidt(idt_desc_ptr);
+
+    init_fpu();
+    init_sysenter();
+    lapic_init();
+    lapic_timer_start();
+    cpu->online = 1;
+
+    lock_kernel();
+    cli();
+    scheduler();
+}
+
+/* void lock_kernel()
+ * Inputs:      None
+ * Return Value: void
+ * Function: takes the big kernel lock, or counts one more level if this processor holds it
+ *           already. Interrupts stay off while the depth and the lock disagree */
+void
+lock_kernel() {
+    cpu_t* cpu;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    cpu = this_cpu();
+    if (cpu->lock_depth++ == 0) {
+        spin_lock(&kernel_lock);
+    }
+    restore_flags(flags);
+}
+
+/* void unlock_kernel()
+ * Inputs:      None
+ * Return Value: void
+ * Function: drops one level of the big kernel lock, releasing it at the outermost level */
+void
+unlock_kernel() {
+    cpu_t* cpu;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    cpu = this_cpu();
+    if (--cpu->lock_depth == 0) {
+        spin_unlock(&kernel_lock);
+    }
+    restore_flags(flags);
+}
+
+/* void tlb_shootdown()
+ * Inputs:      None
+ * Return Value: void
+ * Function: tells every other processor to reload CR3. Only non-global kernel entries change
+ *           (the terminal video pages), so the caller does not wait for them */
+void
+tlb_shootdown() {
+    // also called while paging is set up, before the local APIC is mapped
+    if (num_cpus <= 1) {
+        return;
+    }
+    smp_stats.tlb_shootdowns++;
+    lapic_send_ipi_others(TLB_SHOOTDOWN_VECTOR);
+}
+
+/* void tlb_shootdown_handler()
+ * Inputs:      None
+ * Return Value: void
+ * Function: flushes the non-global TLB entries of this processor */
+void
+tlb_shootdown_handler() {
+    lapic_eoi();
+    asm volatile(
+        "movl %%cr3, %%eax;"
+        "movl %%eax, %%cr3;"
+        :
+        :
+        : "eax", "memory");
+}
+
+/* void reschedule_handler()
+ * Inputs:      None
+ * Return Value: void
+ * Function: a process was queued for this processor. Waking from hlt is enough for the idle
+ *           loop, a running process is preempted if the new one outranks it */
+void
+reschedule_handler() {
+    lock_kernel();
+    lapic_eoi();
+    cli();
+    // the one-shot tick is cut short here when the process was queued from elsewhere
+    if (this_cpu()->id == BOOT_CPU) {
+        pit_exit_tickless();
+    }
+    preempt_if_outranked();
+    unlock_kernel();
+}
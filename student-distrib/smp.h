@@ -0,0 +1,233 @@
+#ifndef _SMP_H
+#define _SMP_H
+
+#include "types.h"
+#include "x86_desc.h"
+
+/* processors the kernel will run on, extra ones in the MP table stay halted */
+#define MAX_CPUS                    8
+#define BOOT_CPU                    0
+
+/* the boot GDT has eight descriptors, application processors load a copy with one more TSS
+   descriptor per processor after them */
+#define GDT_BOOT_ENTRIES            8
+#define SMP_GDT_ENTRIES             (GDT_BOOT_ENTRIES + MAX_CPUS)
+#define AP_TSS_SELECTOR(cpu)        ((GDT_BOOT_ENTRIES + (cpu)) << 3)
+
+/* where application processors start in real mode, the startup IPI vector is its page number */
+#define TRAMPOLINE_ADDR             0x7000
+#define TRAMPOLINE_PAGE             (TRAMPOLINE_ADDR >> 12)
+
+/* CR bits the trampoline turns on, the same ones enablePaging sets on the boot processor */
+#define CR0_PE_PG_WP                0x80010001
+#define CR4_PSE                     0x00000010
+#define CR4_PGE                     0x00000080
+
+#ifndef ASM
+
+/* MP specification tables the BIOS leaves in low memory, they list the processors */
+#define MP_FLOAT_SIGNATURE          0x5F504D5F  /* "_MP_" */
+#define MP_CONFIG_SIGNATURE         0x504D4350  /* "PCMP" */
+#define MP_ENTRY_PROCESSOR          0
+#define MP_ENTRY_BUS                1
+#define MP_ENTRY_IOAPIC             2
+#define MP_ENTRY_IO_INTERRUPT       3
+#define MP_PROCESSOR_ENTRY_SIZE     20
+#define MP_OTHER_ENTRY_SIZE         8
+#define MP_CPU_ENABLED              0x1
+#define MP_IOAPIC_ENABLED           0x1
+#define MP_INT_VECTORED             0
+#define MP_BUS_ISA                  "ISA"
+#define MP_BUS_ISA_LEN              3
+/* second feature byte: the board starts in PIC mode behind the IMCR */
+#define MP_FEATURE2_IMCR            0x80
+#define MP_SEARCH_STEP              16
+
+/* places the MP floating pointer can be: the first KB of the EBDA, the last KB of base
+   memory or the BIOS ROM */
+#define BDA_EBDA_SEGMENT            0x40E
+#define BASE_MEM_LAST_KB            0x9FC00
+#define BIOS_ROM_START              0xF0000
+#define BIOS_ROM_END                0x100000
+#define ONE_KB                      0x400
+
+/* MP floating pointer structure, found on a 16 byte boundary */
+typedef struct __attribute__((packed)) mp_float_t {
+    uint32_t signature;
+    uint32_t config_addr;               // physical address of the configuration table
+    uint8_t length;                     // in 16 byte units
+    uint8_t spec_rev;
+    uint8_t checksum;
+    uint8_t features[5];
+} mp_float_t;
+
+/* MP configuration table header, followed by entry_count variable sized entries */
+typedef struct __attribute__((packed)) mp_config_t {
+    uint32_t signature;
+    uint16_t length;
+    uint8_t spec_rev;
+    uint8_t checksum;
+    uint8_t oem_id[8];
+    uint8_t product_id[12];
+    uint32_t oem_table_addr;
+    uint16_t oem_table_size;
+    uint16_t entry_count;
+    uint32_t lapic_addr;
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+} mp_config_t;
+
+/* configuration table entry describing one processor */
+typedef struct __attribute__((packed)) mp_processor_t {
+    uint8_t type;                       // MP_ENTRY_PROCESSOR
+    uint8_t apic_id;
+    uint8_t apic_version;
+    uint8_t flags;                      // MP_CPU_ENABLED
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+} mp_processor_t;
+
+/* configuration table entry naming a bus, the ISA bus is "ISA   " */
+typedef struct __attribute__((packed)) mp_bus_t {
+    uint8_t type;                       // MP_ENTRY_BUS
+    uint8_t bus_id;
+    int8_t bus_type[6];
+} mp_bus_t;
+
+/* configuration table entry describing one I/O APIC */
+typedef struct __attribute__((packed)) mp_ioapic_t {
+    uint8_t type;                       // MP_ENTRY_IOAPIC
+    uint8_t apic_id;
+    uint8_t apic_version;
+    uint8_t flags;                      // MP_IOAPIC_ENABLED
+    uint32_t addr;
+} mp_ioapic_t;
+
+/* configuration table entry wiring a bus interrupt to an I/O APIC pin */
+typedef struct __attribute__((packed)) mp_io_interrupt_t {
+    uint8_t type;                       // MP_ENTRY_IO_INTERRUPT
+    uint8_t interrupt_type;             // MP_INT_VECTORED for device interrupts
+    uint16_t flags;                     // polarity and trigger mode
+    uint8_t src_bus_id;
+    uint8_t src_bus_irq;
+    uint8_t dst_apic_id;
+    uint8_t dst_pin;
+} mp_io_interrupt_t;
+
+/* port written to wait about a microsecond */
+#define IO_DELAY_PORT               0x80
+#define STARTUP_IPI_COUNT           2
+
+/* CPUID leaf 1 EDX bit for an on-chip local APIC */
+#define CPUID_APIC                  0x00000200
+
+/* INIT and startup IPI delays from the MP specification, in microseconds */
+#define INIT_DEASSERT_DELAY_US      10000
+#define STARTUP_IPI_DELAY_US        200
+#define AP_ONLINE_TIMEOUT_US        100000
+
+/* per-processor state, found through the task register by this_cpu */
+typedef struct cpu_t {
+    uint32_t id;                        // index into cpus, BOOT_CPU for the boot processor
+    uint32_t apic_id;                   // local APIC ID the startup IPIs are sent to
+    volatile uint32_t online;           // set by the processor once it can schedule
+    volatile struct pcb_t* current;     // process running here, NULL while idle
+    volatile uint8_t terminal;          // terminal of that process, read through scheduled_terminal
+    uint32_t lock_depth;                // big kernel lock nesting of the running context
+    struct pcb_t* fpu_owner;            // process whose state is in this processor's FPU
+    uint32_t in_softirq;                // running deferred interrupt work, which is not preempted
+    tss_t* tss;                         // the boot TSS or own_tss
+    tss_t own_tss;
+} cpu_t;
+
+/* test and set lock, held with interrupts off for short critical sections */
+typedef struct spinlock_t {
+    volatile uint32_t locked;
+} spinlock_t;
+
+cpu_t cpus[MAX_CPUS];
+
+// processors in cpus, the boot processor is always cpus[BOOT_CPU]
+uint32_t num_cpus;
+
+/* multiprocessor scheduling activity */
+typedef struct smp_stats_t {
+    uint32_t steals;                    // processes taken from another processor's run queue
+    uint32_t reschedule_ipis;           // idle or outranked processors woken for queued work
+    uint32_t tlb_shootdowns;            // broadcasts after a kernel page table change
+} smp_stats_t;
+
+smp_stats_t smp_stats;
+
+/* cpu_t* this_cpu()
+ * Inputs:      None
+ * Return Value: the processor running the caller
+ * Function: application processors load their own TSS selector, anything below them
+ *           (the boot TSS, or none yet) is the boot processor */
+static inline cpu_t* this_cpu(void) {
+    uint16_t selector;
+
+    asm volatile("str %0" : "=r"(selector));
+    if (selector < AP_TSS_SELECTOR(0)) {
+        return &cpus[BOOT_CPU];
+    }
+    return &cpus[(selector >> 3) - GDT_BOOT_ENTRIES];
+}
+
+/* void spin_lock(spinlock_t* lock)
+ * Inputs:      lock -- lock to take
+ * Return Value: None
+ * Function: spins reading the lock until it looks free, then tries to take it with xchg */
+static inline void spin_lock(spinlock_t* lock) {
+    uint32_t held;
+
+    do {
+        while (lock->locked) {
+            asm volatile("pause");
+        }
+        held = 1;
+        asm volatile("xchgl %0, %1" : "+r"(held), "+m"(lock->locked) : : "memory");
+    } while (held);
+}
+
+/* void spin_unlock(spinlock_t* lock)
+ * Inputs:      lock -- lock held by the caller
+ * Return Value: None
+ * Function: releases the lock after every store made under it */
+static inline void spin_unlock(spinlock_t* lock) {
+    asm volatile("" : : : "memory");
+    lock->locked = 0;
+}
+
+/* set up cpus[BOOT_CPU], called once the boot TSS is loaded */
+void init_boot_cpu();
+
+/* turn on the local APIC and read the MP table, moving the ISA interrupts to the I/O APIC
+   if it lists one. Runs after paging and before any device enables its interrupt */
+void init_apic();
+
+/* start the other processors init_apic found, they join the scheduler. The local APIC
+   timer replaces the PIT as the tick */
+void init_smp();
+
+/* called by the trampoline on each application processor */
+void ap_main();
+
+/* recursive lock around all kernel code, taken on every entry from user mode or an interrupt */
+void lock_kernel();
+void unlock_kernel();
+
+/* make every other processor drop its TLB entries, called after a kernel table changes */
+void tlb_shootdown();
+
+/* handler for the IPI sent by tlb_shootdown */
+void tlb_shootdown_handler();
+
+/* handler for the IPI that wakes an idle processor when work is queued for it */
+void reschedule_handler();
+
+#endif /* ASM */
+
+#endif /* _SMP_H */
@@ -0,0 +1,132 @@
+#include "softirq.h"
+#include "lib.h"
+#include "smp.h"
+#include "scheduler.h"
+
+/* handler registered for a softirq and the IRQ its time is charged to */
+typedef struct softirq_action_t {
+    void (*handler)(void);
+    uint32_t irq;
+} softirq_action_t;
+
+static softirq_action_t softirqs[NUM_SOFTIRQS];
+
+// bits of the softirqs raised and not run yet
+static volatile uint32_t softirq_pending;
+
+// TSC when each pending softirq was raised first
+static uint32_t raised_at[NUM_SOFTIRQS];
+
+/* uint32_t take_pending()
+ * Inputs:      None
+ * Return Value: the pending bits, which are cleared in the same instruction */
+static uint32_t
+take_pending() {
+    uint32_t pending = 0;
+
+    asm volatile("xchgl %0, %1" : "+r"(pending), "+m"(softirq_pending) : : "memory");
+    return pending;
+}
+
+/* void open_softirq(uint32_t nr, uint32_t irq, void (*handler)(void))
+ * Inputs:      nr -- softirq number
+ *              irq -- line whose irq_stats get the bottom half's time
+ *              handler -- deferred work
+ * Return Value: void */
+void
+open_softirq(uint32_t nr, uint32_t irq, void (*handler)(void)) {
+    if (nr >= NUM_SOFTIRQS || irq >= IRQ_LINES) {
+        return;
+    }
+    softirqs[nr].irq = irq;
+    softirqs[nr].handler = handler;
+}
+
+/* void raise_softirq(uint32_t nr)
+ * Inputs:      nr -- softirq number
+ * Return Value: void
+ * Function: sets the pending bit atomically, the raise that sets it stamps the time the
+ *           bottom half's delay is measured from */
+void
+raise_softirq(uint32_t nr) {
+    uint32_t was_set;
+
+    if (nr >= NUM_SOFTIRQS) {
+        return;
+    }
+    asm volatile("lock btsl %2, %1; sbbl %0, %0"
+                 : "=r"(was_set), "+m"(softirq_pending)
+                 : "r"(nr)
+                 : "memory", "cc");
+    if (!was_set) {
+        raised_at[nr] = rdtsc_low();
+    }
+}
+
+/* void run_softirqs()
+ * Inputs:      None
+ * Return Value: void
+ * Function: runs every pending softirq with interrupts on and the kernel lock held until
+ *           none is left. Top halves that interrupt it only raise more. The scheduler leaves
+ *           this processor alone meanwhile, a process the work woke runs at the end */
+static void
+run_softirqs() {
+    cpu_t* cpu = this_cpu();
+    irq_stats_t* stats;
+    uint32_t pending, nr, start, cycles, delay;
+
+    lock_kernel();
+    cpu->in_softirq = 1;
+
+    // checked with interrupts off so a raise cannot slip in after the last check
+    cli();
+    while ((pending = take_pending()) != 0) {
+        sti();
+        for (nr = 0; nr < NUM_SOFTIRQS; nr++) {
+            if (!(pending & (1 << nr)) || softirqs[nr].handler == NULL) {
+                continue;
+            }
+            stats = &irq_stats[softirqs[nr].irq];
+            start = rdtsc_low();
+            delay = start - raised_at[nr];
+            softirqs[nr].handler();
+            cycles = rdtsc_low() - start;
+
+            stats->bottom_runs++;
+            stats->bottom_cycles += cycles;
+            if (cycles > stats->max_bottom_cycles) {
+                stats->max_bottom_cycles = cycles;
+            }
+            if (delay > stats->max_delay_cycles) {
+                stats->max_delay_cycles = delay;
+            }
+        }
+        cli();
+    }
+
+    cpu->in_softirq = 0;
+    preempt_if_outranked();
+    unlock_kernel();
+}
+
+/* void irq_exit(uint32_t irq, uint32_t start)
+ * Inputs:      irq -- line whose top half is ending, after its EOI
+ *              start -- TSC at handler entry
+ * Return Value: void
+ * Function: charges the top half's cycles to the line and runs the softirqs it raised,
+ *           unless this processor interrupted its own softirqs, which pick them up */
+void
+irq_exit(uint32_t irq, uint32_t start) {
+    irq_stats_t* stats = &irq_stats[irq];
+    uint32_t cycles = rdtsc_low() - start;
+
+    stats->count++;
+    stats->top_cycles += cycles;
+    if (cycles > stats->max_top_cycles) {
+        stats->max_top_cycles = cycles;
+    }
+
+    if (softirq_pending != 0 && !this_cpu()->in_softirq) {
+        run_softirqs();
+    }
+}
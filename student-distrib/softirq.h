@@ -0,0 +1,38 @@
+#ifndef _SOFTIRQ_H
+#define _SOFTIRQ_H
+
+#include "types.h"
+
+/* deferred interrupt work, one pending bit each, lower numbers run first */
+#define SOFTIRQ_KEYBOARD            0
+#define SOFTIRQ_RTC                 1
+#define NUM_SOFTIRQS                2
+
+/* ISA interrupt lines the latency counters are kept for */
+#define IRQ_LINES                   16
+
+/* cost of an IRQ's top half, which runs with interrupts off, and of the work it deferred,
+   which runs with them on, in TSC cycles */
+typedef struct irq_stats_t {
+    uint32_t count;                 // top halves run
+    uint32_t top_cycles;            // total cycles from handler entry to the EOI
+    uint32_t max_top_cycles;
+    uint32_t bottom_runs;           // bottom halves run, several top halves can share one
+    uint32_t bottom_cycles;         // total cycles in the bottom half
+    uint32_t max_bottom_cycles;
+    uint32_t max_delay_cycles;      // longest wait from the first raise to the bottom half
+} irq_stats_t;
+
+irq_stats_t irq_stats[IRQ_LINES];
+
+/* run handler for softirq nr, with its time charged to irq, when the softirq is raised */
+void open_softirq(uint32_t nr, uint32_t irq, void (*handler)(void));
+
+/* mark softirq nr pending, safe with interrupts off and from any processor */
+void raise_softirq(uint32_t nr);
+
+/* end of a top half that started at TSC start: counts its latency and runs pending
+   softirqs with interrupts on, unless this processor is already running them */
+void irq_exit(uint32_t irq, uint32_t start);
+
+#endif /* _SOFTIRQ_H */
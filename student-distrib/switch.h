@@ -0,0 +1,47 @@
+#ifndef _SWITCH_H
+#define _SWITCH_H
+
+/* byte offsets into switch_context_t, shared with switch.S */
+#define CTX_EBX             0
+#define CTX_ESI             4
+#define CTX_EDI             8
+#define CTX_EBP             12
+#define CTX_ESP             16
+#define CTX_EIP             20
+#define CTX_EFLAGS          24
+#define CTX_ESP0            28
+
+/* offset of esp0 in the TSS */
+#define TSS_ESP0            4
+
+/* EFLAGS a new kernel context starts with: only the reserved bit, interrupts off like the
+   scheduler that switches to it */
+#define INITIAL_EFLAGS      0x2
+
+#ifndef ASM
+
+#include "types.h"
+
+/* kernel state of a switched out context, everything else is on its stack or caller-saved */
+typedef struct switch_context_t {
+    uint32_t ebx;
+    uint32_t esi;
+    uint32_t edi;
+    uint32_t ebp;
+    uint32_t esp;
+    uint32_t eip;
+    uint32_t eflags;
+    uint32_t esp0;          // kernel stack top for system calls and interrupts from user mode
+    uint32_t lock_depth;    // big kernel lock nesting, saved and restored by the scheduler
+} switch_context_t;
+
+struct tss_t;
+
+/* save the callee-saved registers and EFLAGS into prev (skipped if NULL), point the esp0 of
+   this processor's tss at next's kernel stack and resume next, returns when something
+   switches back to prev */
+extern void switch_to(switch_context_t* prev, switch_context_t* next, struct tss_t* tss);
+
+#endif /* ASM */
+
+#endif /* _SWITCH_H */
@@ -1,4 +1,36 @@
+#ifndef _SYS_CALL_ASM_LINKAGE_H
+#define _SYS_CALL_ASM_LINKAGE_H
+
 #include "system_calls.h"
 
+/* words below esp0 of the state int $0x80 returns to user mode with: the processor's iret
+   frame, then the registers sys_call_linkage saves */
+#define INT_FRAME_SS            1
+#define INT_FRAME_ESP           2
+#define INT_FRAME_EFLAGS        3
+#define INT_FRAME_CS            4
+#define INT_FRAME_EIP           5
+#define INT_FRAME_REGS          12
+/* the same for sysenter_linkage: the return eip taken from the stub, then the same registers */
+#define SYSENTER_FRAME_EIP      1
+#define SYSENTER_FRAME_REGS     8
+
+/* registers both entry points save, lowest address first. eflags is the kernel's, ebx, ecx
+   and edx are the system call arguments */
+typedef struct sys_call_regs_t {
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+    uint32_t eflags;
+    uint32_t esi;
+    uint32_t edi;
+    uint32_t ebp;
+} sys_call_regs_t;
+
 extern void sys_call_linkage();
+extern void sysenter_linkage();
 extern void flush_tlb();
+extern void process_start();
+extern void fork_return();
+
+#endif /* _SYS_CALL_ASM_LINKAGE_H */
@@ -0,0 +1,36 @@
+#include "sysenter.h"
+#include "lib.h"
+#include "smp.h"
+#include "fpu.h"
+#include "x86_desc.h"
+#include "sys_call_asm_linkage.h"
+
+/* void wrmsr(uint32_t msr, uint32_t value)
+ * Inputs:      msr -- register number
+ *              value -- low 32 bits, the high ones are cleared
+ * Return Value: void */
+static void
+wrmsr(uint32_t msr, uint32_t value) {
+    asm volatile("wrmsr" : : "c"(msr), "a"(value), "d"(0) : "memory");
+}
+
+/* void init_sysenter()
+ * Inputs:      None
+ * Return Value: void
+ * Function: SYSENTER enters at sysenter_linkage on a stack inside this processor's TSS, which
+ *           only has to last until esp0 is loaded from it. Called on each processor once its
+ *           TSS is loaded, int $0x80 keeps working either way */
+void
+init_sysenter() {
+    uint32_t eax, ebx, ecx, edx;
+
+    asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(CPUID_FEATURES));
+    if (!(edx & CPUID_SEP) || (eax & CPUID_SIGNATURE_MASK) < SYSENTER_MIN_SIGNATURE) {
+        return;
+    }
+
+    wrmsr(IA32_SYSENTER_CS, KERNEL_CS);
+    wrmsr(IA32_SYSENTER_ESP, (uint32_t)this_cpu()->tss);
+    wrmsr(IA32_SYSENTER_EIP, (uint32_t)sysenter_linkage);
+    sysenter_enabled = 1;
+}
@@ -0,0 +1,39 @@
+#ifndef _SYSENTER_H
+#define _SYSENTER_H
+
+/* model specific registers SYSENTER loads CS, ESP and EIP from, SYSEXIT returns to CS + 16
+   and SS to CS + 24, which with KERNEL_CS are USER_CS and USER_DS */
+#define IA32_SYSENTER_CS            0x174
+#define IA32_SYSENTER_ESP           0x175
+#define IA32_SYSENTER_EIP           0x176
+
+/* CPUID leaf 1 EDX bit for SYSENTER/SYSEXIT */
+#define CPUID_SEP                   0x00000800
+/* early Pentium Pros set the bit without the instructions, family, model and stepping below
+   6, 3, 3 are taken not to have them. The user library makes the same check */
+#define CPUID_SIGNATURE_MASK        0x00000FFF
+#define SYSENTER_MIN_SIGNATURE      0x00000633
+
+/* offset of esp0 in the TSS, SYSENTER_ESP points at the processor's TSS */
+#define TSS_ESP0_OFFSET             4
+
+/* the user stub passes its esp in ebp, which must be a word in the program's page */
+#define SYSENTER_USER_LOW           0x08000000
+#define SYSENTER_USER_HIGH          0x08400000
+
+/* exception a bad stub stack is reported as */
+#define SYSENTER_BAD_STACK_EXC      13
+
+#ifndef ASM
+
+#include "types.h"
+
+/* 1 once this processor's SYSENTER MSRs are set */
+uint32_t sysenter_enabled;
+
+/* point this processor's SYSENTER MSRs at sysenter_linkage, if it has the instructions */
+void init_sysenter();
+
+#endif /* ASM */
+
+#endif /* _SYSENTER_H */
@@ -6,6 +6,12 @@
 #include "x86_desc.h"
 #include "interrupts.h"
 #include "scheduler.h"
+#include "loader.h"
+#include "frame_alloc.h"
+#include "wait_queue.h"
+#include "fpu.h"
+#include "sys_call_asm_linkage.h"
+#include "timer.h"
 
 #define EXEC_BUF_LEN 1026
 #define MAX_EXEC_ARG_LEN 1023
@@ -16,41 +22,57 @@
 #define SIZE_OF_BYTE 8
 #define LOW_BYTE_MASK 0xFF
 #define ADDR_128MB 0x08000000
-#define PROG_IMG_OFFSET 0x00048000
 #define FOUR_MB            0x400000
-#define NUM_PIDS 6
 #define STDIN_FD 0
 #define STDOUT_FD 1
 #define EIGHT_KB           0x2000
 #define FOUR_KB            0x1000
-#define EIGHT_MB           0x800000
 #define EXCEPTION_RET_VAL       256
 #define MAX_FILENAME_LEN        32
+/* IF plus the always-set bit 1, new processes start with interrupts on */
+#define USER_EFLAGS             0x202
+#define MAX_PIDS_OPTION         "max_pids="
 
 uint8_t file_check[MAGIC_NUM_LEN] = {0x7f, 0x45, 0x4c, 0x46}; // magic numbers to check if file is executable
 
-struct term_table_t terminal_op_table = {terminal_open, terminal_read, terminal_write, terminal_close};
-struct file_table_t file_op_table = {file_open, file_read, file_write, file_close};
-struct rtc_table_t rtc_op_table = {rtc_open, rtc_read, rtc_write, rtc_close};
-struct dir_table_t dir_op_table = {directory_open, directory_read, directory_write, directory_close};
+file_op_table_t terminal_op_table = {terminal_open, terminal_read, terminal_write, terminal_close};
+file_op_table_t file_op_table = {file_open, file_read, file_write, file_close};
+file_op_table_t rtc_op_table = {rtc_open, rtc_read, rtc_write, rtc_close};
+file_op_table_t dir_op_table = {directory_open, directory_read, directory_write, directory_close};
+
+// op table for each dentry file type, indexed by fileType
+file_op_table_t* dentry_op_tables[NUM_DENTRY_FILE_TYPES] = {&rtc_op_table, &dir_op_table, &file_op_table};
+
+// 8KB kernel stack of each pid with its PCB at the bottom, allocated on first use
+static pcb_t* pcb_table[NUM_PIDS];
+
+// pids put back since boot, each entry links to the next free pid, popped and pushed in O(1)
+static int32_t pid_next_free[NUM_PIDS];
+static int32_t free_pid_head = NO_FREE_PID;
+// pids at or above this have never been handed out, they are used once the free list runs dry
+static int32_t unused_pid_start;
+static spinlock_t pid_lock;
+
+// processes that halted with nobody waiting for them, linked through run_next until
+// reap_orphans frees them
+static pcb_t* orphans;
+
+static int32_t create_process(const uint8_t* command, uint32_t terminal, int32_t parent_pid, uint32_t respawn);
 
 
 /* int32_t halt(uint8_t status)
  * 
- * Returns from a process to a previous user process.
+ * Ends the current process and wakes the parent waiting for it in execute.
  * 
  * Inputs: status -- return value of process
- * Return Value: -1 on failure, 256 if process exits with exception, 0-255 if process exits properly
+ * Return Value: -1 on failure, does not return otherwise
  * Function: halts program
  */
 int32_t halt(uint8_t status)
 {
     int i;
-    uint32_t ebp_temp_val, esp_temp_val, ret_val, temp_pid;
-
-    // get cached values
-    ebp_temp_val = current_pcb->ebp_val;
-    esp_temp_val = current_pcb->esp_val;
+    uint32_t ret_val;
+    pcb_t* pcb = (pcb_t*)current_pcb;
 
     // handle exception in child process
     if (exception_in_child) {
@@ -66,88 +88,60 @@ int32_t halt(uint8_t status)
         close(i);
     }
 
-    cli();
-    // empty stored EBP and ESP values
-    current_pcb->ebp_val = 0;
-    current_pcb->esp_val = 0;
-
-    // allow process_id to be used
-    current_pcb->in_use = 0;
+    record_user_image_stats(pcb);
+    release_user_image(pcb);
+    fpu_release(pcb);
 
-    // handle base shell case
-    if (current_pcb->process_id < MAX_TERMINALS)
-    {
-        temp_pid = current_pcb->process_id;
-
-        current_pcb->parent_process_id = 0;
-        current_pcb->process_id = 0;
+    cli();
 
-        current_pcb = 0;
+    // a zombie is never queued again, so the scheduler does not come back here
+    pcb->state = PROCESS_ZOMBIE;
 
-        tss.esp0 = EIGHT_MB - (EIGHT_KB * temp_pid) - sizeof(int);
-        sti();
-        execute((const uint8_t*)"shell");
+    if (pcb->detached) {
+        // nobody reaps base shells, background jobs or forked children, the pid and kernel
+        // stack are freed once this process has switched away from them for good
+        pcb->run_next = orphans;
+        orphans = pcb;
+    } else {
+        // the parent frees the pid once it has read the status
+        pcb->exit_status = ret_val;
+        wake_up(&get_pcb_ptr(pcb->parent_process_id)->child_exit_queue);
     }
 
-    // find parent pcb
-    pcb_t* parent_pcb = get_pcb_ptr(current_pcb->parent_process_id);
-
-    tss.esp0 = EIGHT_MB - (EIGHT_KB * current_pcb->parent_process_id) - sizeof(int);
-
-    current_pcb->parent_process_id = 0;
-    current_pcb->process_id = 0;
-
-    // update current page
-    directoryArray[USER_SPACE_DIR_NUM].offset_31_12 = get_phys_addr(parent_pcb->process_id);
-    flush_tlb();
-
-    current_pcb = parent_pcb;
-
-    terminals[scheduled_terminal].active_pid = current_pcb->process_id;
-    sti();
-
-    // return to parent
-    asm volatile(
-        "movl %0, %%ebp;"
-        "movl %1, %%esp;"
-        "xorl %%eax, %%eax;"
-        "movl %2, %%eax;"
-        "leave;"
-        "ret;"
-        :
-        : "r"(ebp_temp_val), "r"(esp_temp_val), "r"(ret_val)
-        : "cc", "%eax", "%ebp", "%esp");
+    scheduler();
 
     return -1;
 }
 
 
-/* int32_t execute(const uint8_t* command)
+/* int32_t find_program(const uint8_t* command, uint8_t* arg, dentry_t* file_dentry, uint32_t* entry_point)
  * 
- * This function is called when a new program should be run. It sets up paging for a file,
- * creates the PCB and assigns process ID, and context switches.
+ * Splits a command into the program name and its arguments and checks the program is an
+ * executable
  * 
- * Inputs: command -- string containing command to execute
- * Return Value: -1 on failure, 256 if process exits with exception, 0-255 if process exits properly
- * Function: executes program
+ * Inputs: command -- program name followed by its arguments
+ *         arg -- EXEC_ARG_LEN bytes, filled with the arguments and zero padded
+ *         file_dentry -- filled with the program's directory entry
+ *         entry_point -- filled with the address the program starts at
+ * Return Value: 0 on success, -1 if the command is too long or names no executable
+ * Function: parses and validates a command for execute and exec
  */
-int32_t execute (const uint8_t* command) {
-    uint8_t arg[EXEC_ARG_LEN];
+static int32_t find_program(const uint8_t* command, uint8_t* arg, dentry_t* file_dentry, uint32_t* entry_point) {
     uint8_t filename[MAX_FILENAME_LEN];
-    int i;
-    uint32_t process_id;
     uint8_t header[ENTRY_PT_START + ENTRY_PT_LEN];
-    dentry_t file_dentry;
-    uint32_t entry_point;
+    int i;
     int cmd_len;
     int arg_start_idx = 0;
     int arg_index = 0;
 
     /*Parsing Args*/
-    cmd_len = strlen((const int8_t*) command);
 
     //checks to see if command is valid, returns -1 if too long or null
-    if (EXEC_ARG_LEN < cmd_len || command == NULL) {
+    if (command == NULL) {
+        return -1;
+    }
+    cmd_len = strlen((const int8_t*) command);
+    if (EXEC_ARG_LEN < cmd_len) {
         return -1;
     }
 
@@ -182,13 +176,13 @@ int32_t execute (const uint8_t* command) {
     /*Check file validity*/
 
     // file doesn't exist
-    if (read_dentry_by_name(filename, &file_dentry) != 0)
+    if (read_dentry_by_name(filename, file_dentry) != 0)
     {
         return -1;
     }
 
     // get file header
-    read_data(file_dentry.inodeNumber, 0, header, (ENTRY_PT_START + ENTRY_PT_LEN));
+    read_data(file_dentry->inodeNumber, 0, header, (ENTRY_PT_START + ENTRY_PT_LEN));
 
     // check first 4 bytes
     for (i = 0; i < MAGIC_NUM_LEN; i++)
@@ -200,128 +194,342 @@ int32_t execute (const uint8_t* command) {
     }
 
     // get entry point
-    entry_point = 0;
+    *entry_point = 0;
     for (i = 0; i < ENTRY_PT_LEN; i++)
     {
-        entry_point |= ((header[i + ENTRY_PT_START] & LOW_BYTE_MASK) << (i * SIZE_OF_BYTE));
+        *entry_point |= ((header[i + ENTRY_PT_START] & LOW_BYTE_MASK) << (i * SIZE_OF_BYTE));
     }
+    return 0;
+}
 
-    // check if we're swapping temrinals for the first time
-    if (!initialized_terminals[active_terminal]) {
-        process_id = active_terminal;
-    } else {
-        // assign process_id
-        process_id = get_pid();
+/* int32_t create_process(const uint8_t* command, uint32_t terminal, int32_t parent_pid, uint32_t respawn)
+ * 
+ * Sets up paging for a file, creates the PCB and assigns a process ID, then puts the new
+ * process on the run queue. Its kernel stack is built so the first switch to it returns
+ * into process_start, which irets to the program's entry point.
+ * 
+ * Inputs: command -- program name followed by its arguments
+ *         terminal -- terminal the process reads from and draws to
+ *         parent_pid -- process waiting for it in execute, NO_PARENT if none
+ *         respawn -- 1 for a base shell that is restarted when it halts
+ * Return Value: pid of the new process, -1 on failure
+ * Function: creates a ready process
+ */
+static int32_t create_process(const uint8_t* command, uint32_t terminal, int32_t parent_pid, uint32_t respawn) {
+    uint8_t arg[EXEC_ARG_LEN];
+    int i;
+    int32_t process_id;
+    dentry_t file_dentry;
+    uint32_t entry_point;
+    uint32_t* stack;
+    uint32_t flags;
+    uint32_t start_tsc = rdtsc_low();
+
+    if (find_program(command, arg, &file_dentry, &entry_point) != 0) {
+        return -1;
     }
 
+    /* create pcb */
+
+    cli_and_save(flags);
+    process_id = get_pid();
+
     // no process ids available
     if (process_id == -1) {
+        restore_flags(flags);
+        return -1;
+    }
+
+    pcb_t* new_pcb = get_pcb_ptr(process_id);
+
+    // no frames left for the kernel stack
+    if (new_pcb == NULL) {
+        put_pid(process_id);
+        restore_flags(flags);
         return -1;
     }
 
+    // claim the pid before interrupts can run another execute
+    new_pcb->in_use = 1;
+    restore_flags(flags);
+
+    new_pcb->process_id = process_id;
+    new_pcb->parent_process_id = parent_pid;
+    new_pcb->terminal = terminal;
+    new_pcb->respawn = respawn;
+    new_pcb->detached = (parent_pid == NO_PARENT);
+    new_pcb->state = PROCESS_BLOCKED;
+    new_pcb->wait_next = NULL;
+    new_pcb->run_next = NULL;
+    new_pcb->child_exit_queue.head = NULL;
+    new_pcb->exit_status = 0;
+    new_pcb->thread_entry = NULL;
+
+    // children keep their parent's nice level, restarted shells start over at the top
+    new_pcb->base_priority = (current_pcb != NULL && !respawn) ? current_pcb->base_priority : TOP_PRIORITY;
+    new_pcb->priority = new_pcb->base_priority;
+    new_pcb->ticks_used = 0;
+
     /* Set up Paging
-     1. create 4mb physical page in directory
-     2. copy program data to that page
-     3. link that page to appropriate address in virtual memory
-     can swap 2 and 3
+     1. unmap every page of the program region in the process's page table
+     2. build the process's page directory with that table at 128MB
+     pages are faulted in from the file on first touch, see handle_user_page_fault
     */
-   
-    // create page in page directory
+    if (load_user_image(new_pcb, file_dentry.inodeNumber) != 0 || setup_page_directory(new_pcb) != 0) {
+        release_user_image(new_pcb);
+        put_pid(process_id);
+        return -1;
+    }
 
-    // USER_SPACE_DIR_NUM = 128MB / 4MB page size = 32
+    for (i = 0; i < FD_ARRAY_LENGTH; i++)
+    {
+        fd_element_t empty = {.file_op_table_ptr = 0, .file_position = 0, .flags = 0, .inode_num = 0, .file_type = 0};
+        new_pcb->fd_array[i] = empty;
+    }
 
-    directoryArray[USER_SPACE_DIR_NUM].offset_31_12 = get_phys_addr(process_id);
+    memcpy(new_pcb->arg, arg, EXEC_ARG_LEN);
 
-    flush_tlb();
-    // copy program data to 4MB space in directory
-    read_data(file_dentry.inodeNumber, 0, (uint8_t *)(ADDR_128MB + PROG_IMG_OFFSET), FOUR_MB);
+    /* add stdin, stdout to fda */
 
-    
+    new_pcb->fd_array[STDIN_FD].file_op_table_ptr  = &terminal_op_table;
+    new_pcb->fd_array[STDIN_FD].file_type = TERMINAL_FILE_TYPE;
+    new_pcb->fd_array[STDIN_FD].flags = 1;
 
-    /* create pcb */
+    new_pcb->fd_array[STDOUT_FD].file_op_table_ptr  = &terminal_op_table;
+    new_pcb->fd_array[STDOUT_FD].file_type = TERMINAL_FILE_TYPE;
+    new_pcb->fd_array[STDOUT_FD].flags = 1;
 
-    pcb_t* new_pcb = get_pcb_ptr(process_id);
+    /* first context switch: switch_to jumps to process_start, which irets to user mode
+       with this frame */
+    stack = (uint32_t*)get_kernel_stack_top(process_id);
+    stack[0] = USER_DS;
+    stack[-1] = USER_ESP;
+    stack[-2] = USER_EFLAGS;
+    stack[-3] = USER_CS;
+    stack[-4] = entry_point;
+    memset(&new_pcb->context, 0, sizeof(new_pcb->context));
+    new_pcb->context.esp = (uint32_t)&stack[-4];
+    new_pcb->context.eip = (uint32_t)process_start;
+    new_pcb->context.eflags = INITIAL_EFLAGS;
+    new_pcb->context.esp0 = get_kernel_stack_top(process_id);
+    new_pcb->context.lock_depth = 1;
+    new_pcb->cpu = least_loaded_cpu();
+
+    // the base shell or foreground job is the one terminal input belongs to
+    if (parent_pid != NO_PARENT || respawn) {
+        terminals[terminal].active_pid = process_id;
+    }
 
-    new_pcb->in_use = 1;
+    new_pcb->startup_cycles = rdtsc_low() - start_tsc;
 
-    for (i = 0; i < FD_ARRAY_LENGTH; i++)
-    {
-        fd_element_t empty = {.file_op_table_ptr = 0, .file_position = 0, .flags = 0, .inode_num = 0};
-        new_pcb->fd_array[i] = empty;
+    cli_and_save(flags);
+    make_ready(new_pcb);
+    restore_flags(flags);
+
+    return process_id;
+}
+
+
+/* int32_t execute(const uint8_t* command)
+ * 
+ * This function is called when a new program should be run. The program is queued on the
+ * caller's terminal; a command ending in '&' runs in the background and execute returns at
+ * once, otherwise the caller sleeps until the program halts.
+ * 
+ * Inputs: command -- string containing command to execute
+ * Return Value: -1 on failure, 0 for a background job, 256 if process exits with exception,
+ *               0-255 if process exits properly
+ * Function: executes program
+ */
+int32_t execute (const uint8_t* command) {
+    uint8_t cmd[EXEC_ARG_LEN + 1];
+    int32_t cmd_len, child_pid;
+    uint32_t background = 0;
+    uint32_t ret_val, flags;
+    pcb_t* parent = (pcb_t*)current_pcb;
+    pcb_t* child;
+
+    //checks to see if command is valid, returns -1 if too long or null
+    if (command == NULL || parent == NULL) {
+        return -1;
+    }
+    cmd_len = strlen((const int8_t*) command);
+    if (EXEC_ARG_LEN < cmd_len) {
+        return -1;
     }
+    strcpy((int8_t*)cmd, (const int8_t*)command);
 
-    new_pcb->process_id = process_id;
-    new_pcb->ebp_val = 0;
-    new_pcb->esp_val = 0;
-
-    // initial case, open 3 shells with different terminals, set active terminal to 0
-    if (process_id < MAX_TERMINALS) {
-        if (process_id == 0) {
-            active_terminal = TERMINAL_1;
-            // reserving pids 1 & 2
-            pcb_t* temp_pcb = get_pcb_ptr(TERMINAL_2);
-            temp_pcb->in_use = 1;
-            temp_pcb = get_pcb_ptr(TERMINAL_3);
-            temp_pcb->in_use = 1;
+    // a trailing '&' asks for a background job
+    while (cmd_len > 0 && cmd[cmd_len - 1] == ' ') {
+        cmd_len--;
+    }
+    if (cmd_len > 0 && cmd[cmd_len - 1] == '&') {
+        background = 1;
+        cmd_len--;
+        while (cmd_len > 0 && cmd[cmd_len - 1] == ' ') {
+            cmd_len--;
         }
-        new_pcb->parent_process_id = -1;
-    } else {
-        new_pcb->parent_process_id = terminals[active_terminal].active_pid;
     }
+    cmd[cmd_len] = '\0';
 
-    if (arg_start_idx < cmd_len) {
-        strcpy((int8_t*)(new_pcb->arg), (int8_t*)arg);
+    child_pid = create_process(cmd, parent->terminal, background ? NO_PARENT : parent->process_id, 0);
+    if (child_pid == -1) {
+        return -1;
+    }
+    if (background) {
+        return 0;
     }
 
-    /* add stdin, stdout to fda */
-
-    new_pcb->fd_array[STDIN_FD].file_op_table_ptr  = (int32_t *)&terminal_op_table;
-    new_pcb->fd_array[STDIN_FD].flags = 1;
+    // sleep until the child is a zombie, then reap it
+    child = get_pcb_ptr(child_pid);
+    cli_and_save(flags);
+    while (child->state != PROCESS_ZOMBIE) {
+        sleep_on(&parent->child_exit_queue);
+    }
+    ret_val = child->exit_status;
+    put_pid(child_pid);
+    terminals[parent->terminal].active_pid = parent->process_id;
+    restore_flags(flags);
 
-    new_pcb->fd_array[STDOUT_FD].file_op_table_ptr  = (int32_t *)&terminal_op_table;
-    new_pcb->fd_array[STDOUT_FD].flags = 1;
+    return ret_val;
+}
 
-    // save for halt return
-    tss.esp0 = (EIGHT_MB - (EIGHT_KB * (process_id))) - sizeof(int);
+/* int32_t start_terminal_shell(uint32_t terminal)
+ * 
+ * Queues the base shell of a terminal, it is restarted whenever it halts
+ * 
+ * Inputs: terminal -- terminal to start the shell on
+ * Return Value: 0 on success, -1 if the shell could not be created
+ * Function: initializes a terminal
+ */
+int32_t start_terminal_shell(uint32_t terminal) {
+    if (create_process((const uint8_t*)"shell", terminal, NO_PARENT, 1) == -1) {
+        return -1;
+    }
+    initialized_terminals[terminal] = 1;
+    return 0;
+}
 
-    register uint32_t stored_esp asm("esp");
-    register uint32_t stored_ebp asm("ebp");
+/* void reap_orphans()
+ * 
+ * Frees the processes that halted with nobody waiting for them
+ * 
+ * Inputs: None
+ * Return Value: None
+ * Function: puts the pid of each one back and queues a new shell for a base shell, the pid
+ *           going back first so a terminal gets its shell even when every other pid is
+ *           taken. Called holding the kernel lock by a context the scheduler has just
+ *           switched to. A halting process holds the lock until it has switched away, so by
+ *           then nothing runs on its pcb, kernel stack or page directory any more
+ */
+void reap_orphans() {
+    pcb_t* pcb;
+    uint32_t terminal, respawn, flags;
+
+    cli_and_save(flags);
+    while (orphans != NULL) {
+        pcb = orphans;
+        orphans = pcb->run_next;
+        terminal = pcb->terminal;
+        respawn = pcb->respawn;
+        put_pid(pcb->process_id);
+        if (respawn && start_terminal_shell(terminal) != 0) {
+            // switching back to the terminal tries again
+            initialized_terminals[terminal] = 0;
+            printf("could not start a new shell on terminal %u\n", terminal);
+        }
+    }
+    restore_flags(flags);
+}
 
-    new_pcb->ebp_val = stored_ebp;
-    new_pcb->esp_val = stored_esp;
+/* void kernel_thread_start()
+ * 
+ * First code a kernel thread runs, the scheduler switches to it with interrupts disabled
+ * and the big kernel lock held
+ * 
+ * Inputs: None
+ * Return Value: None, never returns
+ * Function: runs the thread's entry function without the lock, then exits the thread
+ */
+static void kernel_thread_start() {
+    pcb_t* pcb = (pcb_t*)current_pcb;
 
-    /* context switch */
-    current_pcb = new_pcb;
+    unlock_kernel();
+    sti();
+    pcb->thread_entry();
 
-    // might need to be scheduled_terminal
-    terminals[active_terminal].active_pid = current_pcb->process_id;
+    lock_kernel();
+    cli();
+    fpu_release(pcb);
+    pcb->state = PROCESS_ZOMBIE;
+    pcb->run_next = orphans;
+    orphans = pcb;
+    scheduler();
+}
 
-    // activate terminal so scheduler can now move to this terminal
-    if (!initialized_terminals[active_terminal]) {
-        initialized_terminals[active_terminal] = 1;
-        
-        // wait for pit interrupt to set scheduled_terminal to active terminal
-        // that way, when iret-ing to shell user code, we are set to the correct terminal
-        while(1) {
-            if (active_terminal == scheduled_terminal) {
-                break;
-            }
+/* int32_t create_kernel_thread(void (*entry)(void), uint32_t terminal)
+ * 
+ * Queues a process that runs a kernel function instead of a user program
+ * 
+ * Inputs: entry -- function the thread runs, the thread exits when it returns
+ *         terminal -- terminal the thread prints to
+ * Return Value: pid of the thread, -1 on failure
+ * Function: creates a ready kernel thread
+ */
+int32_t create_kernel_thread(void (*entry)(void), uint32_t terminal) {
+    int32_t process_id;
+    pcb_t* pcb;
+    uint32_t* stack;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    process_id = get_pid();
+    pcb = (process_id == -1) ? NULL : get_pcb_ptr(process_id);
+    if (pcb == NULL) {
+        if (process_id != -1) {
+            put_pid(process_id);
         }
+        restore_flags(flags);
+        return -1;
+    }
+    pcb->in_use = 1;
+    restore_flags(flags);
+
+    pcb->process_id = process_id;
+    pcb->parent_process_id = NO_PARENT;
+    pcb->terminal = terminal;
+    pcb->respawn = 0;
+    pcb->detached = 1;
+    pcb->wait_next = NULL;
+    pcb->child_exit_queue.head = NULL;
+    pcb->thread_entry = entry;
+    pcb->base_priority = TOP_PRIORITY;
+    pcb->priority = TOP_PRIORITY;
+    pcb->ticks_used = 0;
+
+    // no program region, the directory only holds the kernel and the terminal's video page
+    pcb->image_inode = 0;
+    if (setup_page_directory(pcb) != 0) {
+        put_pid(process_id);
+        return -1;
     }
 
-    // currently, we go to the new program we just created, but then we start executing it out of order
-    asm volatile(
-        "pushl %0;" // push USER_DS
-        "pushl %1;" // push ESP
-        "pushfl;"   // push EFLAG
-        "pushl %2;" // push USER_CS
-        "pushl %3;" // push EIP
-        "iret;"
-        :
-        : "r"(USER_DS), "r"(USER_ESP), "r"(USER_CS), "r"(entry_point)
-        : "memory");
-
-    return -1;
+    // switch_to jumps to kernel_thread_start on an empty stack, the slot at the top stands in
+    // for the return address it never uses
+    stack = (uint32_t*)get_kernel_stack_top(process_id);
+    memset(&pcb->context, 0, sizeof(pcb->context));
+    pcb->context.esp = (uint32_t)stack;
+    pcb->context.eip = (uint32_t)kernel_thread_start;
+    pcb->context.eflags = INITIAL_EFLAGS;
+    pcb->context.esp0 = get_kernel_stack_top(process_id);
+    pcb->context.lock_depth = 1;
+    pcb->cpu = least_loaded_cpu();
+
+    cli_and_save(flags);
+    make_ready(pcb);
+    restore_flags(flags);
+
+    return process_id;
 }
 
 /* int32_t read(const int32_t fd, void* buf, const int32_t nbytes)
@@ -334,8 +542,7 @@ int32_t execute (const uint8_t* command) {
  */
 int32_t read(int32_t fd, void *buf, int32_t nbytes)
 {
-    dentry_t file_dentry;
-    int32_t dentry_index;
+    int32_t ret_val;
 
     // check index
     if (fd < 0 || fd >= FD_ARRAY_LENGTH)
@@ -350,51 +557,17 @@ int32_t read(int32_t fd, void *buf, int32_t nbytes)
     }
 
     // check for stdout
-    if (fd == 1)
+    if (fd == STDOUT_FD)
     {
         return -1;
     }
 
-    // call read function from fd array for terminal
-    if (fd == 0)
-    {
-        int32_t (*read)(int32_t, void *, int32_t) = (void *)current_pcb->fd_array[fd].file_op_table_ptr[1];
-        int32_t ret_val = (*read)(fd, buf, nbytes);
-        return ret_val;
-    }
-
-    if (-1 == (dentry_index = find_dentry_by_inode_num(current_pcb->fd_array[fd].inode_num))) {
-        return -1;
-    }
-
-    if (read_dentry_by_index(dentry_index, &file_dentry) != 0)
-    {
-        return -1; // fail condition for if can't read dentry by inode
-    }
-
-    // call rtc read
-    if (file_dentry.fileType == RTC_FILE_TYPE)
-    {
-        int32_t (*read)(int32_t, void *, int32_t) = (void *)current_pcb->fd_array[fd].file_op_table_ptr[1];
-        int32_t ret_val = (*read)(fd, buf, nbytes);
-        return ret_val;
-        // call dir read
-    }
-    else if (file_dentry.fileType == DIRECTORY_FILE_TYPE)
-    {
-        int32_t (*read)(int32_t, void *, int32_t) = (void *)current_pcb->fd_array[fd].file_op_table_ptr[1];
-        int32_t ret_val = (*read)(current_pcb->fd_array[fd].file_position, buf, nbytes);
-        current_pcb->fd_array[fd].file_position += 1;
-        return ret_val;
-        // call file read
-    }
-    else
-    {
-        int32_t (*read)(uint32_t, int32_t, void *, int32_t) = (void *)current_pcb->fd_array[fd].file_op_table_ptr[1];
-        int32_t ret_val = (*read)(current_pcb->fd_array[fd].inode_num, current_pcb->fd_array[fd].file_position, buf, nbytes);
-        current_pcb->fd_array[fd].file_position += ret_val;
-        return ret_val;
+    // dispatch through the op table recorded at open, the driver advances file_position itself
+    ret_val = current_pcb->fd_array[fd].file_op_table_ptr->read(fd, buf, nbytes);
+    if (ret_val > 0) {
+        sys_call_stats.io_bytes += ret_val;
     }
+    return ret_val;
 }
 
 /* int32_t write(int32_t fd, const void* buf, int32_t nbytes)
@@ -407,6 +580,8 @@ int32_t read(int32_t fd, void *buf, int32_t nbytes)
  */
 int32_t write(int32_t fd, const void *buf, int32_t nbytes)
 {
+    int32_t ret_val;
+
     // check index
     if (fd < 0 || fd >= FD_ARRAY_LENGTH)
     {
@@ -420,29 +595,17 @@ int32_t write(int32_t fd, const void *buf, int32_t nbytes)
     }
 
     // check for stdin
-    if (fd == 0)
+    if (fd == STDIN_FD)
     {
         return -1;
     }
 
-    int32_t (*write)(int32_t, const void *, int32_t) = (void *)current_pcb->fd_array[fd].file_op_table_ptr[2];
-
-    // call write function from fd array for terminal
-    if (fd == 1)
-    {
-        int32_t ret_val = (*write)(fd, buf, nbytes);
-        return ret_val;
-    }
-
-    if ((rtc_table_t*) current_pcb->fd_array[fd].file_op_table_ptr == &rtc_op_table)
-    {
-        int32_t ret_val = (*write)(fd, buf, nbytes);
-        return ret_val;
-    }
-    else
-    {
-        return -1; // read only file system
+    // files and directories reject writes themselves, read only file system
+    ret_val = current_pcb->fd_array[fd].file_op_table_ptr->write(fd, buf, nbytes);
+    if (ret_val > 0) {
+        sys_call_stats.io_bytes += ret_val;
     }
+    return ret_val;
 }
 
 /* int32_t open(const uint8_t* filename)
@@ -475,34 +638,21 @@ int32_t open(const uint8_t *filename)
         return -1;
     }
 
-    if (file_dentry.fileType == RTC_FILE_TYPE)
+    if (file_dentry.fileType >= NUM_DENTRY_FILE_TYPES)
     {
-        // setup for rtc
-        current_pcb->fd_array[open_fd].file_op_table_ptr = (int32_t *)&rtc_op_table;
-        current_pcb->fd_array[open_fd].file_position = 0;
-        current_pcb->fd_array[open_fd].inode_num = file_dentry.inodeNumber;
-        current_pcb->fd_array[open_fd].flags = 1;
-    }
-    else if (file_dentry.fileType == DIRECTORY_FILE_TYPE)
-    {
-        // setup for directory
-        current_pcb->fd_array[open_fd].file_op_table_ptr = (int32_t *)&dir_op_table;
-        current_pcb->fd_array[open_fd].file_position = 0;
-        current_pcb->fd_array[open_fd].inode_num = file_dentry.inodeNumber;
-        current_pcb->fd_array[open_fd].flags = 1;
-    }
-    else
-    {
-        // setup for regular file
-        current_pcb->fd_array[open_fd].file_op_table_ptr = (int32_t *)&file_op_table;
-        current_pcb->fd_array[open_fd].file_position = 0;
-        current_pcb->fd_array[open_fd].inode_num = file_dentry.inodeNumber;
-        current_pcb->fd_array[open_fd].flags = 1;
+        return -1;
     }
 
+    // record the type and op table so read/write never have to look the dentry up again
+    current_pcb->fd_array[open_fd].file_op_table_ptr = dentry_op_tables[file_dentry.fileType];
+    current_pcb->fd_array[open_fd].file_type = file_dentry.fileType;
+    current_pcb->fd_array[open_fd].file_position = 0;
+    current_pcb->fd_array[open_fd].inode_num = file_dentry.inodeNumber;
+    current_pcb->fd_array[open_fd].rtc_divisor = 0;
+    current_pcb->fd_array[open_fd].flags = 1;
+
     // call open function
-    int32_t (*open)(const uint8_t *) = (void *)current_pcb->fd_array[open_fd].file_op_table_ptr[0];
-    (*open)(filename);
+    current_pcb->fd_array[open_fd].file_op_table_ptr->open(filename);
 
     // return file descriptor
     return open_fd;
@@ -526,14 +676,14 @@ int32_t close(int32_t fd)
     else
     {
         // call appropriate close function
-        int32_t (*close)(int32_t) = (void *)current_pcb->fd_array[fd].file_op_table_ptr[3];
-        (*close)(fd);
+        current_pcb->fd_array[fd].file_op_table_ptr->close(fd);
 
         // clear fd array element
         current_pcb->fd_array[fd].file_op_table_ptr = 0;
         current_pcb->fd_array[fd].file_position = 0;
         current_pcb->fd_array[fd].flags = 0;
         current_pcb->fd_array[fd].inode_num = 0;
+        current_pcb->fd_array[fd].file_type = 0;
 
         return 0;
     }
@@ -586,6 +736,263 @@ int32_t sigreturn(void)
     return -1;
 }
 
+/* int32_t nice(int32_t increment)
+ * 
+ * Moves the calling process's base priority, larger levels get the CPU less often but for
+ * longer at a time
+ * 
+ * Inputs: increment -- levels to add to the base priority, negative to raise it
+ * Return Value: the new base priority, clamped to the valid levels
+ * Function: sets the level the process returns to at every priority reset
+ */
+int32_t nice(int32_t increment)
+{
+    int32_t level = (int32_t)current_pcb->base_priority + increment;
+    uint32_t flags;
+
+    if (level < TOP_PRIORITY) {
+        level = TOP_PRIORITY;
+    } else if (level > LOWEST_PRIORITY) {
+        level = LOWEST_PRIORITY;
+    }
+
+    cli_and_save(flags);
+    current_pcb->base_priority = level;
+    current_pcb->priority = level;
+    current_pcb->ticks_used = 0;
+    restore_flags(flags);
+
+    return level;
+}
+
+/* process waiting in sleep, woken by its timer */
+typedef struct sleeper_t {
+    kernel_timer_t timer;       // first, the callback gets it back as the sleeper
+    wait_queue_t queue;
+    volatile uint32_t done;
+} sleeper_t;
+
+/* void wake_sleeper(kernel_timer_t* timer)
+ * Inputs:      timer -- timer of a sleeper_t that ran out
+ * Return Value: void */
+static void wake_sleeper(kernel_timer_t* timer)
+{
+    sleeper_t* sleeper = (sleeper_t*)timer;
+
+    sleeper->done = 1;
+    wake_up(&sleeper->queue);
+}
+
+/* int32_t sleep(int32_t ms)
+ * 
+ * Blocks the calling process for at least ms milliseconds without using the CPU
+ * 
+ * Inputs: ms -- time to sleep, 0 only gives up the rest of the quantum
+ * Return Value: 0, -1 for a negative time
+ * Function: arms a one-shot kernel timer on the kernel stack and sleeps on a wait queue of
+ *           its own until the timer wheel fires it, rounded up to whole ticks
+ */
+int32_t sleep(int32_t ms)
+{
+    sleeper_t sleeper;
+    uint32_t flags;
+
+    if (ms < 0) {
+        return -1;
+    }
+    if (ms == 0) {
+        yield();
+        return 0;
+    }
+
+    sleeper.queue.head = NULL;
+    sleeper.done = 0;
+    init_timer(&sleeper.timer, wake_sleeper, NULL);
+
+    cli_and_save(flags);
+    add_timer(&sleeper.timer, ms_to_ticks_ceil(ms), 0);
+    while (!sleeper.done) {
+        sleep_on(&sleeper.queue);
+    }
+    restore_flags(flags);
+    return 0;
+}
+
+/* uint32_t entered_by_int(const uint32_t* top)
+ * Inputs:      top -- esp0 of the current process, inside a system call from user mode
+ * Return Value: 1 if the system call came in by int $0x80, 0 if by sysenter
+ * Function: int $0x80 leaves the user ss on top of the stack, sysenter the stub's return
+ *           eip, which is an address in the program region and never a selector */
+static uint32_t entered_by_int(const uint32_t* top) {
+    return top[-INT_FRAME_SS] == USER_DS;
+}
+
+/* int32_t fork(void)
+ * 
+ * Duplicates the calling process. The child gets a copy of the parent's open files,
+ * arguments and FPU registers, and shares its program pages copy-on-write, so only the
+ * page table is copied up front. The child records the parent's pid, but the parent does
+ * not wait for it, so it is reaped on halt like a background job
+ * 
+ * Inputs: None
+ * Return Value: the child's pid in the parent, 0 in the child, -1 if no pid or memory is free
+ * Function: creates a ready process that returns from fork with the parent's user registers
+ */
+int32_t fork(void) {
+    pcb_t* parent = (pcb_t*)current_pcb;
+    pcb_t* child;
+    int32_t process_id;
+    uint32_t* parent_top;
+    uint32_t* child_top;
+    sys_call_regs_t* regs;
+    sys_call_regs_t* child_regs;
+    uint32_t flags, cycles;
+    uint32_t start_tsc = rdtsc_low();
+
+    // kernel threads have no program to copy
+    if (parent == NULL || parent->user_page_table == 0) {
+        return -1;
+    }
+
+    cli_and_save(flags);
+    process_id = get_pid();
+    child = (process_id == -1) ? NULL : get_pcb_ptr(process_id);
+    if (child == NULL) {
+        if (process_id != -1) {
+            put_pid(process_id);
+        }
+        restore_flags(flags);
+        return -1;
+    }
+    child->in_use = 1;
+    restore_flags(flags);
+
+    child->process_id = process_id;
+    child->parent_process_id = parent->process_id;
+    child->terminal = parent->terminal;
+    child->respawn = 0;
+    // the parent does not wait for a forked child, which frees itself when it halts
+    child->detached = 1;
+    child->state = PROCESS_BLOCKED;
+    child->wait_next = NULL;
+    child->run_next = NULL;
+    child->child_exit_queue.head = NULL;
+    child->exit_status = 0;
+    child->thread_entry = NULL;
+    child->base_priority = parent->base_priority;
+    child->priority = child->base_priority;
+    child->ticks_used = 0;
+
+    if (fork_user_image(parent, child) != 0 || setup_page_directory(child) != 0) {
+        release_user_image(child);
+        put_pid(process_id);
+        return -1;
+    }
+    memcpy(child->fd_array, parent->fd_array, sizeof(parent->fd_array));
+    memcpy(child->arg, parent->arg, EXEC_ARG_LEN);
+    fpu_copy(parent, child);
+
+    /* the child leaves through fork_return, which irets like int $0x80 whichever way the
+       parent came in. A sysenter stub's esp is its ebp, with the return eip on top */
+    parent_top = (uint32_t*)get_kernel_stack_top(parent->process_id);
+    child_top = (uint32_t*)get_kernel_stack_top(process_id);
+    child_regs = (sys_call_regs_t*)(child_top - INT_FRAME_REGS);
+    if (entered_by_int(parent_top)) {
+        regs = (sys_call_regs_t*)(parent_top - INT_FRAME_REGS);
+        memcpy(child_top - INT_FRAME_EIP, parent_top - INT_FRAME_EIP, INT_FRAME_EIP * sizeof(uint32_t));
+    } else {
+        regs = (sys_call_regs_t*)(parent_top - SYSENTER_FRAME_REGS);
+        child_top[-INT_FRAME_SS] = USER_DS;
+        child_top[-INT_FRAME_ESP] = regs->ebp + sizeof(uint32_t);
+        child_top[-INT_FRAME_EFLAGS] = USER_EFLAGS;
+        child_top[-INT_FRAME_CS] = USER_CS;
+        child_top[-INT_FRAME_EIP] = parent_top[-SYSENTER_FRAME_EIP];
+    }
+    *child_regs = *regs;
+    child_regs->eflags = INITIAL_EFLAGS;
+
+    memset(&child->context, 0, sizeof(child->context));
+    child->context.esp = (uint32_t)child_regs;
+    child->context.eip = (uint32_t)fork_return;
+    child->context.eflags = INITIAL_EFLAGS;
+    child->context.esp0 = get_kernel_stack_top(process_id);
+    child->context.lock_depth = 1;
+    child->cpu = least_loaded_cpu();
+
+    cycles = rdtsc_low() - start_tsc;
+    child->startup_cycles = cycles;
+    fork_stats.forks++;
+    fork_stats.fork_cycles += cycles;
+    if (cycles > fork_stats.max_fork_cycles) {
+        fork_stats.max_fork_cycles = cycles;
+    }
+
+    cli_and_save(flags);
+    make_ready(child);
+    restore_flags(flags);
+
+    return process_id;
+}
+
+/* int32_t exec(const uint8_t* command)
+ * 
+ * Replaces the calling process's program in place: same pid, parent, terminal and open
+ * files, with a fresh image, arguments and FPU state. The system call returns into the new
+ * program's entry point with an empty stack
+ * 
+ * Inputs: command -- program name followed by its arguments
+ * Return Value: -1 if the command names no executable, the old program keeps running;
+ *               does not return to the caller otherwise
+ * Function: runs another program without taking a new pid
+ */
+int32_t exec(const uint8_t* command) {
+    pcb_t* pcb = (pcb_t*)current_pcb;
+    uint8_t arg[EXEC_ARG_LEN];
+    dentry_t file_dentry;
+    uint32_t entry_point;
+    uint32_t* top;
+    sys_call_regs_t* regs;
+    uint32_t start_tsc = rdtsc_low();
+
+    if (pcb == NULL || pcb->user_page_table == 0) {
+        return -1;
+    }
+    if (find_program(command, arg, &file_dentry, &entry_point) != 0) {
+        return -1;
+    }
+
+    record_user_image_stats(pcb);
+    release_user_image(pcb);
+    // reuses the page table the old image had, which cannot fail
+    load_user_image(pcb, file_dentry.inodeNumber);
+    memcpy(pcb->arg, arg, EXEC_ARG_LEN);
+
+    // the FPU may still hold the old program's registers, make the next use trap for a clean state
+    fpu_release(pcb);
+    fpu_switch(pcb);
+
+    /* return to the entry point on an empty stack. sysexit takes esp from the saved ebp
+       plus 4, so the new program starts with ebp just below its stack */
+    top = (uint32_t*)get_kernel_stack_top(pcb->process_id);
+    if (entered_by_int(top)) {
+        regs = (sys_call_regs_t*)(top - INT_FRAME_REGS);
+        top[-INT_FRAME_ESP] = USER_ESP;
+        top[-INT_FRAME_EFLAGS] = USER_EFLAGS;
+        top[-INT_FRAME_EIP] = entry_point;
+        regs->ebp = 0;
+    } else {
+        regs = (sys_call_regs_t*)(top - SYSENTER_FRAME_REGS);
+        top[-SYSENTER_FRAME_EIP] = entry_point;
+        regs->ebp = USER_ESP - sizeof(uint32_t);
+    }
+    regs->esi = 0;
+    regs->edi = 0;
+
+    pcb->startup_cycles = rdtsc_low() - start_tsc;
+    fork_stats.execs++;
+    return 0;
+}
+
 /* void init_current_pcb()
  * Inputs:      None
  * Return Value: Void
@@ -595,21 +1002,25 @@ void init_current_pcb()
     int i;
     for (i = 0; i < FD_ARRAY_LENGTH; i++)
     {
-        fd_element_t empty = {.file_op_table_ptr = 0, .file_position = 0, .flags = 0, .inode_num = 0};
+        fd_element_t empty = {.file_op_table_ptr = 0, .file_position = 0, .flags = 0, .inode_num = 0, .file_type = 0};
         current_pcb->fd_array[i] = empty;
     }
     current_pcb->process_id = 0;
     current_pcb->parent_process_id = 0;
 
     // mark first 2 FDs as in use
+    current_pcb->fd_array[0].file_op_table_ptr = &terminal_op_table;
+    current_pcb->fd_array[0].file_type = TERMINAL_FILE_TYPE;
     current_pcb->fd_array[0].flags = 1;
+    current_pcb->fd_array[1].file_op_table_ptr = &terminal_op_table;
+    current_pcb->fd_array[1].file_type = TERMINAL_FILE_TYPE;
     current_pcb->fd_array[1].flags = 1;
 }
 
 /* void flush_tlb()
  * Inputs:      None
  * Return Value: Void
- * Function: Flushes TLB */
+ * Function: Flushes every non-global TLB entry */
 void flush_tlb()
 {
     asm volatile(
@@ -618,35 +1029,117 @@ void flush_tlb()
         :
         :
         : "%eax");
+    tlb_stats.full_flushes++;
+}
+
+/* void flush_tlb_page(uint32_t addr)
+ * Inputs:      addr -- virtual address inside the remapped page
+ * Return Value: Void
+ * Function: Flushes the TLB entry for one page, global or not */
+void flush_tlb_page(uint32_t addr)
+{
+    asm volatile(
+        "invlpg (%0);"
+        :
+        : "r"(addr)
+        : "memory");
+    tlb_stats.page_flushes++;
 }
 
 /* pcb_t* get_pcb_ptr(int32_t pid)
  * Inputs:      pid -- process ID of the requested PCB
- * Return Value: pointer to the PCB
- * Function: calculates offset and gets pointer to PCB */
+ * Return Value: pointer to the PCB, NULL if its kernel stack could not be allocated
+ * Function: the first time a pid is used, takes an 8KB-aligned kernel stack from the frame
+ *           allocator and clears it, the PCB sits at the bottom of that stack */
 pcb_t* get_pcb_ptr(int32_t pid) {
-    return (pcb_t*)(EIGHT_MB - (EIGHT_KB * (pid + 1)));
+    uint32_t stack;
+
+    if (pcb_table[pid] == NULL) {
+        if ((stack = alloc_frames(KERNEL_STACK_FRAMES)) == 0) {
+            return NULL;
+        }
+        memset((void*)stack, 0, EIGHT_KB);
+        // release_user_image puts it back to this whenever a process lets go of its image
+        ((pcb_t*)stack)->image_cache_slot = NO_IMAGE_SLOT;
+        pcb_table[pid] = (pcb_t*)stack;
+    }
+    return pcb_table[pid];
 }
 
 /* int32_t get_pid()
  * Inputs:      None
- * Return Value: next available process_id, if none available then -1
- * Function: checks PCBs to see what process IDs are in use */
+ * Return Value: a free process_id below max_pids, if none available then -1
+ * Function: pops the most recently freed pid, or takes the next pid never handed out,
+ *           either way without looking at any PCB */
 int32_t get_pid() {
-    int i;
-    for (i = 0; i < NUM_PIDS; i++) {
-        if (get_pcb_ptr(i)->in_use != 1) {
-            return i;
+    int32_t pid;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    spin_lock(&pid_lock);
+    if (free_pid_head != NO_FREE_PID) {
+        pid = free_pid_head;
+        free_pid_head = pid_next_free[pid];
+    } else if (unused_pid_start < (int32_t)max_pids) {
+        pid = unused_pid_start++;
+    } else {
+        pid_stats.exhausted++;
+        spin_unlock(&pid_lock);
+        restore_flags(flags);
+        return -1;
+    }
+    if (++pid_stats.live > pid_stats.peak) {
+        pid_stats.peak = pid_stats.live;
+    }
+    spin_unlock(&pid_lock);
+    restore_flags(flags);
+
+    return pid;
+}
+
+/* void put_pid(int32_t pid)
+ * Inputs:      pid -- process ID from get_pid that is no longer needed
+ * Return Value: None
+ * Function: marks the PCB unused and pushes the pid on the free list, its kernel stack
+ *           stays allocated for the next process that gets the pid */
+void put_pid(int32_t pid) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    spin_lock(&pid_lock);
+    if (pcb_table[pid] != NULL) {
+        pcb_table[pid]->in_use = 0;
+    }
+    pid_next_free[pid] = free_pid_head;
+    free_pid_head = pid;
+    pid_stats.live--;
+    spin_unlock(&pid_lock);
+    restore_flags(flags);
+}
+
+/* void init_pids(const int8_t* cmdline)
+ * Inputs:      cmdline -- multiboot command line, NULL if the bootloader gave none
+ * Return Value: None
+ * Function: sets max_pids from max_pids=<n>, clamped to MIN_PIDS..NUM_PIDS, runs before
+ *           the first get_pid */
+void init_pids(const int8_t* cmdline) {
+    uint32_t limit;
+
+    max_pids = DEFAULT_MAX_PIDS;
+    if (cmdline_number(cmdline, (int8_t*)MAX_PIDS_OPTION, &limit) == 0) {
+        if (limit < MIN_PIDS) {
+            limit = MIN_PIDS;
+        } else if (limit > NUM_PIDS) {
+            limit = NUM_PIDS;
         }
+        max_pids = limit;
     }
-    
-    return -1;
 }
 
-/* uint32_t get_phys_addr(int32_t pid)
+/* uint32_t get_kernel_stack_top(int32_t pid)
  * Inputs:      pid -- process ID
- * Return Value: 20 MSB of the physical address of the program
- * Function: calculates offset and gets address to physical program memory */
-uint32_t get_phys_addr(int32_t pid) {
-    return (uint32_t)((EIGHT_MB + (FOUR_MB * pid)) >> PAGING_OFFSET);
+ * Return Value: initial kernel stack pointer for the process, loaded into tss.esp0
+ * Function: finds the top of the 8KB kernel stack holding the process's PCB */
+uint32_t get_kernel_stack_top(int32_t pid) {
+    return (uint32_t)get_pcb_ptr(pid) + EIGHT_KB - sizeof(int);
 }
@@ -1,4 +1,9 @@
+#ifndef _SYSTEM_CALLS_H
+#define _SYSTEM_CALLS_H
+
 #include "types.h"
+#include "switch.h"
+#include "smp.h"
 
 #define FD_ARRAY_LENGTH             8
 #define RTC_FILE_TYPE               0
@@ -6,57 +11,126 @@
 #define ARGS_SIZE                   32
 #define EXEC_ARG_LEN                128
 #define USER_SPACE_DIR_NUM 32
+/* upper bound on pids, the limit in force is max_pids, picked with max_pids=<n> on the command line.
+   How many can run at once also depends on free frames for kernel stacks and pages */
+#define NUM_PIDS                    512
+#define DEFAULT_MAX_PIDS            64
+/* three base shells plus a few programs chained off one of them */
+#define MIN_PIDS                    8
+/* end of the pid free list */
+#define NO_FREE_PID                 -1
 
 
-typedef struct term_table_t {
-    int32_t (*open)(const uint8_t* filename);
-    int32_t (*read)(int32_t fd, void* buf, int32_t nbytes);
-    int32_t (*write)(int32_t fd, const void* buf, int32_t nbytes);
-    int32_t (*close)(int32_t fd);
-} term_table_t;
+/* FXSAVE/FXRSTOR image of the x87, MMX and SSE registers */
+#define FXSAVE_AREA_SIZE            512
+#define FXSAVE_ALIGN                16
 
-typedef struct file_table_t {
-    int32_t (*open)(const uint8_t* filename);
-    int32_t (*read)(uint32_t inode_idx, int32_t file_index, void* buf, int32_t num_bytes);
-    int32_t (*write)(int32_t file_index, const void* buf, int32_t num_bytes);
-    int32_t (*close)(int32_t fd);
-} file_table_t;
+/* file types recorded in each fd entry, the first three match the dentry fileType values */
+#define REGULAR_FILE_TYPE           2
+#define TERMINAL_FILE_TYPE          3
+#define NUM_DENTRY_FILE_TYPES       3
 
-typedef struct rtc_table_t {
-    int32_t (*open)(const uint8_t* filename);
-    int32_t (*read)(int32_t fd, void* buf, int32_t nbytes);
-    int32_t (*write)(int32_t fd, const void* buf, int32_t nbytes);
-    int32_t (*close)(int32_t fd);
-} rtc_table_t;
+/* scheduling state of a process, only ready processes sit on the run queue */
+#define PROCESS_READY               0
+#define PROCESS_RUNNING             1
+#define PROCESS_BLOCKED             2
+#define PROCESS_ZOMBIE              3
+
+/* parent_process_id of base shells, background jobs and kernel threads */
+#define NO_PARENT                   -1
 
-typedef struct dir_table_t {
+/* operations every open file supports, all drivers share one fd-based signature */
+typedef struct file_op_table_t {
     int32_t (*open)(const uint8_t* filename);
-    int32_t (*read)(int32_t file_index, void* buf, int32_t nbytes);
+    int32_t (*read)(int32_t fd, void* buf, int32_t nbytes);
     int32_t (*write)(int32_t fd, const void* buf, int32_t nbytes);
     int32_t (*close)(int32_t fd);
-} dir_table_t;
+} file_op_table_t;
 
 typedef struct fd_element_t
 {
-    int32_t * file_op_table_ptr;
+    file_op_table_t* file_op_table_ptr;
     uint32_t inode_num;
     uint32_t file_position;
     uint32_t flags;
+    uint32_t file_type;
+    uint32_t rtc_divisor;       // RTC files: hardware ticks per virtual tick, 0 until first used
 } fd_element_t;
 
+struct pcb_t;
+
+/* processes blocked on one event, woken all at once */
+typedef struct wait_queue_t {
+    struct pcb_t* head;
+} wait_queue_t;
+
 typedef struct pcb_t {
     fd_element_t fd_array[FD_ARRAY_LENGTH];
     int32_t process_id;
     int32_t parent_process_id;
-    uint32_t esp_val;
-    uint32_t ebp_val;
     uint32_t in_use;
     uint8_t arg[EXEC_ARG_LEN];
-    uint32_t scheduling_esp_val;
-    uint32_t scheduling_ebp_val;
+    switch_context_t context;   // kernel registers saved by switch_to while switched out
+    uint32_t image_inode;       // file backing the demand-paged program image
+    uint32_t image_size;        // bytes of the image that come from the file
+    uint32_t pages_touched;     // image pages faulted in since execute
+    uint32_t private_pages;     // image pages backed by the process's own frames
+    int32_t image_cache_slot;   // shared image cache entry, NO_IMAGE_SLOT if uncached
+    uint32_t startup_cycles;    // cycles execute spent setting the process up
+    uint32_t user_page_table;   // frame holding the program region's page table, 0 until first execute
+    uint32_t page_directory;    // frame holding the process's page directory, 0 until first execute
+    uint32_t kdata_table;       // frame holding the page table of the kernel data pages, 0 until first execute
+    uint32_t process_data;      // frame holding the process's own read-only data page, 0 until first execute
+    uint32_t terminal;          // terminal the process's video memory belongs to
+    uint32_t state;             // PROCESS_READY, RUNNING, BLOCKED or ZOMBIE
+    uint32_t cpu;               // processor whose run queue the process goes on, where it last ran
+    struct pcb_t* wait_next;    // next process on the same wait queue
+    struct pcb_t* run_next;     // next process on the run queue
+    wait_queue_t child_exit_queue;  // a foreground parent sleeps here until its child is a zombie
+    uint32_t exit_status;       // halt status, read by the parent when it reaps the zombie
+    uint32_t respawn;           // base shell, restarted on its terminal when it halts
+    uint32_t detached;          // nobody waits for it, reap_orphans frees it when it halts
+    void (*thread_entry)(void); // kernel threads run this instead of a user program
+    uint32_t priority;          // run queue level, 0 is the highest
+    uint32_t base_priority;     // level set by nice, restored at every priority reset
+    uint32_t ticks_used;        // ticks run at the current level
+    uint32_t priority_epoch;    // priority reset the level was last checked against
+    uint32_t fpu_used;          // fpu_state holds the process's registers, set on its first FPU instruction
+    uint8_t fpu_state[FXSAVE_AREA_SIZE] __attribute__((aligned (FXSAVE_ALIGN)));  // saved lazily by handle_fpu_trap
 } pcb_t;
 
-volatile pcb_t* current_pcb;
+/* process running on the calling processor, NULL while it idles */
+#define current_pcb                 (this_cpu()->current)
+
+/* system call traffic since boot, calls counts both entry paths */
+typedef struct sys_call_stats_t {
+    uint32_t calls;             // must stay first, the entry code counts it
+    uint32_t io_bytes;          // bytes moved by successful reads and writes
+} sys_call_stats_t;
+
+sys_call_stats_t sys_call_stats;
+
+/* process creation by fork and exec */
+typedef struct fork_stats_t {
+    uint32_t forks;             // children created by fork
+    uint32_t fork_cycles;       // cycles spent in all of those forks
+    uint32_t max_fork_cycles;   // slowest fork
+    uint32_t execs;             // programs replaced in place by exec
+} fork_stats_t;
+
+fork_stats_t fork_stats;
+
+/* pid allocator activity */
+typedef struct pid_stats_t {
+    uint32_t live;              // pids handed out and not yet put back
+    uint32_t peak;              // most pids live at once
+    uint32_t exhausted;         // get_pid calls that found every pid below max_pids taken
+} pid_stats_t;
+
+pid_stats_t pid_stats;
+
+// pids below this are handed out, from DEFAULT_MAX_PIDS or max_pids=<n>, at most NUM_PIDS
+uint32_t max_pids;
 
 int32_t halt (uint8_t status);
 int32_t execute (const uint8_t* command);
@@ -68,8 +142,20 @@ int32_t getargs (uint8_t* buf, int32_t nbytes);
 int32_t vidmap (uint8_t** screen_start);
 int32_t set_handler (int32_t signum, void* handler_address);
 int32_t sigreturn (void);
+int32_t nice (int32_t increment);
+int32_t sleep (int32_t ms);
+int32_t fork (void);
+int32_t exec (const uint8_t* command);
 void init_current_pcb();
 void flush_tlb();
+void flush_tlb_page(uint32_t addr);
 pcb_t* get_pcb_ptr(int32_t pid);
 int32_t get_pid();
-uint32_t get_phys_addr(int32_t pid);
+void put_pid(int32_t pid);
+void init_pids(const int8_t* cmdline);
+uint32_t get_kernel_stack_top(int32_t pid);
+int32_t start_terminal_shell(uint32_t terminal);
+void reap_orphans();
+int32_t create_kernel_thread(void (*entry)(void), uint32_t terminal);
+
+#endif /* _SYSTEM_CALLS_H */
@@ -11,6 +11,18 @@
 #include "system_calls.h"
 #include "devices/pit.h"
 #include "scheduler.h"
+#include "loader.h"
+#include "frame_alloc.h"
+#include "wait_queue.h"
+#include "fpu.h"
+#include "smp.h"
+#include "lapic.h"
+#include "softirq.h"
+#include "timer.h"
+#include "sysenter.h"
+#include "sys_call_asm_linkage.h"
+#include "io_ring.h"
+#include "kdata.h"
 
 #define PASS 1
 #define FAIL 0
@@ -26,6 +38,27 @@
 #define COUNTER_DIVISOR         10
 #define BYTES_4KB               4096
 #define MAX_FILENAME_SIZE       32
+#define BENCH_ITERATIONS        16
+#define BENCH_BUF_SIZE          0x10000
+#define BENCH_CAT_CHUNK         1024
+#define BENCH_NUM_CHUNKS        2
+#define THROUGHPUT_MAX_WORKERS  4
+#define THROUGHPUT_WORK         20000000
+#define SWITCH_BENCH_ROUNDS     10000
+#define SWITCH_BENCH_THREADS    2
+#define FPU_TEST_ROUNDS         100
+#define TIMER_TEST_COUNT        2048
+#define TIMER_TEST_SPREAD       16
+#define TIMER_TEST_SLEEP_MS     1000
+#define TIMER_TEST_ONESHOT_TICKS 4
+#define RTC_TEST_FREQUENCY      8
+#define RTC_TEST_LATE_TICKS     4
+#define IO_RING_BENCH_PROGRAMS  2
+#define KDATA_TEST_SECONDS      1
+/* ticks the detached children of forkbench get to finish */
+#define FORK_BENCH_SETTLE_TICKS 20
+/* the clock may be off from the tick count by this many parts in 100 */
+#define KDATA_CLOCK_TOLERANCE   10
 
 /* format these macros as you see fit */
 #define TEST_HEADER 	\
@@ -833,13 +866,53 @@ int32_t test_dentry_search(){
 	}
 }
 
+/* Test Dentry Hash Index
+ *
+ * looks up every directory entry by name through the hash index, plus a few
+ * names that must miss, then prints the lookup counters
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: init_filesystem, read_dentry_by_name
+ * Files: filesystem.c
+ */
+int32_t test_dentry_hash_lookup(){
+	TEST_HEADER;
+
+	dentry_t by_index;
+	dentry_t by_name;
+	uint8_t name[MAX_FILENAME_SIZE + 1];
+	uint32_t i, j;
+
+	for (i = 0; i < bootblock->numDentries; i++) {
+		read_dentry_by_index(i, &by_index);
+
+		// copy the name so 32-character entries get a terminator
+		for (j = 0; j < MAX_FILENAME_SIZE; j++) {
+			name[j] = by_index.fileName[j];
+		}
+		name[MAX_FILENAME_SIZE] = '\0';
+
+		if (read_dentry_by_name(name, &by_name) == -1) {return FAIL;}
+		if (by_name.inodeNumber != by_index.inodeNumber) {return FAIL;}
+	}
+
+	// prefix, mistyped and over-long names must all miss
+	if (read_dentry_by_name((uint8_t*)"shel", &by_name) != -1) {return FAIL;}
+	if (read_dentry_by_name((uint8_t*)"shelll", &by_name) != -1) {return FAIL;}
+	if (read_dentry_by_name((uint8_t*)"verylargetextwithverylongname.txt", &by_name) != -1) {return FAIL;}
+
+	printf("dentry lookups: %u hits, %u misses, %u probes\n", dentry_lookup_stats.hits, dentry_lookup_stats.misses, dentry_lookup_stats.probes);
+	return PASS;
+}
+
 /* Test Read file
  *
  * reads specified file name and prints file to console
  * Inputs: string filename
  * Outputs: PASS/FAIL
  * Side Effects: None
- * Coverage: file_open, file_read, read_dentry_by_name
+ * Coverage: file_open, read_data, read_dentry_by_name
  * Files: filesystem.c
  */
 int test_file_read(char* filename) {
@@ -862,7 +935,7 @@ int test_file_read(char* filename) {
 	char buff[file_length];																	// size of one block
 
     // 187 is file size according to inodes[test_inode_num].length
-	int32_t num_bytes_copied = file_read(test_dentry.inodeNumber, offset, (uint8_t*)buff, file_length - offset);
+	int32_t num_bytes_copied = read_data(test_dentry.inodeNumber, offset, (uint8_t*)buff, file_length - offset);
 
 	// print file
 	if(num_bytes_copied == -1){return FAIL;}
@@ -883,7 +956,7 @@ int test_file_read(char* filename) {
  *         nbytes - length of data to be read
  * Outputs: PASS/FAIL
  * Side Effects: None
- * Coverage: file_open, file_read, read_dentry_by_name
+ * Coverage: file_open, read_data, read_dentry_by_name
  * Files: filesystem.c
  */
 int test_buffer_file_read(char* filename, uint8_t* buf, uint32_t nbytes) {
@@ -901,7 +974,7 @@ int test_buffer_file_read(char* filename, uint8_t* buf, uint32_t nbytes) {
 	uint32_t inode_index = test_dentry.inodeNumber;
 
     // 187 is file size according to inodes[test_inode_num].length
-	int32_t num_bytes_copied = file_read(inode_index, 0, buf, nbytes);
+	int32_t num_bytes_copied = read_data(inode_index, 0, buf, nbytes);
 
 	// print file
 	if(num_bytes_copied == -1) {
@@ -955,7 +1028,7 @@ int test_file_write(char* filename) {
  * Inputs: None
  * Outputs: PASS/FAIL
  * Side Effects: None
- * Coverage: directory_read, read_dentry_by_index
+ * Coverage: read_dentry_name, read_dentry_by_index
  * Files: filesystem.c
  */
 int test_read_directory(){
@@ -964,7 +1037,7 @@ int test_read_directory(){
 	TEST_HEADER;
 	char buf[33];
 	uint32_t i = 0;
-	while(directory_read(i, buf, MAX_FILENAME_SIZE) != 0) {
+	while(read_dentry_name(i, buf, MAX_FILENAME_SIZE) != 0) {
         dentry_t dentry_val;
         read_dentry_by_index(i, &dentry_val);
         printf("File Name: ");
@@ -1128,7 +1201,7 @@ int test_syscall_execute(char* filename){
  */
 int pit_test() {
     
-    init_pit();
+    init_pit(NULL);
 
     // allow pit for a couple of seconds
     int counter = 0;
@@ -1143,6 +1216,1106 @@ int pit_test() {
     return PASS;
 }
 
+/* Frame Allocator Test
+ *
+ * Allocates a 4KB frame, an 8KB kernel stack and a 4MB block, checks their
+ * alignment and that freeing them restores the free frame count
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: alloc_frames, free_frames, free_frame_count
+ * Files: frame_alloc.c
+ */
+int frame_alloc_test() {
+    TEST_HEADER;
+
+    uint32_t free_before = free_frame_count();
+    uint32_t frame = alloc_frames(1);
+    uint32_t stack = alloc_frames(KERNEL_STACK_FRAMES);
+    uint32_t block = alloc_frames(FRAMES_PER_4MB);
+    int result = PASS;
+
+    if (frame == 0 || stack == 0 || block == 0) {
+        result = FAIL;
+    }
+    if ((frame & (FRAME_SIZE - 1)) || (stack & (KERNEL_STACK_FRAMES * FRAME_SIZE - 1)) ||
+        (block & (FRAMES_PER_4MB * FRAME_SIZE - 1))) {
+        result = FAIL;
+    }
+    if (frame < FRAME_ALLOC_START || block + FRAMES_PER_4MB * FRAME_SIZE > DIRECT_MAP_END) {
+        result = FAIL;
+    }
+
+    if (frame != 0) {
+        free_frames(frame, 1);
+    }
+    if (stack != 0) {
+        free_frames(stack, KERNEL_STACK_FRAMES);
+    }
+    if (block != 0) {
+        free_frames(block, FRAMES_PER_4MB);
+    }
+    if (free_frame_count() != free_before) {
+        result = FAIL;
+    }
+    printf("%u of %u frames free\n", free_frame_count(), total_frame_count());
+    return result;
+}
+
+
+/* Benchmarks */
+
+/* int32_t read_data_bytewise(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length)
+ * Inputs:      same as read_data
+ * Return Value: number of bytes copied, 0 at EOF, -1 on failure
+ * Function: the original one-byte-per-iteration read_data, kept only as the benchmark baseline */
+static int32_t read_data_bytewise(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length) {
+    uint32_t current_byte_index;
+    uint32_t num_bytes_copied = 0;
+
+    if (inode >= bootblock->numInodes) {
+        return -1;
+    }
+    if (offset >= inode_start[inode].numBytes) {
+        return 0;
+    }
+    for (current_byte_index = offset; current_byte_index < (offset + length); current_byte_index++) {
+        if (current_byte_index == inode_start[inode].numBytes) {
+            break;
+        }
+        buf[num_bytes_copied] = datablock_start[inode_start[inode].dataBlockNumber[current_byte_index / BYTES_4KB]].dataBlockValue[current_byte_index % BYTES_4KB];
+        num_bytes_copied++;
+    }
+    return num_bytes_copied;
+}
+
+/* uint32_t time_file_reads(read_fn_t read_fn, uint32_t inode, uint8_t* buf, uint32_t chunk)
+ * Inputs:      read_fn -- read_data implementation to time
+ *              inode -- file to read
+ *              buf -- destination buffer, at least chunk bytes long
+ *              chunk -- bytes requested per call
+ * Return Value: cycles spent reading the whole file BENCH_ITERATIONS times
+ * Function: reads a file front to back in chunk sized pieces, the way cat and execute do */
+typedef int32_t (*read_fn_t)(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
+
+static uint32_t time_file_reads(read_fn_t read_fn, uint32_t inode, uint8_t* buf, uint32_t chunk) {
+    uint32_t start, i, offset;
+    int32_t ret;
+
+    start = rdtsc_low();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        offset = 0;
+        while ((ret = (*read_fn)(inode, offset, buf, chunk)) > 0) {
+            offset += ret;
+        }
+    }
+    return rdtsc_low() - start;
+}
+
+static uint8_t bench_buf_old[BENCH_BUF_SIZE];
+static uint8_t bench_buf_new[BENCH_BUF_SIZE];
+
+/* read_data Throughput Benchmark
+ *
+ * Reads every regular file in the filesystem image with the old byte loop and the
+ * block-span read_data, once in cat-sized chunks and once whole-file like execute
+ * Inputs: None
+ * Outputs: PASS/FAIL (FAIL if the two implementations return different bytes)
+ * Side Effects: Prints cycles per file and the overall speedup
+ * Coverage: read_data
+ * Files: filesystem.c
+ */
+int read_data_benchmark() {
+    TEST_HEADER;
+
+    uint32_t i, inode, length;
+    uint32_t old_cycles, new_cycles;
+    uint32_t total_old = 0;
+    uint32_t total_new = 0;
+    uint32_t chunks[BENCH_NUM_CHUNKS] = {BENCH_CAT_CHUNK, BENCH_BUF_SIZE};
+    uint32_t c;
+    dentry_t dentry;
+
+    for (i = 0; i < bootblock->numDentries; i++) {
+        read_dentry_by_index(i, &dentry);
+        if (dentry.fileType != REGULAR_FILE_TYPE) {
+            continue;
+        }
+        inode = dentry.inodeNumber;
+        length = inode_start[inode].numBytes;
+        if (length > BENCH_BUF_SIZE) {
+            length = BENCH_BUF_SIZE;
+        }
+
+        // both implementations have to agree before their timings mean anything
+        if (read_data_bytewise(inode, 0, bench_buf_old, length) != read_data(inode, 0, bench_buf_new, length)) {
+            return FAIL;
+        }
+        for (c = 0; c < length; c++) {
+            if (bench_buf_old[c] != bench_buf_new[c]) {
+                return FAIL;
+            }
+        }
+
+        for (c = 0; c < BENCH_NUM_CHUNKS; c++) {
+            old_cycles = time_file_reads(read_data_bytewise, inode, bench_buf_old, chunks[c]);
+            new_cycles = time_file_reads(read_data, inode, bench_buf_new, chunks[c]);
+            total_old += old_cycles;
+            total_new += new_cycles;
+            printf("%s chunk %u: old %u cycles, new %u cycles\n", (int8_t*)dentry.fileName, chunks[c], old_cycles, new_cycles);
+        }
+    }
+
+    if (total_new == 0) {
+        return FAIL;
+    }
+    printf("read_data speedup: %u.%ux\n", total_old / total_new, ((total_old % total_new) * 10) / total_new);
+    return PASS;
+}
+
+/* Program Loader Report
+ *
+ * Prints pages touched, private pages and startup cycles for the last run of every program that has
+ * been executed, as recorded by the demand-paged loader when each process halts
+ * Inputs: None
+ * Outputs: PASS
+ * Side Effects: Prints one line per program
+ * Coverage: load_user_image, handle_user_page_fault, record_user_image_stats, image cache
+ * Files: loader.c
+ */
+int loader_stats_report() {
+    TEST_HEADER;
+
+    uint32_t i, inode;
+    dentry_t dentry;
+
+    for (i = 0; i < bootblock->numDentries; i++) {
+        read_dentry_by_index(i, &dentry);
+        inode = dentry.inodeNumber;
+        if (inode >= LOADER_STATS_SIZE || loader_stats[inode].runs == 0) {
+            continue;
+        }
+        printf("%s: %u runs, %u of %u pages touched, %u private, startup %u cycles\n", (int8_t*)dentry.fileName,
+               loader_stats[inode].runs, loader_stats[inode].pages_touched,
+               (inode_start[inode].numBytes + BYTES_4KB - 1) / BYTES_4KB, loader_stats[inode].private_pages,
+               loader_stats[inode].startup_cycles);
+    }
+    printf("image cache: %u hits, %u loads, %u copy-on-write, %u evictions\n", image_cache_stats.page_hits,
+           image_cache_stats.page_loads, image_cache_stats.cow_copies, image_cache_stats.evictions);
+    return PASS;
+}
+
+/* TLB Flush Report
+ *
+ * Prints full (CR3) and single page (invlpg) TLB flushes over the last second
+ * and in total, sampled by the PIT handler
+ * Inputs: None
+ * Outputs: PASS
+ * Side Effects: Prints the counters
+ * Coverage: flush_tlb, flush_tlb_page, switch_page_directory, sample_tlb_flush_rate
+ * Files: paging.c, system_calls.c
+ */
+int tlb_flush_report() {
+    TEST_HEADER;
+
+    printf("%u full flushes/s, %u page flushes/s (%u full, %u page total)\n",
+           tlb_stats.full_flushes_per_sec, tlb_stats.page_flushes_per_sec,
+           tlb_stats.full_flushes, tlb_stats.page_flushes);
+    return PASS;
+}
+
+/* Idle Report
+ *
+ * Prints how much of the last second the CPU spent halted in the idle context
+ * Inputs: None
+ * Outputs: PASS
+ * Side Effects: Prints the counters
+ * Coverage: idle_loop, account_ticks
+ * Files: scheduler.c
+ */
+int idle_report() {
+    TEST_HEADER;
+
+    printf("idle %u%% of the last second (%u cycles halted), entered idle %u times, %u of %u ticks idle\n",
+           idle_stats.idle_percent, idle_stats.idle_cycles_per_sec, idle_stats.entries,
+           idle_stats.idle_ticks, idle_stats.total_ticks);
+    return PASS;
+}
+
+/* Timer Report
+ *
+ * Prints the tick rate and how many PIT interrupts the last second took, which drops
+ * well below the rate when the system idles in one-shot mode
+ * Inputs: None
+ * Outputs: PASS
+ * Side Effects: Prints the counters
+ * Coverage: pit_handler, pit_enter_tickless, pit_exit_tickless
+ * Files: pit.c
+ */
+int timer_report() {
+    TEST_HEADER;
+
+    printf("%u Hz tick, %u interrupts in the last second, %u one-shots, %u interrupts total\n",
+           pit_hz, pit_stats.interrupts_per_sec, pit_stats.oneshots, pit_stats.interrupts);
+    return PASS;
+}
+
+/* IRQ Latency Report
+ *
+ * Prints, for every line that has interrupted, the cycles its top half kept interrupts off
+ * next to the cycles of the work it deferred and how long that work waited. The top half
+ * average should be a small fraction of the bottom half's
+ * Inputs: None
+ * Outputs: PASS
+ * Side Effects: Prints the counters
+ * Coverage: irq_exit, raise_softirq, keyboard_handler, rtc_handler
+ * Files: softirq.c, keyboard.c, rtc.c
+ */
+int irq_latency_report() {
+    TEST_HEADER;
+
+    irq_stats_t* stats;
+    uint32_t irq;
+
+    for (irq = 0; irq < IRQ_LINES; irq++) {
+        stats = &irq_stats[irq];
+        if (stats->count == 0) {
+            continue;
+        }
+        printf("irq %u: %u top halves avg %u max %u cycles, %u bottom halves avg %u max %u cycles, waited up to %u\n",
+               irq, stats->count, stats->top_cycles / stats->count, stats->max_top_cycles,
+               stats->bottom_runs, stats->bottom_runs ? stats->bottom_cycles / stats->bottom_runs : 0,
+               stats->max_bottom_cycles, stats->max_delay_cycles);
+    }
+    return PASS;
+}
+
+/* pcb_t* adopt_boot_context()
+ * Inputs:      None
+ * Return Value: pcb the boot context now runs as, NULL if no pid or frame is free
+ * Function: turns the code running launch_tests into a process so it can sleep and be
+ *           preempted like one, undone by release_boot_context */
+static pcb_t* adopt_boot_context() {
+    int32_t pid = get_pid();
+    pcb_t* pcb;
+
+    if (pid == -1) {
+        return NULL;
+    }
+    if ((pcb = get_pcb_ptr(pid)) == NULL) {
+        put_pid(pid);
+        return NULL;
+    }
+    pcb->in_use = 1;
+    pcb->process_id = pid;
+    pcb->parent_process_id = NO_PARENT;
+    pcb->terminal = TERMINAL_1;
+    pcb->wait_next = NULL;
+    pcb->run_next = NULL;
+    pcb->base_priority = TOP_PRIORITY;
+    pcb->priority = TOP_PRIORITY;
+    pcb->ticks_used = 0;
+    pcb->context.esp0 = get_kernel_stack_top(pid);
+    if (setup_page_directory(pcb) != 0) {
+        put_pid(pid);
+        return NULL;
+    }
+
+    cli();
+    pcb->cpu = this_cpu()->id;
+    pcb->state = PROCESS_RUNNING;
+    current_pcb = pcb;
+    sti();
+    return pcb;
+}
+
+/* void release_boot_context(pcb_t* pcb)
+ * Inputs:      pcb -- returned by adopt_boot_context
+ * Return Value: None
+ * Function: stops scheduling the boot context and frees its pid, nothing else may be ready */
+static void release_boot_context(pcb_t* pcb) {
+    cli();
+    current_pcb = NULL;
+    fpu_release(pcb);
+    put_pid(pcb->process_id);
+    sti();
+}
+
+/* Nice Test
+ *
+ * Checks that nice moves the base priority by the increment and clamps it to the valid levels
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: The boot context briefly runs as a process
+ * Coverage: nice
+ * Files: system_calls.c
+ */
+int nice_test() {
+    TEST_HEADER;
+
+    pcb_t* self = adopt_boot_context();
+    int result = PASS;
+
+    if (self == NULL) {
+        return FAIL;
+    }
+    if (nice(1) != TOP_PRIORITY + 1 || self->priority != TOP_PRIORITY + 1) {
+        result = FAIL;
+    }
+    if (nice(NUM_PRIORITY_LEVELS) != LOWEST_PRIORITY) {
+        result = FAIL;
+    }
+    if (nice(-NUM_PRIORITY_LEVELS) != TOP_PRIORITY || self->base_priority != TOP_PRIORITY) {
+        result = FAIL;
+    }
+
+    release_boot_context(self);
+    return result;
+}
+
+static volatile uint32_t workers_done;
+static volatile uint32_t first_done_tick;
+static wait_queue_t workers_done_queue;
+
+/* void cpu_bound_worker()
+ * Inputs:      None
+ * Return Value: None
+ * Function: spins through a fixed amount of work, then reports that it finished */
+static void cpu_bound_worker() {
+    volatile uint32_t i;
+
+    for (i = 0; i < THROUGHPUT_WORK; i++);
+
+    // threads run without the big kernel lock and may finish on several processors at once
+    lock_kernel();
+    if (workers_done++ == 0) {
+        first_done_tick = idle_stats.total_ticks;
+    }
+    wake_up(&workers_done_queue);
+    unlock_kernel();
+}
+
+static volatile uint32_t fpu_test_errors;
+
+/* void fpu_worker()
+ * Inputs:      None
+ * Return Value: None
+ * Function: keeps a value unique to the thread in xmm0 across yields and counts every
+ *           round where another thread's value shows up instead */
+static void fpu_worker() {
+    uint32_t mine = current_pcb->process_id + 1;
+    uint32_t seen;
+    uint32_t i;
+
+    asm volatile("movd %0, %%xmm0" : : "r"(mine));
+    for (i = 0; i < FPU_TEST_ROUNDS; i++) {
+        yield();
+        asm volatile("movd %%xmm0, %0" : "=r"(seen));
+        if (seen != mine) {
+            fpu_test_errors++;
+        }
+    }
+
+    lock_kernel();
+    workers_done++;
+    wake_up(&workers_done_queue);
+    unlock_kernel();
+}
+
+/* FPU Switch Test
+ *
+ * Two kernel threads keep different values in an SSE register while yielding to each
+ * other, the lazy FPU switch has to save and restore it at each handover
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: The boot context briefly runs as a process
+ * Coverage: init_fpu, fpu_switch, handle_fpu_trap, fpu_release
+ * Files: fpu.c, interrupts.c, intr_asm_linkage.S
+ */
+int fpu_switch_test() {
+    TEST_HEADER;
+
+    pcb_t* self;
+    uint32_t started, restores;
+    int result = PASS;
+
+    self = adopt_boot_context();
+    if (self == NULL) {
+        return FAIL;
+    }
+
+    cli();
+    workers_done = 0;
+    fpu_test_errors = 0;
+    restores = fpu_stats.restores;
+    for (started = 0; started < SWITCH_BENCH_THREADS; started++) {
+        if (create_kernel_thread(fpu_worker, TERMINAL_1) == -1) {
+            result = FAIL;
+            break;
+        }
+    }
+    while (workers_done < started) {
+        sleep_on(&workers_done_queue);
+    }
+    sti();
+
+    if (fpu_test_errors != 0 || fpu_stats.restores == restores) {
+        result = FAIL;
+    }
+
+    release_boot_context(self);
+    return result;
+}
+
+static volatile uint32_t worker_cpus;
+
+/* void spread_worker()
+ * Inputs:      None
+ * Return Value: None
+ * Function: spins through a fixed amount of work, then records which processor it is on */
+static void spread_worker() {
+    volatile uint32_t i;
+
+    for (i = 0; i < THROUGHPUT_WORK; i++);
+
+    lock_kernel();
+    worker_cpus |= 1 << this_cpu()->id;
+    workers_done++;
+    wake_up(&workers_done_queue);
+    unlock_kernel();
+}
+
+/* SMP Spread Test
+ *
+ * Starts one CPU-bound kernel thread per online processor, new processes go to the least
+ * loaded processor so each should run on a different one
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints how many processors ran a thread, the boot context briefly runs as a process
+ * Coverage: init_smp, least_loaded_cpu, make_ready, dequeue_ready, lock_kernel
+ * Files: smp.c, scheduler.c, lapic.c, ap_boot.S
+ */
+int smp_spread_test() {
+    TEST_HEADER;
+
+    pcb_t* self;
+    uint32_t started, online, used, i;
+    int result = PASS;
+
+    self = adopt_boot_context();
+    if (self == NULL) {
+        return FAIL;
+    }
+
+    online = 0;
+    for (i = 0; i < num_cpus; i++) {
+        online += cpus[i].online;
+    }
+
+    cli();
+    workers_done = 0;
+    worker_cpus = 0;
+    for (started = 0; started < online; started++) {
+        if (create_kernel_thread(spread_worker, TERMINAL_1) == -1) {
+            result = FAIL;
+            break;
+        }
+    }
+    while (workers_done < started) {
+        sleep_on(&workers_done_queue);
+    }
+    sti();
+
+    used = 0;
+    for (i = 0; i < MAX_CPUS; i++) {
+        used += (worker_cpus >> i) & 1;
+    }
+    printf("%u of %u processors ran a thread, %u steals\n", used, online, smp_stats.steals);
+    if (used != online) {
+        result = FAIL;
+    }
+
+    release_boot_context(self);
+    return result;
+}
+
+// timers armed by timer_wheel_test and what they saw
+static kernel_timer_t test_timers[TIMER_TEST_COUNT];
+static kernel_timer_t periodic_test_timer;
+static kernel_timer_t far_test_timer;
+static volatile uint32_t timers_fired;
+static volatile uint32_t timers_early;
+static volatile uint32_t periodic_fired;
+
+/* void count_test_timer(kernel_timer_t* timer)
+ * Inputs:      timer -- one-shot whose data is the earliest wheel tick it may fire at
+ * Return Value: None */
+static void count_test_timer(kernel_timer_t* timer) {
+    timers_fired++;
+    if ((int32_t)(timer_ticks - (uint32_t)timer->data) < 0) {
+        timers_early++;
+    }
+}
+
+/* void count_periodic_timer(kernel_timer_t* timer)
+ * Inputs:      timer -- periodic test timer
+ * Return Value: None */
+static void count_periodic_timer(kernel_timer_t* timer) {
+    periodic_fired++;
+}
+
+/* uint32_t arm_during_oneshot(kernel_timer_t* timer)
+ * Inputs:      timer -- set up with count_test_timer
+ * Return Value: 1 if it was armed, 0 if the tick would not go into one-shot mode
+ * Function: puts the tick in one-shot mode, lets TIMER_TEST_ONESHOT_TICKS ticks pass by the
+ *           TSC with no interrupt to run them, then arms the timer for the next tick. It may
+ *           fire no sooner than one tick before the end of that wait, leaving a tick for the
+ *           TSC calibration */
+static uint32_t arm_during_oneshot(kernel_timer_t* timer) {
+    const kernel_data_t* data = (const kernel_data_t*)kernel_data_frame();
+    uint32_t flags, oneshots, start, wait_ns;
+
+    if (data->ns_mult == 0) {
+        return 0;
+    }
+    wait_ns = NS_PER_SEC / pit_hz * TIMER_TEST_ONESHOT_TICKS;
+
+    cli_and_save(flags);
+    oneshots = pit_stats.oneshots;
+    pit_enter_tickless();
+    if (pit_stats.oneshots == oneshots) {
+        restore_flags(flags);
+        return 0;
+    }
+    timer->data = (void*)(timer_ticks + TIMER_TEST_ONESHOT_TICKS);
+    start = rdtsc_low();
+    while ((((uint64_t)(rdtsc_low() - start) * data->ns_mult) >> KDATA_NS_SHIFT) < wait_ns);
+    add_timer(timer, 1, 0);
+    restore_flags(flags);
+    return 1;
+}
+
+/* Timer Wheel Test
+ *
+ * Arms TIMER_TEST_COUNT one-shots spread over TIMER_TEST_SPREAD ticks, a periodic timer
+ * firing every tick and one far enough out to sit in an upper level, then sleeps. Every
+ * one-shot must have fired and none early, the periodic one about once per tick slept, the
+ * sleep must last at least as long as asked and the cancelled far timer must stay quiet.
+ * Then arms a timer while the tick is in one-shot mode, which must not fire early either
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints the counts, the boot context briefly runs as a process
+ * Coverage: add_timer, cancel_timer, run_timers, timer_ticks_to_next, sleep,
+ *           pit_enter_tickless, pit_exit_tickless
+ * Files: timer.c, system_calls.c, pit.c
+ */
+int timer_wheel_test() {
+    TEST_HEADER;
+
+    pcb_t* self;
+    uint32_t i, ticks, start, slept;
+    int result = PASS;
+
+    self = adopt_boot_context();
+    if (self == NULL) {
+        return FAIL;
+    }
+
+    timers_fired = 0;
+    timers_early = 0;
+    periodic_fired = 0;
+    for (i = 0; i < TIMER_TEST_COUNT; i++) {
+        ticks = i % TIMER_TEST_SPREAD + 1;
+        init_timer(&test_timers[i], count_test_timer, (void*)(timer_ticks + ticks));
+        add_timer(&test_timers[i], ticks, 0);
+    }
+    init_timer(&far_test_timer, count_test_timer, NULL);
+    add_timer(&far_test_timer, TIMER_ROOT_SIZE * 2, 0);
+    init_timer(&periodic_test_timer, count_periodic_timer, NULL);
+    add_timer(&periodic_test_timer, 1, 1);
+
+    start = timer_ticks;
+    sleep(TIMER_TEST_SLEEP_MS);
+    slept = timer_ticks - start;
+    cancel_timer(&periodic_test_timer);
+    cancel_timer(&far_test_timer);
+
+    printf("%u of %u timers fired, %u early, periodic fired %u times in %u ticks slept\n",
+           timers_fired, TIMER_TEST_COUNT, timers_early, periodic_fired, slept);
+    if (timers_fired != TIMER_TEST_COUNT || timers_early != 0 || slept < ms_to_ticks_ceil(TIMER_TEST_SLEEP_MS) ||
+        periodic_fired + 1 < slept || far_test_timer.pending) {
+        result = FAIL;
+    }
+
+    timers_fired = 0;
+    timers_early = 0;
+    init_timer(&test_timers[0], count_test_timer, NULL);
+    if (arm_during_oneshot(&test_timers[0])) {
+        sleep(MS_PER_SEC * (TIMER_TEST_ONESHOT_TICKS + 1) / pit_hz);
+        printf("timer armed during a one-shot: fired %u, early %u\n", timers_fired, timers_early);
+        if (timers_fired != 1 || timers_early != 0) {
+            result = FAIL;
+        }
+    } else {
+        printf("the tick did not go into one-shot mode, skipped arming during one\n");
+    }
+
+    release_boot_context(self);
+    return result;
+}
+
+/* RTC Virtualization Test
+ *
+ * Reads the RTC for a second at RTC_TEST_FREQUENCY, which must take about a second of
+ * hardware ticks with nothing missed, then comes back RTC_TEST_LATE_TICKS virtual ticks late
+ * and checks the next read returns at once reporting them. Rates that are not a power of 2
+ * must be refused
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints the hardware ticks the reads took, the boot context briefly runs as a
+ *               process
+ * Coverage: rtc_read, rtc_write, rtc_handler
+ * Files: rtc.c
+ */
+int rtc_virtual_test() {
+    TEST_HEADER;
+
+    pcb_t* self;
+    uint32_t i, start, elapsed, missed = 0, total_missed = 0;
+    uint32_t frequency = RTC_TEST_FREQUENCY;
+    uint32_t bad_frequency = RTC_TEST_FREQUENCY + 1;
+    uint32_t period = RTC_MAX_FREQUENCY / RTC_TEST_FREQUENCY;
+    int result = PASS;
+
+    self = adopt_boot_context();
+    if (self == NULL) {
+        return FAIL;
+    }
+
+    if (rtc_write(-1, &bad_frequency, RTC_BUF_SIZE) != -1 || rtc_write(-1, &frequency, RTC_BUF_SIZE) != RTC_WRITE_SIZE) {
+        result = FAIL;
+    }
+
+    start = rtc_ticks;
+    for (i = 0; i < RTC_TEST_FREQUENCY; i++) {
+        rtc_read(-1, &missed, RTC_BUF_SIZE);
+        total_missed += missed;
+    }
+    elapsed = rtc_ticks - start;
+
+    // sit through the late ticks without reading
+    start = rtc_ticks;
+    while (rtc_ticks - start < RTC_TEST_LATE_TICKS * period);
+    start = rtc_ticks;
+    rtc_read(-1, &missed, RTC_BUF_SIZE);
+
+    printf("%u reads took %u RTC ticks, %u missed, late read missed %u\n",
+           RTC_TEST_FREQUENCY, elapsed, total_missed, missed);
+    if (elapsed + period < RTC_MAX_FREQUENCY || elapsed > RTC_MAX_FREQUENCY + period ||
+        total_missed != 0 || missed < RTC_TEST_LATE_TICKS - 1 || rtc_ticks - start > 1) {
+        result = FAIL;
+    }
+
+    release_boot_context(self);
+    return result;
+}
+
+/* void wait_ticks(uint32_t ticks)
+ * Inputs:      ticks -- timer ticks to wait, interrupts must be on
+ * Return Value: None */
+static void wait_ticks(uint32_t ticks) {
+    volatile uint32_t* interrupts = &pit_stats.interrupts;
+    uint32_t start = *interrupts;
+
+    while (*interrupts - start < ticks);
+}
+
+/* APIC Backend Test
+ *
+ * Masks the RTC through disable_irq for a second and checks no RTC interrupt arrives, then
+ * unmasks it and checks they come again, on whichever controller init_apic picked
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints the controller and the local APIC timer calibration
+ * Coverage: init_apic, enable_irq, disable_irq, send_eoi, ioapic_init, pit_use_lapic
+ * Files: i8259.c, ioapic.c, lapic.c, smp.c, pit.c
+ */
+int apic_backend_test() {
+    TEST_HEADER;
+
+    uint32_t start;
+    int result = PASS;
+
+    printf("%s, %u local APIC counts per tick\n", apic_mode ? "I/O APIC" : "8259",
+           lapic_ticks_per_pit_tick);
+
+    disable_irq(RTC_IRQ);
+    // one interrupt may have been on its way
+    wait_ticks(1);
+    start = rtc_ticks;
+    wait_ticks(pit_hz);
+    if (rtc_ticks != start) {
+        result = FAIL;
+    }
+
+    enable_irq(RTC_IRQ);
+    wait_ticks(pit_hz);
+    if (rtc_ticks == start) {
+        result = FAIL;
+    }
+    return result;
+}
+
+/* Run Queue Throughput Benchmark
+ *
+ * Runs 1 to THROUGHPUT_MAX_WORKERS CPU-bound kernel threads at once and times how long the
+ * batch takes in PIT ticks. Total work per tick should stay flat as workers are added, and
+ * the first and last worker should finish close together if the run queue shares the CPU fairly
+ * Inputs: None
+ * Outputs: PASS, FAIL if a worker could not be created
+ * Side Effects: Prints the timings, the boot context runs as a process while it waits
+ * Coverage: make_ready, scheduler, create_kernel_thread, sleep_on, wake_up
+ * Files: scheduler.c, system_calls.c, wait_queue.c
+ */
+int run_queue_throughput_benchmark() {
+    TEST_HEADER;
+
+    pcb_t* self;
+    uint32_t workers, started, start_tick, elapsed;
+    int result = PASS;
+
+    self = adopt_boot_context();
+    if (self == NULL) {
+        return FAIL;
+    }
+
+    for (workers = 1; workers <= THROUGHPUT_MAX_WORKERS && result == PASS; workers++) {
+        cli();
+        workers_done = 0;
+        start_tick = idle_stats.total_ticks;
+        for (started = 0; started < workers; started++) {
+            if (create_kernel_thread(cpu_bound_worker, TERMINAL_1) == -1) {
+                result = FAIL;
+                break;
+            }
+        }
+        while (workers_done < started) {
+            sleep_on(&workers_done_queue);
+        }
+        elapsed = idle_stats.total_ticks - start_tick;
+        sti();
+
+        if (elapsed == 0) {
+            elapsed = 1;
+        }
+        printf("%u workers: %u ticks, %u iterations/tick, first done at %u, last at %u\n",
+               started, elapsed, started * (THROUGHPUT_WORK / elapsed),
+               first_done_tick - start_tick, elapsed);
+    }
+
+    release_boot_context(self);
+    return result;
+}
+
+/* void yield_worker()
+ * Inputs:      None
+ * Return Value: None
+ * Function: gives up the CPU SWITCH_BENCH_ROUNDS times, then reports that it finished */
+static void yield_worker() {
+    uint32_t i;
+
+    for (i = 0; i < SWITCH_BENCH_ROUNDS; i++) {
+        yield();
+    }
+
+    lock_kernel();
+    workers_done++;
+    wake_up(&workers_done_queue);
+    unlock_kernel();
+}
+
+/* Context Switch Benchmark
+ *
+ * Two kernel threads yield to each other SWITCH_BENCH_ROUNDS times each. The scheduler times
+ * every switch with rdtsc, from loading the next page directory to the return from switch_to
+ * in the next context
+ * Inputs: None
+ * Outputs: PASS, FAIL if a thread could not be created
+ * Side Effects: Prints the average, minimum and maximum switch cost in cycles
+ * Coverage: scheduler, switch_to, yield
+ * Files: scheduler.c, switch.S
+ */
+int context_switch_benchmark() {
+    TEST_HEADER;
+
+    pcb_t* self;
+    uint32_t started;
+    int result = PASS;
+
+    self = adopt_boot_context();
+    if (self == NULL) {
+        return FAIL;
+    }
+
+    cli();
+    memset(&switch_stats, 0, sizeof(switch_stats));
+    workers_done = 0;
+    for (started = 0; started < SWITCH_BENCH_THREADS; started++) {
+        if (create_kernel_thread(yield_worker, TERMINAL_1) == -1) {
+            result = FAIL;
+            break;
+        }
+    }
+    while (workers_done < started) {
+        sleep_on(&workers_done_queue);
+    }
+    sti();
+
+    if (switch_stats.timed_switches != 0) {
+        printf("%u switches: %u cycles average, %u min, %u max\n", switch_stats.timed_switches,
+               switch_stats.total_cycles / switch_stats.timed_switches,
+               switch_stats.min_cycles, switch_stats.max_cycles);
+    }
+
+    release_boot_context(self);
+    return result;
+}
+
+/* Kernel Data Page Test
+ *
+ * Checks the boot context's data pages are mapped read-only for user code, that its own page
+ * has its pid, parent and terminal, and that over KDATA_TEST_SECONDS the shared page's ticks
+ * advance with the timer and its ns clock with them
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints the ticks and ns seen, the boot context briefly runs as a process
+ * Coverage: setup_page_directory, init_kernel_data, update_kernel_data, set_process_data
+ * Files: kdata.c, paging.c, pit.c
+ */
+int kernel_data_test() {
+    TEST_HEADER;
+
+    const kernel_data_t* data = (const kernel_data_t*)kernel_data_frame();
+    const process_data_t* own;
+    const ptble_entry_t* table;
+    pcb_t* self;
+    uint32_t ticks, elapsed_ms;
+    uint64_t ns;
+    int result = PASS;
+
+    self = adopt_boot_context();
+    if (self == NULL) {
+        return FAIL;
+    }
+
+    table = (const ptble_entry_t*)self->kdata_table;
+    own = (const process_data_t*)self->process_data;
+    if (!table[KDATA_SHARED_PAGE].present || table[KDATA_SHARED_PAGE].readWrite || !table[KDATA_SHARED_PAGE].userSupervisor ||
+        !table[KDATA_PROCESS_PAGE].present || table[KDATA_PROCESS_PAGE].readWrite || !table[KDATA_PROCESS_PAGE].userSupervisor) {
+        result = FAIL;
+    }
+    if (own->pid != self->process_id || own->parent_pid != NO_PARENT || own->terminal != self->terminal) {
+        result = FAIL;
+    }
+
+    ticks = data->ticks;
+    ns = ((uint64_t)data->ns_high << 32) | data->ns_low;
+    wait_ticks(KDATA_TEST_SECONDS * pit_hz);
+    ticks = data->ticks - ticks;
+    ns = (((uint64_t)data->ns_high << 32) | data->ns_low) - ns;
+    elapsed_ms = (uint32_t)(ns >> 20);  // close enough to ms for a printout
+
+    printf("%u ticks at %u Hz, about %u ms on the clock\n", ticks, data->tick_hz, elapsed_ms);
+    if (ticks + 1 < KDATA_TEST_SECONDS * pit_hz) {
+        result = FAIL;
+    }
+    if (data->ns_mult != 0 &&
+        (ns * 100 < (uint64_t)KDATA_TEST_SECONDS * NS_PER_SEC * (100 - KDATA_CLOCK_TOLERANCE) ||
+         ns * 100 > (uint64_t)KDATA_TEST_SECONDS * NS_PER_SEC * (100 + KDATA_CLOCK_TOLERANCE))) {
+        result = FAIL;
+    }
+
+    release_boot_context(self);
+    return result;
+}
+
+/* PID Allocator Test
+ *
+ * Takes every pid get_pid will give, which must all be distinct and below max_pids, and checks
+ * the next call fails. After they are put back the last one put back comes out first
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints the limit and how many pids were free, leaves them all free again
+ * Coverage: get_pid, put_pid
+ * Files: system_calls.c
+ */
+int pid_alloc_test() {
+    TEST_HEADER;
+
+    static int32_t taken[NUM_PIDS];
+    static uint8_t seen[NUM_PIDS];
+    uint32_t count = 0;
+    uint32_t exhausted = pid_stats.exhausted;
+    int32_t pid;
+    int result = PASS;
+
+    memset(seen, 0, sizeof(seen));
+    while ((pid = get_pid()) != -1) {
+        if (pid < 0 || pid >= (int32_t)max_pids || seen[pid] || count == NUM_PIDS) {
+            result = FAIL;
+            break;
+        }
+        seen[pid] = 1;
+        taken[count++] = pid;
+    }
+    printf("max_pids %u, %u free, %u live at peak\n", max_pids, count, pid_stats.peak);
+    if (pid_stats.live != max_pids || pid_stats.exhausted != exhausted + 1) {
+        result = FAIL;
+    }
+
+    while (count > 0) {
+        put_pid(taken[--count]);
+    }
+    // taken[0] went back last, so it is on top of the free list
+    pid = get_pid();
+    if (pid != taken[0]) {
+        result = FAIL;
+    }
+    if (pid != -1) {
+        put_pid(pid);
+    }
+    return result;
+}
+
+/* uint32_t read_msr(uint32_t msr)
+ * Inputs:      msr -- register number
+ * Return Value: its low 32 bits */
+static uint32_t read_msr(uint32_t msr) {
+    uint32_t low, high;
+
+    asm volatile("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return low;
+}
+
+/* SYSENTER Setup Test
+ *
+ * Reads back the boot processor's SYSENTER MSRs, which must send SYSENTER to sysenter_linkage
+ * in KERNEL_CS with its TSS as the stack. The latency of both system call paths is measured
+ * from user space by the sysbench program
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints whether the processor has SYSENTER
+ * Coverage: init_sysenter
+ * Files: sysenter.c
+ */
+int sysenter_test() {
+    TEST_HEADER;
+
+    if (!sysenter_enabled) {
+        printf("no SYSENTER, system calls use int $0x80 only\n");
+        return PASS;
+    }
+    printf("SYSENTER at %x, stack %x\n", read_msr(IA32_SYSENTER_EIP), read_msr(IA32_SYSENTER_ESP));
+    if (read_msr(IA32_SYSENTER_CS) != KERNEL_CS || read_msr(IA32_SYSENTER_EIP) != (uint32_t)sysenter_linkage ||
+        read_msr(IA32_SYSENTER_ESP) != (uint32_t)this_cpu()->tss) {
+        return FAIL;
+    }
+    return PASS;
+}
+
+/* I/O Ring Benchmark
+ *
+ * Runs cat and grep with the rings turned off, where the library makes one system call per
+ * operation, and on, where one enter carries many, and prints the system calls each run
+ * made per KB read and written
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: The programs print to terminal 1, the boot context briefly runs as a process
+ * Coverage: enter, execute, read, write
+ * Files: io_ring.c, system_calls.c, sys_call_asm_linkage.S
+ */
+int io_ring_benchmark() {
+    TEST_HEADER;
+
+    static const char* programs[IO_RING_BENCH_PROGRAMS] = {"cat frame0.txt", "grep the"};
+    pcb_t* self;
+    uint32_t i, on, calls, bytes, ring_ops;
+    int result = PASS;
+
+    self = adopt_boot_context();
+    if (self == NULL) {
+        return FAIL;
+    }
+
+    for (i = 0; i < IO_RING_BENCH_PROGRAMS; i++) {
+        for (on = 0; on <= 1; on++) {
+            io_ring_disabled = !on;
+            calls = sys_call_stats.calls;
+            bytes = sys_call_stats.io_bytes;
+            ring_ops = io_ring_stats.ops;
+            if (execute((const uint8_t*)programs[i]) != 0) {
+                result = FAIL;
+            }
+            calls = sys_call_stats.calls - calls;
+            bytes = sys_call_stats.io_bytes - bytes;
+            ring_ops = io_ring_stats.ops - ring_ops;
+            printf("%s, rings %s: %u calls, %u ops on the ring, %u bytes, %u calls per KB\n",
+                   programs[i], on ? "on" : "off", calls, ring_ops, bytes, bytes ? calls * ONE_KB / bytes : 0);
+        }
+    }
+    io_ring_disabled = 0;
+
+    release_boot_context(self);
+    return result;
+}
+
+/* Fork Benchmark
+ *
+ * Runs forkbench, which forks children that write one shared page and halt, then execs
+ * testprint in one more child. Prints the cycles fork took in the kernel next to the
+ * cycles execute spent starting forkbench, and how the children's writes were resolved
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: The programs print to terminal 1, the boot context briefly runs as a process
+ * Coverage: fork, exec, fork_user_image, handle_user_page_fault
+ * Files: system_calls.c, loader.c, frame_alloc.c, sys_call_asm_linkage.S
+ */
+int fork_benchmark() {
+    TEST_HEADER;
+
+    fork_stats_t before = fork_stats;
+    image_cache_stats_t pages = image_cache_stats;
+    dentry_t program;
+    uint32_t forks, execute_cycles = 0;
+    pcb_t* self;
+    int result = PASS;
+
+    self = adopt_boot_context();
+    if (self == NULL) {
+        return FAIL;
+    }
+
+    if (execute((const uint8_t*)"forkbench") != 0) {
+        result = FAIL;
+    }
+    wait_ticks(FORK_BENCH_SETTLE_TICKS);
+
+    if (read_dentry_by_name((const uint8_t*)"forkbench", &program) == 0 && program.inodeNumber < LOADER_STATS_SIZE) {
+        execute_cycles = loader_stats[program.inodeNumber].startup_cycles;
+    }
+    forks = fork_stats.forks - before.forks;
+    printf("%u forks, avg %u max %u cycles, execute took %u, %u execs\n", forks,
+           forks ? (fork_stats.fork_cycles - before.fork_cycles) / forks : 0, fork_stats.max_fork_cycles,
+           execute_cycles, fork_stats.execs - before.execs);
+    printf("%u pages shared, %u copied, %u reclaimed\n", image_cache_stats.forked_pages - pages.forked_pages,
+           image_cache_stats.fork_copies - pages.fork_copies, image_cache_stats.fork_reclaims - pages.fork_reclaims);
+    if (forks == 0 || fork_stats.execs == before.execs) {
+        result = FAIL;
+    }
+
+    release_boot_context(self);
+    return result;
+}
 
 /* Test suite entry point */
 void launch_tests(){
@@ -1174,6 +2347,7 @@ void launch_tests(){
     // TEST_OUTPUT("video memory shift test", video_memory_shift_test());
     // TEST_OUTPUT("terminal write string test", terminal_write_string_test());
     // TEST_OUTPUT("dentry_search test", test_dentry_search());
+    // TEST_OUTPUT("dentry hash lookup test", test_dentry_hash_lookup());
     // TEST_OUTPUT("terminal diff size strings test", terminal_diff_string_test());
 
 /*--------------------------------------------CP2 DEMO TESTS----------------------------------------------------------------*/
@@ -1199,7 +2373,29 @@ void launch_tests(){
 /*---------------------------------------------GENERAL CP5 TESTS------------------------------------------------------------*/
 
     // TEST_OUTPUT("PIT TEST", pit_test());
-
+    // TEST_OUTPUT("frame allocator test", frame_alloc_test());
+    // TEST_OUTPUT("nice test", nice_test());
+    // TEST_OUTPUT("fpu switch test", fpu_switch_test());
+    // TEST_OUTPUT("smp spread test", smp_spread_test());
+    // TEST_OUTPUT("apic backend test", apic_backend_test());
+    // TEST_OUTPUT("timer wheel test", timer_wheel_test());
+    // TEST_OUTPUT("rtc virtualization test", rtc_virtual_test());
+    // TEST_OUTPUT("sysenter test", sysenter_test());
+    // TEST_OUTPUT("kernel data page test", kernel_data_test());
+    // TEST_OUTPUT("pid allocator test", pid_alloc_test());
+
+/*---------------------------------------------BENCHMARKS-------------------------------------------------------------------*/
+
+    // TEST_OUTPUT("read_data benchmark", read_data_benchmark());
+    // TEST_OUTPUT("loader stats report", loader_stats_report());
+    // TEST_OUTPUT("tlb flush report", tlb_flush_report());
+    // TEST_OUTPUT("idle report", idle_report());
+    // TEST_OUTPUT("timer report", timer_report());
+    // TEST_OUTPUT("irq latency report", irq_latency_report());
+    // TEST_OUTPUT("run queue throughput benchmark", run_queue_throughput_benchmark());
+    // TEST_OUTPUT("context switch benchmark", context_switch_benchmark());
+    // TEST_OUTPUT("io ring benchmark", io_ring_benchmark());
+    // TEST_OUTPUT("fork benchmark", fork_benchmark());
 
 /*------------------------------------------ALL EXCEPTION TESTS-------------------------------------------------------------*/  
 	// TEST_OUTPUT("div_by_zero_test", div_by_zero_test());
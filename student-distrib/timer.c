@@ -0,0 +1,318 @@
+#include "timer.h"
+#include "lib.h"
+#include "smp.h"
+#include "devices/pit.h"
+
+// slot per tick for the next TIMER_ROOT_SIZE ticks, and the coarser levels above it
+static timer_link_t root_slots[TIMER_ROOT_SIZE];
+static timer_link_t level_slots[TIMER_UPPER_LEVELS][TIMER_LEVEL_SIZE];
+
+// timers in the wheel or waiting to go in it
+static uint32_t pending_timers;
+
+// timers added while the boot processor's one-shot was counting, expires holds their ticks
+static timer_link_t deferred_timers;
+
+// the wheel is changed from the tick and from any processor adding or cancelling
+static spinlock_t timer_lock;
+
+/* void link_init(timer_link_t* head)
+ * Inputs:      head -- slot head
+ * Return Value: void */
+static void
+link_init(timer_link_t* head) {
+    head->next = head;
+    head->prev = head;
+}
+
+/* void link_add(timer_link_t* head, timer_link_t* link)
+ * Inputs:      head -- slot head
+ *              link -- timer to append
+ * Return Value: void */
+static void
+link_add(timer_link_t* head, timer_link_t* link) {
+    link->prev = head->prev;
+    link->next = head;
+    head->prev->next = link;
+    head->prev = link;
+}
+
+/* void link_del(timer_link_t* link)
+ * Inputs:      link -- timer in a slot
+ * Return Value: void */
+static void
+link_del(timer_link_t* link) {
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->next = link;
+    link->prev = link;
+}
+
+/* void wheel_add(kernel_timer_t* timer)
+ * Inputs:      timer -- timer with expires set
+ * Return Value: void
+ * Function: puts the timer in the lowest level whose span reaches its expiry, a timer that
+ *           is already due goes in the slot the next tick runs. Called with timer_lock */
+static void
+wheel_add(kernel_timer_t* timer) {
+    uint32_t delta = timer->expires - timer_ticks;
+    uint32_t level, shift;
+
+    if ((int32_t)delta < 0) {
+        link_add(&root_slots[timer_ticks & TIMER_ROOT_MASK], &timer->link);
+        return;
+    }
+    if (delta < TIMER_ROOT_SIZE) {
+        link_add(&root_slots[timer->expires & TIMER_ROOT_MASK], &timer->link);
+        return;
+    }
+    if (delta > TIMER_MAX_TICKS) {
+        timer->expires = timer_ticks + TIMER_MAX_TICKS;
+        delta = TIMER_MAX_TICKS;
+    }
+
+    shift = TIMER_ROOT_BITS;
+    for (level = 0; level < TIMER_UPPER_LEVELS - 1; level++) {
+        if (delta < (1 << (shift + TIMER_LEVEL_BITS))) {
+            break;
+        }
+        shift += TIMER_LEVEL_BITS;
+    }
+    link_add(&level_slots[level][(timer->expires >> shift) & TIMER_LEVEL_MASK], &timer->link);
+}
+
+/* uint32_t cascade(uint32_t level)
+ * Inputs:      level -- upper level whose current slot is due
+ * Return Value: index of that slot, 0 means the next level up is due as well
+ * Function: moves every timer in the slot into the levels below. Called with timer_lock */
+static uint32_t
+cascade(uint32_t level) {
+    uint32_t index = (timer_ticks >> (TIMER_ROOT_BITS + level * TIMER_LEVEL_BITS)) & TIMER_LEVEL_MASK;
+    timer_link_t* head = &level_slots[level][index];
+    timer_link_t moving;
+    timer_link_t* link;
+
+    // take the whole slot first, a timer can land back in the same level
+    if (head->next == head) {
+        return index;
+    }
+    moving.next = head->next;
+    moving.prev = head->prev;
+    moving.next->prev = &moving;
+    moving.prev->next = &moving;
+    link_init(head);
+
+    while (moving.next != &moving) {
+        link = moving.next;
+        link_del(link);
+        wheel_add((kernel_timer_t*)link);
+    }
+    return index;
+}
+
+/* void run_tick()
+ * Inputs:      None
+ * Return Value: void
+ * Function: cascades the upper levels when the root wraps, then fires the timers of the
+ *           current slot. Callbacks run with interrupts off and timer_lock released, so they
+ *           may add or cancel timers. Called with timer_lock */
+static void
+run_tick() {
+    uint32_t index = timer_ticks & TIMER_ROOT_MASK;
+    uint32_t level;
+    timer_link_t due;
+    timer_link_t* head = &root_slots[index];
+    kernel_timer_t* timer;
+
+    if (index == 0) {
+        for (level = 0; level < TIMER_UPPER_LEVELS && cascade(level) == 0; level++);
+    }
+    timer_ticks++;
+
+    if (head->next == head) {
+        return;
+    }
+    due.next = head->next;
+    due.prev = head->prev;
+    due.next->prev = &due;
+    due.prev->next = &due;
+    link_init(head);
+
+    while (due.next != &due) {
+        timer = (kernel_timer_t*)due.next;
+        link_del(&timer->link);
+        if (timer->period != 0) {
+            timer->expires += timer->period;
+            wheel_add(timer);
+        } else {
+            timer->pending = 0;
+            pending_timers--;
+        }
+
+        spin_unlock(&timer_lock);
+        timer->callback(timer);
+        spin_lock(&timer_lock);
+    }
+}
+
+/* void init_timers()
+ * Inputs:      None
+ * Return Value: void
+ * Function: empties every slot */
+void
+init_timers() {
+    uint32_t i, level;
+
+    for (i = 0; i < TIMER_ROOT_SIZE; i++) {
+        link_init(&root_slots[i]);
+    }
+    for (level = 0; level < TIMER_UPPER_LEVELS; level++) {
+        for (i = 0; i < TIMER_LEVEL_SIZE; i++) {
+            link_init(&level_slots[level][i]);
+        }
+    }
+    link_init(&deferred_timers);
+}
+
+/* void init_timer(kernel_timer_t* timer, void (*callback)(kernel_timer_t* timer), void* data)
+ * Inputs:      timer -- timer to set up
+ *              callback -- called with the timer each time it fires
+ *              data -- anything the callback needs
+ * Return Value: void */
+void
+init_timer(kernel_timer_t* timer, void (*callback)(kernel_timer_t* timer), void* data) {
+    link_init(&timer->link);
+    timer->expires = 0;
+    timer->period = 0;
+    timer->pending = 0;
+    timer->callback = callback;
+    timer->data = data;
+}
+
+/* void add_timer(kernel_timer_t* timer, uint32_t ticks, uint32_t period)
+ * Inputs:      timer -- timer from init_timer, moved if it is pending already
+ *              ticks -- whole ticks before it fires, it fires on the tick after them
+ *              period -- ticks between later firings, 0 for a one-shot
+ * Return Value: void
+ * Function: the tick may be in one-shot mode, it is made periodic again so the timer is not
+ *           slept past. The ticks the one-shot let pass are credited first and the expiry
+ *           counts from them, not from the wheel's stale tick. Another processor cannot stop
+ *           the boot processor's one-shot, its timer waits for the boot processor to place it */
+void
+add_timer(kernel_timer_t* timer, uint32_t ticks, uint32_t period) {
+    uint32_t flags, behind;
+
+    cli_and_save(flags);
+    pit_exit_tickless();
+    spin_lock(&timer_lock);
+    if (timer->pending) {
+        link_del(&timer->link);
+    } else {
+        pending_timers++;
+    }
+    timer->period = period;
+    timer->pending = 1;
+    behind = pit_ticks_behind();
+    if (behind == PIT_BEHIND_UNKNOWN) {
+        timer->expires = ticks;
+        link_add(&deferred_timers, &timer->link);
+    } else {
+        timer->expires = timer_ticks + behind + ticks;
+        wheel_add(timer);
+    }
+    spin_unlock(&timer_lock);
+    restore_flags(flags);
+}
+
+/* void add_deferred_timers(uint32_t behind)
+ * Inputs:      behind -- ticks that passed which the wheel has not run yet
+ * Return Value: void
+ * Function: puts the timers added during a one-shot into the wheel, counting from the tick
+ *           the one-shot ended at. Called on the boot processor with interrupts disabled */
+void
+add_deferred_timers(uint32_t behind) {
+    timer_link_t* link;
+
+    spin_lock(&timer_lock);
+    while (deferred_timers.next != &deferred_timers) {
+        link = deferred_timers.next;
+        link_del(link);
+        ((kernel_timer_t*)link)->expires += timer_ticks + behind;
+        wheel_add((kernel_timer_t*)link);
+    }
+    spin_unlock(&timer_lock);
+}
+
+/* void cancel_timer(kernel_timer_t* timer)
+ * Inputs:      timer -- timer from init_timer
+ * Return Value: void */
+void
+cancel_timer(kernel_timer_t* timer) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    spin_lock(&timer_lock);
+    if (timer->pending) {
+        link_del(&timer->link);
+        timer->pending = 0;
+        pending_timers--;
+    }
+    spin_unlock(&timer_lock);
+    restore_flags(flags);
+}
+
+/* void run_timers(uint32_t ticks)
+ * Inputs:      ticks -- ticks since the last call, more than one after a one-shot
+ * Return Value: void
+ * Function: runs the wheel forward one tick at a time, each tick touches one root slot and
+ *           at most one slot per upper level */
+void
+run_timers(uint32_t ticks) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    spin_lock(&timer_lock);
+    while (ticks-- > 0) {
+        run_tick();
+    }
+    spin_unlock(&timer_lock);
+    restore_flags(flags);
+}
+
+/* uint32_t timer_ticks_to_next()
+ * Inputs:      None
+ * Return Value: ticks run_timers must be given before the next timer fires, TIMER_NONE if
+ *               none is pending
+ * Function: looks through the root slots in order. Upper level timers are not searched,
+ *           the tick where the root wraps and they cascade counts as the next one instead.
+ *           Bounded by TIMER_ROOT_SIZE slots */
+uint32_t
+timer_ticks_to_next() {
+    uint32_t flags, i, ticks = TIMER_NONE;
+
+    cli_and_save(flags);
+    spin_lock(&timer_lock);
+    if (pending_timers != 0) {
+        for (i = 0; i < TIMER_ROOT_SIZE; i++) {
+            if (((timer_ticks + i) & TIMER_ROOT_MASK) == 0) {
+                break;
+            }
+            if (root_slots[(timer_ticks + i) & TIMER_ROOT_MASK].next != &root_slots[(timer_ticks + i) & TIMER_ROOT_MASK]) {
+                break;
+            }
+        }
+        ticks = i + 1;
+    }
+    spin_unlock(&timer_lock);
+    restore_flags(flags);
+    return ticks;
+}
+
+/* uint32_t ms_to_ticks_ceil(uint32_t ms)
+ * Inputs:      ms -- milliseconds
+ * Return Value: ticks at the current rate covering at least ms, 0 for 0 */
+uint32_t
+ms_to_ticks_ceil(uint32_t ms) {
+    // whole seconds first so the product cannot overflow
+    return (ms / MS_PER_SEC) * pit_hz + ((ms % MS_PER_SEC) * pit_hz + MS_PER_SEC - 1) / MS_PER_SEC;
+}
@@ -0,0 +1,65 @@
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include "types.h"
+
+/* hierarchical timer wheel: the root level has a slot per tick for the next 256 ticks, each
+   level above has 64 slots covering 64 times as long, and its timers move down a level when
+   the level below wraps. Adding, cancelling and each tick cost O(1) however many timers wait */
+#define TIMER_ROOT_BITS             8
+#define TIMER_LEVEL_BITS            6
+#define TIMER_ROOT_SIZE             (1 << TIMER_ROOT_BITS)
+#define TIMER_LEVEL_SIZE            (1 << TIMER_LEVEL_BITS)
+#define TIMER_ROOT_MASK             (TIMER_ROOT_SIZE - 1)
+#define TIMER_LEVEL_MASK            (TIMER_LEVEL_SIZE - 1)
+#define TIMER_UPPER_LEVELS          3
+/* furthest a timer can be set, longer ones are clamped */
+#define TIMER_MAX_TICKS             ((1 << (TIMER_ROOT_BITS + TIMER_UPPER_LEVELS * TIMER_LEVEL_BITS)) - 1)
+/* timer_ticks_to_next when nothing is pending */
+#define TIMER_NONE                  0xFFFFFFFF
+
+/* links of a wheel slot, a slot's head is one of these too */
+typedef struct timer_link_t {
+    struct timer_link_t* next;
+    struct timer_link_t* prev;
+} timer_link_t;
+
+/* kernel timer, usually embedded in the structure its callback needs */
+typedef struct kernel_timer_t {
+    timer_link_t link;          // slot it waits in, must stay first
+    uint32_t expires;           // wheel tick it fires at
+    uint32_t period;            // ticks until it fires again, 0 for a one-shot
+    uint32_t pending;           // 1 while it is in the wheel
+    void (*callback)(struct kernel_timer_t* timer);
+    void* data;
+} kernel_timer_t;
+
+/* ticks the wheel has run since boot */
+volatile uint32_t timer_ticks;
+
+/* set up the wheel's empty slots */
+void init_timers();
+
+/* prepare a timer that calls callback with itself when it fires */
+void init_timer(kernel_timer_t* timer, void (*callback)(kernel_timer_t* timer), void* data);
+
+/* fire after at least ticks whole ticks, then every period ticks unless period is 0 */
+void add_timer(kernel_timer_t* timer, uint32_t ticks, uint32_t period);
+
+/* place the timers added while the boot processor's one-shot was counting, behind is the
+   ticks the wheel has yet to run */
+void add_deferred_timers(uint32_t behind);
+
+/* take a timer out of the wheel, harmless if it is not in it */
+void cancel_timer(kernel_timer_t* timer);
+
+/* advance the wheel, run by the tick on the boot processor with the kernel lock held */
+void run_timers(uint32_t ticks);
+
+/* ticks until the next timer could fire, TIMER_NONE if none is pending */
+uint32_t timer_ticks_to_next();
+
+/* ms in ticks, rounded up so a wait is never short */
+uint32_t ms_to_ticks_ceil(uint32_t ms);
+
+#endif /* _TIMER_H */
@@ -0,0 +1,75 @@
+#include "wait_queue.h"
+#include "lib.h"
+#include "scheduler.h"
+
+/* void sleep_on(wait_queue_t* queue)
+ * Inputs:      queue -- event to wait for
+ * Return Value: void
+ * Function: marks the current process blocked so it stays off the run queue, then gives up
+ *           the CPU until a wake_up on the queue makes it ready. Callers check their condition
+ *           with interrupts disabled before sleeping so a wakeup cannot be missed. Before the
+ *           first process exists there is nothing to block, so it just waits for an interrupt */
+void
+sleep_on(wait_queue_t* queue) {
+    pcb_t* pcb = (pcb_t*)current_pcb;
+
+    if (pcb == NULL) {
+        asm volatile("sti; hlt; cli");
+        return;
+    }
+
+    pcb->state = PROCESS_BLOCKED;
+    pcb->wait_next = queue->head;
+    queue->head = pcb;
+
+    // the scheduler runs other processes, or idles, until a wakeup queues this one again
+    while (pcb->state == PROCESS_BLOCKED) {
+        scheduler();
+    }
+}
+
+/* void wake_all(wait_queue_t* queue, uint32_t boost)
+ * Inputs:      queue -- event that happened
+ *              boost -- 1 to move the woken processes to the top priority level
+ * Return Value: void
+ * Function: empties the queue and puts every process on it at the back of the run queue,
+ *           kernel threads may call it without holding the big kernel lock */
+static void
+wake_all(wait_queue_t* queue, uint32_t boost) {
+    pcb_t* pcb;
+    pcb_t* next;
+    uint32_t flags;
+
+    lock_kernel();
+    cli_and_save(flags);
+    for (pcb = queue->head; pcb != NULL; pcb = next) {
+        next = pcb->wait_next;
+        pcb->wait_next = NULL;
+        if (boost) {
+            boost_priority(pcb);
+        }
+        make_ready(pcb);
+    }
+    queue->head = NULL;
+    restore_flags(flags);
+    unlock_kernel();
+}
+
+/* void wake_up(wait_queue_t* queue)
+ * Inputs:      queue -- event that happened
+ * Return Value: void
+ * Function: makes every process on the queue ready at its current priority */
+void
+wake_up(wait_queue_t* queue) {
+    wake_all(queue, 0);
+}
+
+/* void wake_up_interactive(wait_queue_t* queue)
+ * Inputs:      queue -- keyboard or RTC event that happened
+ * Return Value: void
+ * Function: makes every process on the queue ready at the top priority, so processes waiting
+ *           on input respond ahead of CPU-bound ones */
+void
+wake_up_interactive(wait_queue_t* queue) {
+    wake_all(queue, 1);
+}
@@ -0,0 +1,18 @@
+#ifndef _WAIT_QUEUE_H
+#define _WAIT_QUEUE_H
+
+#include "types.h"
+#include "system_calls.h"
+
+/* wait_queue_t is declared in system_calls.h so each pcb can hold one for its children */
+
+/* block the current process until wake_up is called on the queue, call with interrupts disabled */
+void sleep_on(wait_queue_t* queue);
+
+/* make every process blocked on the queue runnable again, safe to call from interrupt handlers */
+void wake_up(wait_queue_t* queue);
+
+/* same as wake_up but boosts the woken processes to the top priority, for keyboard and RTC input */
+void wake_up_interactive(wait_queue_t* queue);
+
+#endif /* _WAIT_QUEUE_H */
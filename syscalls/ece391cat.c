@@ -3,30 +3,46 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
+#define BUFSIZE 1024
+#define WRITE_DATA 2
+
 int main ()
 {
-    int32_t fd, cnt;
-    uint8_t buf[1024];
+    int32_t fd, cnt, result;
+    uint32_t cur, user_data;
+    uint8_t buf[2][BUFSIZE];
 
-    if (0 != ece391_getargs (buf, 1024)) {
+    if (0 != ece391_getargs (buf[0], BUFSIZE)) {
         ece391_fdputs (1, (uint8_t*)"could not read arguments\n");
 	return 3;
     }
 
-    if (-1 == (fd = ece391_open (buf))) {
+    if (-1 == (fd = ece391_open (buf[0]))) {
         ece391_fdputs (1, (uint8_t*)"file not found\n");
 	return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, 1024))) {
-        if (-1 == cnt) {
-	    ece391_fdputs (1, (uint8_t*)"file read failed\n");
-	    return 3;
+    /* each submit writes out one block and reads the next into the other buffer */
+    cur = 0;
+    ece391_ring_queue (IO_OP_READ, fd, buf[cur], BUFSIZE, cur);
+    while (1) {
+        ece391_ring_submit ();
+	cnt = 0;
+	while (0 == ece391_ring_reap (&result, &user_data)) {
+	    if (-1 == result) {
+	        if (WRITE_DATA != user_data)
+		    ece391_fdputs (1, (uint8_t*)"file read failed\n");
+		return 3;
+	    }
+	    if (WRITE_DATA != user_data)
+	        cnt = result;
 	}
-	if (-1 == ece391_write (1, buf, cnt))
-	    return 3;
+	if (0 == cnt)
+	    break;
+	ece391_ring_queue (IO_OP_WRITE, 1, buf[cur], cnt, WRITE_DATA);
+	cur ^= 1;
+	ece391_ring_queue (IO_OP_READ, fd, buf[cur], BUFSIZE, cur);
     }
 
     return 0;
 }
-
@@ -0,0 +1,66 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define FORKS 16
+#define PAGE_SIZE 4096
+
+/* touched by the parent before forking and written by each child, so every child copies it */
+static volatile uint8_t scratch[PAGE_SIZE];
+
+static uint32_t rdtsc_low ()
+{
+    uint32_t low, high;
+
+    asm volatile ("rdtsc" : "=a" (low), "=d" (high));
+    return low;
+}
+
+static void print_result (const char* what, uint32_t value, const char* unit)
+{
+    uint8_t buf[16];
+
+    ece391_fdputs (1, (uint8_t*)what);
+    ece391_fdputs (1, ece391_itoa (value, buf, 10));
+    ece391_fdputs (1, (uint8_t*)unit);
+}
+
+int main ()
+{
+    uint32_t i, start, total = 0;
+    int32_t pid;
+
+    scratch[0] = 0;
+    for (i = 0; i < FORKS; i++) {
+        start = rdtsc_low ();
+        pid = ece391_fork ();
+        if (pid == 0) {
+            scratch[0] = i;
+            ece391_halt (0);
+        }
+        total += rdtsc_low () - start;
+        if (pid == -1) {
+            ece391_fdputs (1, (uint8_t*)"fork failed\n");
+            return 1;
+        }
+        /* give up the quantum so children do not pile up; on another processor the child may
+           still be running when the next fork starts */
+        ece391_sleep (0);
+    }
+    print_result ("fork: ", total / FORKS, " cycles in the parent\n");
+
+    /* a forked child becomes another program without a new pid */
+    pid = ece391_fork ();
+    if (pid == 0) {
+        ece391_exec ((uint8_t*)"testprint");
+        ece391_fdputs (1, (uint8_t*)"exec failed\n");
+        ece391_halt (1);
+    }
+    if (pid == -1) {
+        ece391_fdputs (1, (uint8_t*)"fork failed\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -14,14 +14,14 @@ do_one_file (const char* s, const char* fname)
 
     s_len = ece391_strlen ((uint8_t*)s);
     if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
-        ece391_fdputs (1, (uint8_t*)"file open failed\n");
+        ece391_ring_fdputs (1, (uint8_t*)"file open failed\n");
         return -1;
     }
     last = 0;
     while (1) {
         cnt = ece391_read (fd, data + last, BUFSIZE - last);
 	if (-1 == cnt) {
-            ece391_fdputs (1, (uint8_t*)"file read failed\n");
+            ece391_ring_fdputs (1, (uint8_t*)"file read failed\n");
             return -1;
 	}
 	last += cnt;
@@ -42,10 +42,10 @@ do_one_file (const char* s, const char* fname)
 	    for (check = line_start; check < line_end; check++) {
 		if (s[0] == data[check] && 
 		    0 == ece391_strncmp ((uint8_t*)(data + check), (uint8_t*)s, s_len)) {
-		    ece391_fdputs (1, (uint8_t*)fname);
-		    ece391_fdputs (1, (uint8_t*)":");
-		    ece391_fdputs (1, data + line_start);
-		    ece391_fdputs (1, (uint8_t*)"\n");
+		    ece391_ring_fdputs (1, (uint8_t*)fname);
+		    ece391_ring_fdputs (1, (uint8_t*)":");
+		    ece391_ring_fdputs (1, data + line_start);
+		    ece391_ring_fdputs (1, (uint8_t*)"\n");
 		    break;
 		}
 	    }
@@ -59,7 +59,7 @@ do_one_file (const char* s, const char* fname)
 	    break;
     }
     if (-1 == ece391_close (fd)) {
-        ece391_fdputs (1, (uint8_t*)"file close failed\n");
+        ece391_ring_fdputs (1, (uint8_t*)"file close failed\n");
         return -1;
     }
     return 0;
@@ -83,15 +83,20 @@ int main ()
 
     while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
         if (-1 == cnt) {
-	    ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
+	    ece391_ring_fdputs (1, (uint8_t*)"directory entry read failed\n");
+	    ece391_ring_flush ();
 	    return 3;
 	}
 	if ('.' == buf[0]) /* a directory... */
 	    continue;
 	buf[cnt] = '\0';
-	if (0 != do_one_file ((char*)search, (char*)buf))
+	if (0 != do_one_file ((char*)search, (char*)buf)) {
+	    ece391_ring_flush ();
 	    return 3;
+	}
     }
 
+    /* matches are queued on the ring, write them all out */
+    ece391_ring_flush ();
     return 0;
 }
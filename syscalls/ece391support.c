@@ -102,3 +102,272 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+
+/* 
+ * The program's rings, a page of its own memory the kernel reads and
+ * writes during ece391_enter.  Text from ece391_ring_fdputs collects in
+ * ring_out and goes out as one queued write per run of the same fd.
+ */
+#define RING_PAGE_SIZE 4096
+#define RING_OUT_SIZE  4096
+#define RING_PUTS_DATA 0xFFFFFFFF
+
+static io_ring_t ring __attribute__((aligned (RING_PAGE_SIZE)));
+static uint8_t ring_out[RING_OUT_SIZE];
+static uint32_t ring_out_len;       /* bytes of ring_out in use */
+static uint32_t ring_out_queued;    /* bytes of it already queued */
+static int32_t ring_out_fd;
+
+/* Queue one operation, -1 if the submission ring is full */
+int32_t ece391_ring_queue(uint32_t opcode, int32_t fd, const void* addr, int32_t len, uint32_t user_data)
+{
+    io_sqe_t* sqe;
+
+    if (ring.sq_tail - ring.sq_head >= IO_RING_ENTRIES) {
+        return -1;
+    }
+    sqe = &ring.sqes[ring.sq_tail % IO_RING_ENTRIES];
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (uint32_t)addr;
+    sqe->len = len;
+    sqe->user_data = user_data;
+    ring.sq_tail++;
+    return 0;
+}
+
+/* Run one queued operation with its own system call and post its completion */
+static void ring_run_one(void)
+{
+    io_sqe_t* sqe = &ring.sqes[ring.sq_head % IO_RING_ENTRIES];
+    io_cqe_t* cqe = &ring.cqes[ring.cq_tail % IO_RING_ENTRIES];
+
+    switch (sqe->opcode) {
+        case IO_OP_READ:
+            cqe->result = ece391_read(sqe->fd, (void*)sqe->addr, sqe->len);
+            break;
+        case IO_OP_WRITE:
+            cqe->result = ece391_write(sqe->fd, (const void*)sqe->addr, sqe->len);
+            break;
+        case IO_OP_OPEN:
+            cqe->result = ece391_open((const uint8_t*)sqe->addr);
+            break;
+        case IO_OP_CLOSE:
+            cqe->result = ece391_close(sqe->fd);
+            break;
+        default:
+            cqe->result = -1;
+            break;
+    }
+    cqe->user_data = sqe->user_data;
+    ring.sq_head++;
+    ring.cq_tail++;
+}
+
+/* 
+ * Run every queued operation that has room for its completion, with one
+ * ece391_enter when the kernel takes it and one call each otherwise.
+ * Returns how many ran.
+ */
+int32_t ece391_ring_submit(void)
+{
+    int32_t done;
+
+    if (-1 != (done = ece391_enter(&ring))) {
+        return done;
+    }
+    for (done = 0; ring.sq_head != ring.sq_tail && ring.cq_tail - ring.cq_head < IO_RING_ENTRIES; done++) {
+        ring_run_one();
+    }
+    return done;
+}
+
+/* Take the oldest completion, -1 if there is none */
+int32_t ece391_ring_reap(int32_t* result, uint32_t* user_data)
+{
+    io_cqe_t* cqe;
+
+    if (ring.cq_head == ring.cq_tail) {
+        return -1;
+    }
+    cqe = &ring.cqes[ring.cq_head % IO_RING_ENTRIES];
+    *result = cqe->result;
+    *user_data = cqe->user_data;
+    ring.cq_head++;
+    return 0;
+}
+
+/* Queue the text collected for ring_out_fd since the last call */
+static void ring_queue_out(void)
+{
+    if (ring_out_len == ring_out_queued) {
+        return;
+    }
+    if (-1 == ece391_ring_queue(IO_OP_WRITE, ring_out_fd, ring_out + ring_out_queued,
+                                ring_out_len - ring_out_queued, RING_PUTS_DATA)) {
+        ece391_ring_flush();
+        return;
+    }
+    ring_out_queued = ring_out_len;
+}
+
+/* 
+ * Like ece391_fdputs, but the text is only written at the next
+ * ece391_ring_flush, or when ring_out fills up.
+ */
+void ece391_ring_fdputs(int32_t fd, const uint8_t* s)
+{
+    uint32_t len = ece391_strlen(s);
+
+    if (len > RING_OUT_SIZE) {
+        ece391_ring_flush();
+        ece391_fdputs(fd, s);
+        return;
+    }
+    if (fd != ring_out_fd) {
+        ring_queue_out();
+        ring_out_fd = fd;
+    }
+    if (len > RING_OUT_SIZE - ring_out_len) {
+        ece391_ring_flush();
+        ring_out_fd = fd;
+    }
+    while (len-- > 0) {
+        ring_out[ring_out_len++] = *s++;
+    }
+}
+
+/* 
+ * Write out everything ece391_ring_fdputs collected, together with any
+ * other queued operations.  Completions are dropped, so reap first when
+ * their results matter.
+ */
+void ece391_ring_flush(void)
+{
+    int32_t result;
+    uint32_t user_data;
+
+    if (ring_out_len != ring_out_queued &&
+        -1 != ece391_ring_queue(IO_OP_WRITE, ring_out_fd, ring_out + ring_out_queued,
+                                ring_out_len - ring_out_queued, RING_PUTS_DATA)) {
+        ring_out_queued = ring_out_len;
+    }
+    while (ring.sq_head != ring.sq_tail) {
+        while (0 == ece391_ring_reap(&result, &user_data));
+        ece391_ring_submit();
+    }
+    while (0 == ece391_ring_reap(&result, &user_data));
+
+    /* a write that did not fit in the ring goes out on its own */
+    if (ring_out_len != ring_out_queued) {
+        (void)ece391_write(ring_out_fd, ring_out + ring_out_queued, ring_out_len - ring_out_queued);
+    }
+    ring_out_len = 0;
+    ring_out_queued = 0;
+}
+
+/* 
+ * Accessors for the kernel data pages.  They are plain loads from
+ * memory the kernel keeps up to date, so timing loops need no system
+ * calls.
+ */
+#define KDATA ((const ece391_kdata_t*)ECE391_KDATA_ADDR)
+#define PDATA ((const ece391_pdata_t*)ECE391_PDATA_ADDR)
+#define NS_PER_SEC 1000000000
+
+/*
+ * Timer ticks since boot: the count at the last tick plus the whole ticks
+ * the TSC says have passed since.  The kernel may stop the periodic tick
+ * for up to a second while nothing needs preempting, so the published
+ * count alone can stand still.  The kernel's own count also keeps the part
+ * of a tick a one-shot left over, so once it catches up it is not behind
+ * this one, short of the TSC's timing error.
+ */
+uint32_t ece391_ticks(void)
+{
+    uint32_t seq, mult, ticks, hz;
+    uint64_t tsc, now, elapsed;
+
+    do {
+        while ((seq = KDATA->seq) & 1);
+        tsc = ((uint64_t)KDATA->tsc_high << 32) | KDATA->tsc_low;
+        mult = KDATA->ns_mult;
+        ticks = KDATA->ticks;
+        hz = KDATA->tick_hz;
+    } while (seq != KDATA->seq);
+
+    if (0 == mult || 0 == hz) {
+        return ticks;
+    }
+    asm volatile ("rdtsc" : "=A" (now));
+    if (now < tsc) {
+        return ticks;
+    }
+    /* a one-shot lasts at most a second, so the ns fit in 32 bits
+       and no 64-bit division is needed */
+    elapsed = ((now - tsc) * mult) >> ECE391_NS_SHIFT;
+    if (elapsed > 0xFFFFFFFF) {
+        elapsed = 0xFFFFFFFF;
+    }
+    return ticks + (uint32_t)elapsed / (NS_PER_SEC / hz);
+}
+
+/* Ticks per second */
+uint32_t ece391_tick_hz(void)
+{
+    return KDATA->tick_hz;
+}
+
+/* 
+ * Nanoseconds since the kernel timed the TSC: the time at the last tick
+ * plus the cycles since then.  Falls back to tick resolution when the
+ * kernel could not time the TSC.
+ */
+uint64_t ece391_clock_ns(void)
+{
+    uint32_t seq, mult, ticks, hz;
+    uint64_t ns, tsc, now;
+
+    do {
+        while ((seq = KDATA->seq) & 1);
+        ns = ((uint64_t)KDATA->ns_high << 32) | KDATA->ns_low;
+        tsc = ((uint64_t)KDATA->tsc_high << 32) | KDATA->tsc_low;
+        mult = KDATA->ns_mult;
+        ticks = KDATA->ticks;
+        hz = KDATA->tick_hz;
+    } while (seq != KDATA->seq);
+
+    if (0 == mult) {
+        return (0 == hz) ? 0 : (uint64_t)ticks * (NS_PER_SEC / hz);
+    }
+    asm volatile ("rdtsc" : "=A" (now));
+    /* another processor's TSC may be a little behind the one that ticked */
+    if (now < tsc) {
+        return ns;
+    }
+    return ns + (((now - tsc) * mult) >> ECE391_NS_SHIFT);
+}
+
+/* Terminal on the screen */
+uint32_t ece391_active_terminal(void)
+{
+    return KDATA->active_terminal;
+}
+
+/* This program's process id */
+int32_t ece391_getpid(void)
+{
+    return PDATA->pid;
+}
+
+/* Process id of the program that executed or forked this one, -1 if none */
+int32_t ece391_getppid(void)
+{
+    return PDATA->parent_pid;
+}
+
+/* Terminal this program reads from and draws to */
+uint32_t ece391_terminal(void)
+{
+    return PDATA->terminal;
+}
@@ -1,6 +1,33 @@
 #if !defined(ECE391SUPPORT_H)
 #define ECE391SUPPORT_H
 
+/*
+ * Read-only pages the kernel maps into every program, laid out as the
+ * kernel's kdata.h.  The first is shared and updated every tick, seq is
+ * odd while the kernel is writing it.  The second is the program's own.
+ */
+#define ECE391_KDATA_ADDR   0x09000000
+#define ECE391_PDATA_ADDR   0x09001000
+#define ECE391_NS_SHIFT     24
+
+typedef struct ece391_kdata {
+    volatile uint32_t seq;
+    volatile uint32_t ticks;
+    volatile uint32_t tick_hz;
+    volatile uint32_t active_terminal;
+    volatile uint32_t tsc_low;
+    volatile uint32_t tsc_high;
+    volatile uint32_t ns_low;
+    volatile uint32_t ns_high;
+    volatile uint32_t ns_mult;
+} ece391_kdata_t;
+
+typedef struct ece391_pdata {
+    int32_t pid;
+    int32_t parent_pid;
+    uint32_t terminal;
+} ece391_pdata_t;
+
 extern uint32_t ece391_strlen(const uint8_t* s);
 extern void ece391_strcpy(uint8_t* dst, const uint8_t* src);
 extern void ece391_fdputs(int32_t fd, const uint8_t* s);
@@ -9,5 +36,21 @@ extern int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
 extern uint8_t *ece391_strrev(uint8_t* s);
 
+/* batched I/O through the program's ring, see ece391support.c */
+extern int32_t ece391_ring_queue(uint32_t opcode, int32_t fd, const void* addr, int32_t len, uint32_t user_data);
+extern int32_t ece391_ring_submit(void);
+extern int32_t ece391_ring_reap(int32_t* result, uint32_t* user_data);
+extern void ece391_ring_fdputs(int32_t fd, const uint8_t* s);
+extern void ece391_ring_flush(void);
+
+/* read from the kernel data pages, without a system call */
+extern uint32_t ece391_ticks(void);
+extern uint32_t ece391_tick_hz(void);
+extern uint64_t ece391_clock_ns(void);
+extern uint32_t ece391_active_terminal(void);
+extern int32_t ece391_getpid(void);
+extern int32_t ece391_getppid(void);
+extern uint32_t ece391_terminal(void);
+
 #endif /* ECE391SUPPORT_H */
 
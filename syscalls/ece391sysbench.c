@@ -0,0 +1,50 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define CALLS 100000
+
+static uint32_t rdtsc_low ()
+{
+    uint32_t low, high;
+
+    asm volatile ("rdtsc" : "=a" (low), "=d" (high));
+    return low;
+}
+
+/* average cycles of a null system call with ece391_use_sysenter set to fast */
+static uint32_t time_null_calls (int32_t fast)
+{
+    uint32_t i, start, total;
+
+    ece391_use_sysenter = fast;
+    start = rdtsc_low ();
+    for (i = 0; i < CALLS; i++)
+        ece391_null ();
+    total = rdtsc_low () - start;
+    return total / CALLS;
+}
+
+static void print_result (const char* path, uint32_t cycles)
+{
+    uint8_t buf[16];
+
+    ece391_fdputs (1, (uint8_t*)path);
+    ece391_fdputs (1, ece391_itoa (cycles, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles per null system call\n");
+}
+
+int main ()
+{
+    int32_t has_sysenter = ece391_use_sysenter;
+
+    print_result ("int $0x80: ", time_null_calls (0));
+    if (!has_sysenter) {
+        ece391_fdputs (1, (uint8_t*)"sysenter: not supported\n");
+        return 0;
+    }
+    print_result ("sysenter:  ", time_null_calls (1));
+
+    return 0;
+}
@@ -3,6 +3,42 @@
 
 #include <stdint.h>
 
+/*
+ * Submission and completion rings for ece391_enter, laid out as the
+ * kernel's io_ring.h.  The program fills sqes[sq_tail % IO_RING_ENTRIES]
+ * and advances sq_tail, then reads cqes from cq_head up to cq_tail.
+ * Each operation runs like the system call of the same name, open takes
+ * the file name in addr.
+ */
+#define IO_RING_ENTRIES 64
+
+#define IO_OP_READ  0
+#define IO_OP_WRITE 1
+#define IO_OP_OPEN  2
+#define IO_OP_CLOSE 3
+
+typedef struct io_sqe {
+	uint32_t opcode;
+	int32_t fd;
+	uint32_t addr;
+	int32_t len;
+	uint32_t user_data;
+} io_sqe_t;
+
+typedef struct io_cqe {
+	int32_t result;
+	uint32_t user_data;
+} io_cqe_t;
+
+typedef struct io_ring {
+	volatile uint32_t sq_head;
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;
+	io_sqe_t sqes[IO_RING_ENTRIES];
+	io_cqe_t cqes[IO_RING_ENTRIES];
+} io_ring_t;
+
 /* All calls return >= 0 on success or -1 on failure. */
 
 /*  
@@ -21,6 +57,32 @@ extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+extern int32_t ece391_nice (int32_t increment);
+extern int32_t ece391_sleep (int32_t ms);
+
+/* 
+ * Runs the operations queued in ring and posts their completions,
+ * returning how many ran.  Fails when the kernel has the rings turned
+ * off; ece391_ring_submit then runs them one call at a time.
+ */
+extern int32_t ece391_enter (io_ring_t* ring);
+
+/* 
+ * Fork returns the child's pid in the parent and 0 in the child, which
+ * shares the parent's pages until either writes them.  Nobody waits for
+ * the child.  Exec replaces the calling program with the command and
+ * keeps its pid and open files; it only returns on failure.
+ */
+extern int32_t ece391_fork (void);
+extern int32_t ece391_exec (const uint8_t* command);
+
+/* 
+ * Always returns -1 without doing anything, for timing the system call
+ * path.  Calls use SYSENTER while ece391_use_sysenter is nonzero, which
+ * the startup code sets when the processor supports it.
+ */
+extern int32_t ece391_null (void);
+extern int32_t ece391_use_sysenter;
 
 enum signums {
 	DIV_ZERO = 0,
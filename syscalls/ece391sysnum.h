@@ -1,6 +1,8 @@
 #if !defined(ECE391SYSNUM_H)
 #define ECE391SYSNUM_H
 
+/* reserved, the kernel fails it without doing anything */
+#define SYS_NULL    0
 #define SYS_HALT    1
 #define SYS_EXECUTE 2
 #define SYS_READ    3
@@ -11,5 +13,10 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_NICE    11
+#define SYS_SLEEP   12
+#define SYS_ENTER   13
+#define SYS_FORK    14
+#define SYS_EXEC    15
 
 #endif /* ECE391SYSNUM_H */